@@ -0,0 +1,642 @@
+#include "solver/fluidGrid.h"
+#include "solver/colourMap.h"
+#include "solver/simdKernels.h"
+#include "matrixOperations/matrixOp.h"
+#include "matrixOperations/matrix.h"
+#include "matrixOperations/matrixMultiply.h"
+#include "matrixOperations/matrixBatch.h"
+#include "matrixOperations/sparseMatrix.h"
+#include "profiling/profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+ * Headless benchmark of the solver stages and the matrix operations over a sweep of sizes. Every case is
+ * repeated until it has run for a minimum time and reports the median repetition as ns per cell (element),
+ * effective bandwidth and arithmetic rate. Bandwidth and rate come from a per-case model of the bytes a
+ * cell moves to and from memory and the floating point operations it takes, so they compare commits, not
+ * machines against their peak.
+ *
+ * snowLibBench [--sizes 128,256,...] [--matrix-sizes 64,128,...] [--threads n] [--min-time seconds]
+ *              [--csv path] [--json path] [--baseline path] [--threshold percent] [--counters] [--help]
+ *
+ * --baseline compares against the CSV of an earlier run and exits with 1 if any case got slower by more
+ * than the threshold (10% by default). --counters prints the cycles and last level cache misses per profiled
+ * stage, the pool's threads included, after the float32 grid cases of every size, in builds with
+ * SNOWLIB_ENABLE_PROFILER.
+ */
+
+namespace {
+	struct benchResult {
+		std::string name;
+		int size = 0;
+		long long elements = 0;
+		int repetitions = 0;
+		double seconds = 0;
+		double nsPerElement = 0;
+		double gigabytesPerSecond = 0;
+		double gigaflopsPerSecond = 0;
+	};
+
+	struct benchOptions {
+		std::vector<int> gridSizes{ 128, 256, 512, 1024, 2048, 4096 };
+		std::vector<int> matrixSizes{ 64, 128, 256, 512, 1024, 2048 };
+		int threads = 0;
+		double minTime = 0.2;
+		std::string csvPath;
+		std::string jsonPath;
+		std::string baselinePath;
+		double threshold = 10;
+		bool counters = false;
+	};
+
+	const char* const valueOptions[] = { "--sizes", "--matrix-sizes", "--threads", "--min-time", "--csv", "--json", "--baseline", "--threshold" };
+
+	bool takesValue(const char* argument) {
+		for (const char* option : valueOptions) {
+			if (std::strcmp(argument, option) == 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void printUsage(std::FILE* stream) {
+		std::fprintf(stream,
+			"usage: snowLibBench [options]\n"
+			"  --sizes 128,256,...        grid sizes of the solver cases\n"
+			"  --matrix-sizes 64,128,...  sizes of the matrix cases\n"
+			"  --threads n                threads of the solver and matrix cases, 0 for all cores\n"
+			"  --min-time seconds         time every case runs for at least (0.2)\n"
+			"  --csv path                 writes the results as CSV\n"
+			"  --json path                writes the results as JSON\n"
+			"  --baseline path            compares against the CSV of an earlier run\n"
+			"  --threshold percent        slowdown over the baseline that fails the run (10)\n"
+			"  --counters                 prints cycles and cache misses of the profiled solver stages\n"
+			"  --help                     prints this\n");
+	}
+
+	/**
+	 * Means per scope of the profiled solver stages since the last reset, the stage scopes only exist in
+	 * builds with SNOWLIB_ENABLE_PROFILER.
+	 */
+	void printStageCounters(int size) {
+		profiler& stages = profiler::instance();
+		for (profileStage stage : { projectionStage, advectionStage, diffusionStage }) {
+			profiler::stageSummary summary = stages.summary(stage);
+			if (summary.count == 0) {
+				continue;
+			}
+			std::string name = std::string("counters.") + profileStageName(stage);
+			if (summary.cycles < 0) {
+				std::printf("%-22s %6d   p50 %.3f ms over %llu scopes, no counters\n", name.c_str(), size, summary.p50, (unsigned long long)summary.count);
+				continue;
+			}
+			std::printf("%-22s %6d   p50 %.3f ms over %llu scopes, %.0f cycles %.0f llc misses\n", name.c_str(), size, summary.p50,
+				(unsigned long long)summary.count, summary.cycles, summary.cacheMisses);
+		}
+	}
+
+	std::vector<int> parseSizes(const char* text) {
+		std::vector<int> sizes;
+		std::stringstream stream(text);
+		std::string item;
+		while (std::getline(stream, item, ',')) {
+			int size = std::atoi(item.c_str());
+			if (size > 0) {
+				sizes.push_back(size);
+			}
+		}
+		return sizes;
+	}
+
+	/**
+	 * Median seconds of one call of run, repeated until minTime has passed and at least 3 times (once for
+	 * calls that alone take longer than minTime). setup runs before every repetition, untimed.
+	 */
+	double timeMedian(double minTime, int& repetitions, const std::function<void()>& run, const std::function<void()>& setup = {}) {
+		std::vector<double> times;
+		double total = 0;
+		while (total < minTime || times.size() < 3) {
+			if (setup) {
+				setup();
+			}
+			auto start = std::chrono::steady_clock::now();
+			run();
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			times.push_back(seconds);
+			total += seconds;
+			if (total >= minTime && seconds >= minTime) {
+				break;
+			}
+		}
+		repetitions = int(times.size());
+		std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+		return times[times.size() / 2];
+	}
+
+	benchResult makeResult(const std::string& name, int size, long long elements, int repetitions, double seconds, double bytesPerElement, double flopsPerElement) {
+		benchResult result;
+		result.name = name;
+		result.size = size;
+		result.elements = elements;
+		result.repetitions = repetitions;
+		result.seconds = seconds;
+		result.nsPerElement = seconds * 1e9 / double(elements);
+		result.gigabytesPerSecond = bytesPerElement * double(elements) / seconds * 1e-9;
+		result.gigaflopsPerSecond = flopsPerElement * double(elements) / seconds * 1e-9;
+		return result;
+	}
+
+	void printResult(const benchResult& result) {
+		std::printf("%-22s %6d %12.3f %10.2f %10.2f %8d\n", result.name.c_str(), result.size, result.nsPerElement,
+			result.gigabytesPerSecond, result.gigaflopsPerSecond, result.repetitions);
+		std::fflush(stdout);
+	}
+
+	// brings a grid into a state with flow everywhere, so advection samples and the solvers do real work
+	void stirGrid(fluidGrid& grid) {
+		int size = grid.getWidth();
+		for (int step = 0; step < 4; ++step) {
+			grid.addSource(size / 2, size / 2, float(size) * 0.5f, float(size) * 0.25f, 20, std::max(size / 8, 1));
+			grid.addSource(size / 4, size * 3 / 4, -float(size) * 0.25f, float(size) * 0.5f, 20, std::max(size / 16, 1));
+			grid.step(0.016f);
+		}
+	}
+
+	void benchGrid(const benchOptions& options, int size, std::vector<benchResult>& results) {
+		fluidGrid grid(size, size);
+		grid.setThreadCount(options.threads);
+		stirGrid(grid);
+		long long cells = (long long)size * size;
+		int repetitions = 0;
+
+		// byte and flop models per cell, 20 Gauss-Seidel sweeps for pressure and diffusion as configured by default.
+		// projection: divergence (read u, v, write div), 20 sweeps (read div, read + write p), gradient (read p, update u, v)
+		double seconds = timeMedian(options.minTime, repetitions, [&] { grid.projectVel(); });
+		results.push_back(makeResult("projection", size, cells, repetitions, seconds, 4.0 * (3 + 3 * 20 + 5), 4 + 6 * 20 + 4));
+		printResult(results.back());
+
+		// advection: read both velocities, then gather and write density and both velocities
+		seconds = timeMedian(options.minTime, repetitions, [&] { grid.addVection(); });
+		results.push_back(makeResult("advection", size, cells, repetitions, seconds, 4.0 * (2 + 3 * 2), 6 + 3 * 8));
+		printResult(results.back());
+
+		// diffusion: copy of the three channels, then 20 sweeps of each (read base, read + write current)
+		seconds = timeMedian(options.minTime, repetitions, [&] { grid.diffusion(); });
+		results.push_back(makeResult("diffusion", size, cells, repetitions, seconds, 4.0 * (3 * 2 + 3 * 3 * 20), 3 * 6 * 20));
+		printResult(results.back());
+
+		seconds = timeMedian(options.minTime, repetitions, [&] { grid.step(0.016f); });
+		results.push_back(makeResult("step", size, cells, repetitions, seconds, 4.0 * ((3 + 3 * 20 + 5) + (2 + 3 * 2) + (3 * 2 + 3 * 3 * 20)),
+			(4 + 6 * 20 + 4) + (6 + 3 * 8) + (3 * 6 * 20)));
+		printResult(results.back());
+		// what the stages take from the frame arena, the size to reserve for grids of this size
+		std::printf("%-22s %6d %12.1f KiB in %d block(s)\n", "frameArenaPeak", size, double(grid.getFrameArena().getPeak()) / 1024.0,
+			grid.getFrameArena().getBlockCount());
+
+		// colour mapping: read density, write an RGBA8 pixel through the table
+		colourMap colours;
+		std::vector<unsigned char> pixels;
+		mapDensityToPx(grid, colours, pixels);
+		seconds = timeMedian(options.minTime, repetitions, [&] { mapDensityToPx(grid, colours, pixels); });
+		results.push_back(makeResult("colourMap", size, cells, repetitions, seconds, 4 + 4, 2));
+		printResult(results.back());
+	}
+
+	// the spectral solvers of a periodic grid, and the 2D transform they are built on
+	void benchSpectral(const benchOptions& options, int size, std::vector<benchResult>& results) {
+		fluidGrid grid(size, size);
+		grid.setThreadCount(options.threads);
+		grid.setBoundaryCondition(periodicBoundary);
+		grid.setPressureSolver(fluidGrid::spectralPressure);
+		grid.setDiffusionSolver(fluidGrid::spectralDiffusion);
+		stirGrid(grid);
+		long long cells = (long long)size * size;
+		double logCells = std::log2(double(cells));
+		int repetitions = 0;
+
+		// forward and inverse transform of a field: every pass reads and writes the half spectrum (4 bytes per
+		// cell), 2.5 log2(cells) flops per cell each way for real input
+		realFft2d transform(size, size);
+		field values = grid.density();
+		alignedVector<complexFloat> spectrum(std::size_t(transform.getSpectrumWidth()) * size);
+		double seconds = timeMedian(options.minTime, repetitions, [&] {
+			transform.forward(values.data(), values.getStride(), spectrum.data(), grid.getThreadPool());
+			transform.inverse(spectrum.data(), values.data(), values.getStride(), grid.getThreadPool());
+		});
+		results.push_back(makeResult("fft2d", size, cells, repetitions, seconds, 2.0 * (4 + 4 + 8), 5 * logCells));
+		printResult(results.back());
+
+		// projection: two fields there and back plus the per-wavenumber projection
+		seconds = timeMedian(options.minTime, repetitions, [&] { grid.projectVel(); });
+		results.push_back(makeResult("projectionSpectral", size, cells, repetitions, seconds, 2 * 2.0 * (4 + 4 + 8), 2 * 5 * logCells + 10));
+		printResult(results.back());
+
+		// diffusion: three fields there and back plus a division per wavenumber
+		seconds = timeMedian(options.minTime, repetitions, [&] { grid.diffusion(); });
+		results.push_back(makeResult("diffusionSpectral", size, cells, repetitions, seconds, 3 * 2.0 * (4 + 4 + 8), 3 * (5 * logCells + 3)));
+		printResult(results.back());
+
+		seconds = timeMedian(options.minTime, repetitions, [&] { grid.step(0.016f); });
+		results.push_back(makeResult("stepSpectral", size, cells, repetitions, seconds, 5 * 2.0 * (4 + 4 + 8) + 4.0 * (2 + 3 * 2),
+			(2 * 5 * logCells + 10) + (6 + 3 * 8) + 3 * (5 * logCells + 3)));
+		printResult(results.back());
+	}
+
+	// a step with a brush stroke on a grid that is otherwise at rest, with activity tracking. Reported per cell of the
+	// whole grid, the byte and flop models of step scaled by the share of the tiles that were active
+	void benchActiveTiles(const benchOptions& options, int size, std::vector<benchResult>& results) {
+		// energyLost 0.5 lets the uniform starting density fall below the threshold within a few steps
+		fluidGrid grid(size, size, 0.5f, 0.5f);
+		grid.setThreadCount(options.threads);
+		grid.setActiveTileTracking(true);
+		for (int step = 0; step < 12 && grid.lastActiveTiles() > 0; ++step) {
+			grid.step(0.016f);
+		}
+		long long cells = (long long)size * size;
+		int repetitions = 0;
+		int stroke = 0;
+
+		double seconds = timeMedian(options.minTime, repetitions, [&] {
+			grid.addSource(size / 2 + (stroke++ % 64), size / 2, 8, 3, 20, 10);
+			grid.step(0.016f);
+		});
+		double activeShare = double(grid.lastActiveTiles()) / grid.getTileCount();
+		results.push_back(makeResult("stepActiveTiles", size, cells, repetitions, seconds,
+			activeShare * 4.0 * ((3 + 3 * 20 + 5) + (2 + 3 * 2) + (3 * 2 + 3 * 3 * 20)), activeShare * ((4 + 6 * 20 + 4) + (6 + 3 * 8) + (3 * 6 * 20))));
+		printResult(results.back());
+		std::printf("%-22s %6d %12d of %d tiles\n", "activeTiles", size, grid.lastActiveTiles(), grid.getTileCount());
+	}
+
+	// relative RMS difference of a channel to the same channel of a reference grid
+	double relativeError(const field& values, const field& reference) {
+		double difference = 0;
+		double magnitude = 0;
+		for (int y = 0; y < reference.getHeight(); ++y) {
+			for (int x = 0; x < reference.getWidth(); ++x) {
+				double delta = double(values.at(x, y)) - reference.at(x, y);
+				difference += delta * delta;
+				magnitude += double(reference.at(x, y)) * reference.at(x, y);
+			}
+		}
+		return magnitude > 0 ? std::sqrt(difference / magnitude) : 0;
+	}
+
+	// the stages with the channels stored in 16 bits, and how far the result drifts from float storage
+	void benchPrecision(const benchOptions& options, int size, std::vector<benchResult>& results) {
+		const fieldPrecision precisions[2] = { float16Precision, bfloat16Precision };
+		const char* names[2] = { "Fp16", "Bf16" };
+
+		fluidGrid reference(size, size);
+		reference.setThreadCount(options.threads);
+		stirGrid(reference);
+		stirGrid(reference);
+		stirGrid(reference);
+		stirGrid(reference);
+
+		for (int index = 0; index < 2; ++index) {
+			fluidGrid grid(size, size);
+			grid.setThreadCount(options.threads);
+			grid.setStoragePrecision(precisions[index]);
+			// 16 steps stirred like the reference, then compared to it
+			stirGrid(grid);
+			stirGrid(grid);
+			stirGrid(grid);
+			stirGrid(grid);
+			double densityError = relativeError(grid.density(), reference.density());
+			double velocityError = std::max(relativeError(grid.velocityX(), reference.velocityX()), relativeError(grid.velocityY(), reference.velocityY()));
+
+			long long cells = (long long)size * size;
+			int repetitions = 0;
+			std::string suffix = names[index];
+			// the byte models of benchGrid with 2 bytes per channel value, pressure and divergence stay 4 bytes. Diffusion
+			// reads and writes every channel once in 16 bits and runs the copy and the sweeps on a float pair
+			double seconds = timeMedian(options.minTime, repetitions, [&] { grid.projectVel(); });
+			results.push_back(makeResult("projection" + suffix, size, cells, repetitions, seconds, 2.0 * (2 + 4) + 4.0 * (1 + 3 * 20 + 1), 4 + 6 * 20 + 4));
+			printResult(results.back());
+
+			seconds = timeMedian(options.minTime, repetitions, [&] { grid.addVection(); });
+			results.push_back(makeResult("advection" + suffix, size, cells, repetitions, seconds, 2.0 * (2 + 3 * 2), 6 + 3 * 8));
+			printResult(results.back());
+
+			seconds = timeMedian(options.minTime, repetitions, [&] { grid.diffusion(); });
+			results.push_back(makeResult("diffusion" + suffix, size, cells, repetitions, seconds, 2.0 * (3 * 2) + 4.0 * (3 * 2 + 3 * 3 * 20), 3 * 6 * 20));
+			printResult(results.back());
+
+			seconds = timeMedian(options.minTime, repetitions, [&] { grid.step(0.016f); });
+			results.push_back(makeResult("step" + suffix, size, cells, repetitions, seconds,
+				2.0 * ((2 + 4) + (2 + 3 * 2) + (3 * 2)) + 4.0 * ((1 + 3 * 20 + 1) + (3 * 2 + 3 * 3 * 20)), (4 + 6 * 20 + 4) + (6 + 3 * 8) + (3 * 6 * 20)));
+			printResult(results.back());
+
+			std::printf("%-22s %6d   density %.2e  velocity %.2e  state %.1f of %.1f KiB\n", ("error" + suffix).c_str(), size, densityError, velocityError,
+				double(grid.getStateBytes()) / 1024.0, double(reference.getStateBytes()) / 1024.0);
+		}
+	}
+
+	// the implicit diffusion operator of a size x size grid as an assembled sparse matrix, one row per cell
+	void benchSparse(const benchOptions& options, int size, std::vector<benchResult>& results) {
+		int cells = size * size;
+		std::vector<matrixTriplet> triplets = stencilTriplets(size, size, 1.0f, 0.2f, true);
+		sparseMatrix rowsMatrix(cells, cells, triplets);
+		diagonalMatrix bandMatrix(cells, cells, triplets);
+		std::vector<float> vector(static_cast<std::size_t>(cells));
+		std::vector<float> product(static_cast<std::size_t>(cells));
+		for (int index = 0; index < cells; ++index) {
+			vector[std::size_t(index)] = float(index % 19) * 0.125f;
+		}
+		int repetitions = 0;
+
+		// compressed rows: five values and column indices, the row start, the vector element and the result per row
+		double seconds = timeMedian(options.minTime, repetitions, [&] { rowsMatrix.multiply(vector.data(), product.data()); });
+		results.push_back(makeResult("sparseMultiply", size, cells, repetitions, seconds, 5 * 8 + 4 + 4 + 4, 10));
+		printResult(results.back());
+
+		seconds = timeMedian(options.minTime, repetitions, [&] { rowsMatrix.multiplyTransposed(vector.data(), product.data()); });
+		results.push_back(makeResult("sparseMultiplyT", size, cells, repetitions, seconds, 5 * 8 + 4 + 4 + 4, 10));
+		printResult(results.back());
+
+		// diagonals: five values, the vector element and the result per row, no indices
+		seconds = timeMedian(options.minTime, repetitions, [&] { bandMatrix.multiply(vector.data(), product.data()); });
+		results.push_back(makeResult("diagonalMultiply", size, cells, repetitions, seconds, 5 * 4 + 4 + 4, 10));
+		printResult(results.back());
+
+		seconds = timeMedian(options.minTime, repetitions, [&] { bandMatrix.multiplyTransposed(vector.data(), product.data()); });
+		results.push_back(makeResult("diagonalMultiplyT", size, cells, repetitions, seconds, 5 * 4 + 4 + 4, 10));
+		printResult(results.back());
+
+		// conjugate gradient on the assembled operator from zero, per iteration a compressed rows product, three
+		// dot products and three vector updates: ten more vector reads and writes, 13 more flops
+		sparseConjugateGradient solver;
+		std::vector<float> solution(static_cast<std::size_t>(cells));
+		seconds = timeMedian(options.minTime, repetitions, [&] { solver.solve(rowsMatrix, vector.data(), solution.data()); },
+			[&] { std::fill(solution.begin(), solution.end(), 0.0f); });
+		int iterations = solver.lastIterations();
+		results.push_back(makeResult("sparseSolve", size, cells, repetitions, seconds, iterations * (5 * 8 + 4 + 4 + 4 + 4.0 * 10), iterations * (10 + 13.0)));
+		printResult(results.back());
+	}
+
+	void benchMatrix(const benchOptions& options, int size, std::vector<benchResult>& results) {
+		long long elements = (long long)size * size;
+		std::vector<float> a(static_cast<std::size_t>(elements));
+		std::vector<float> b(static_cast<std::size_t>(elements));
+		for (long long index = 0; index < elements; ++index) {
+			a[std::size_t(index)] = float(index % 17) * 0.25f;
+			b[std::size_t(index)] = float(index % 13) * 0.5f;
+		}
+
+		// the operations take their inputs by unique_ptr, fresh copies are made untimed before every call
+		unique_ptr<vector<float>> left;
+		unique_ptr<vector<float>> right;
+		auto copyBoth = [&] {
+			left = std::make_unique<vector<float>>(a);
+			right = std::make_unique<vector<float>>(b);
+		};
+		auto copyLeft = [&] { left = std::make_unique<vector<float>>(a); };
+		unique_ptr<vector<float>> out;
+		int repetitions = 0;
+
+		double seconds = timeMedian(options.minTime, repetitions, [&] { out = matrixAdd(std::move(left), std::move(right), size); }, copyBoth);
+		results.push_back(makeResult("matrixAdd", size, elements, repetitions, seconds, 12, 1));
+		printResult(results.back());
+
+		seconds = timeMedian(options.minTime, repetitions, [&] { out = matrixSubtract(std::move(left), std::move(right), size); }, copyBoth);
+		results.push_back(makeResult("matrixSubtract", size, elements, repetitions, seconds, 12, 1));
+		printResult(results.back());
+
+		seconds = timeMedian(options.minTime, repetitions, [&] { out = matrixSubtractAbs(std::move(left), std::move(right), size); }, copyBoth);
+		results.push_back(makeResult("matrixSubtractAbs", size, elements, repetitions, seconds, 12, 2));
+		printResult(results.back());
+
+		seconds = timeMedian(options.minTime, repetitions, [&] { out = matrixScalarMultiply(std::move(left), 1.5f, size); }, copyLeft);
+		results.push_back(makeResult("matrixScalarMultiply", size, elements, repetitions, seconds, 8, 1));
+		printResult(results.back());
+
+		// per output element, as the blocked product moves them: the right operand read and packed once per
+		// 256 deep panel, the left read once per 4080 wide column panel, and the result written by the first
+		// depth panel and read and written by every other one. 2 * size flops
+		int depthPanels = (size + 255) / 256;
+		int columnPanels = (size + 4079) / 4080;
+		double multiplyBytes = 4.0 * (2 + columnPanels + 2 * depthPanels - 1);
+		seconds = timeMedian(options.minTime, repetitions, [&] { out = matrixMultiply(std::move(left), std::move(right), size); }, copyBoth);
+		results.push_back(makeResult("matrixMultiply", size, elements, repetitions, seconds, multiplyBytes, 2.0 * size));
+		printResult(results.back());
+
+		// a fused chain into existing storage: three reads and one write per element, no temporaries
+		matrix<float> first(matrixView<const float>(a.data(), size, size));
+		matrix<float> second(matrixView<const float>(b.data(), size, size));
+		matrix<float> third = first * 0.5f;
+		matrix<float> result(size, size);
+		seconds = timeMedian(options.minTime, repetitions, [&] { result = first + second - third * 1.5f; });
+		results.push_back(makeResult("matrixExpression", size, elements, repetitions, seconds, 16, 3));
+		printResult(results.back());
+
+		// the same chain into a new temporary each time, from the heap and from the scratch arena
+		seconds = timeMedian(options.minTime, repetitions, [&] {
+			matrix<float> temporary(first + second - third * 1.5f);
+			result(0, 0) = temporary(size - 1, size - 1);
+		});
+		results.push_back(makeResult("matrixTemporaryHeap", size, elements, repetitions, seconds, 16, 3));
+		printResult(results.back());
+
+		seconds = timeMedian(options.minTime, repetitions, [&] {
+			frameArenaScope scope(matrixScratchArena());
+			matrix<float> temporary(first + second - third * 1.5f, &matrixScratchArena());
+			result(0, 0) = temporary(size - 1, size - 1);
+		});
+		results.push_back(makeResult("matrixTemporaryArena", size, elements, repetitions, seconds, 16, 3));
+		printResult(results.back());
+
+		// batches of as many 4 x 4 matrices as there are elements in 16 of them, counted per matrix
+		int batchCount = std::max(1, int(elements / 16));
+		matrixBatch<4, 4> leftBatch(batchCount);
+		matrixBatch<4, 4> rightBatch(batchCount);
+		matrixBatch<4, 4> productBatch(batchCount);
+		vectorBatch<4> vectors(batchCount);
+		for (int index = 0; index < batchCount; ++index) {
+			mat4 value = mat4::identity() * float(index % 7 + 1);
+			value(0, 3) = a[std::size_t(index) % a.size()];
+			leftBatch.set(index, value);
+			rightBatch.set(index, transpose(value));
+			vectors.set(index, vec4{ 1.0f, 2.0f, 3.0f, 1.0f });
+		}
+		seconds = timeMedian(options.minTime, repetitions, [&] { multiplyBatch(leftBatch, rightBatch, productBatch); });
+		results.push_back(makeResult("batchMultiply4x4", size, batchCount, repetitions, seconds, 3 * 64, 112));
+		printResult(results.back());
+
+		mat4 transform = mat4::identity();
+		transform(0, 3) = 0.5f;
+		seconds = timeMedian(options.minTime, repetitions, [&] { transformBatch(transform, vectors, vectors); });
+		results.push_back(makeResult("batchTransform4", size, batchCount, repetitions, seconds, 2 * 16, 28));
+		printResult(results.back());
+	}
+
+	bool writeCsv(const std::string& path, const std::vector<benchResult>& results) {
+		std::ofstream file(path);
+		if (!file) {
+			return false;
+		}
+		file << "name,size,elements,repetitions,seconds,ns_per_element,gb_per_s,gflop_per_s\n";
+		for (const benchResult& result : results) {
+			file << result.name << ',' << result.size << ',' << result.elements << ',' << result.repetitions << ',' << result.seconds << ','
+				<< result.nsPerElement << ',' << result.gigabytesPerSecond << ',' << result.gigaflopsPerSecond << '\n';
+		}
+		return bool(file);
+	}
+
+	bool writeJson(const std::string& path, const std::vector<benchResult>& results, const benchOptions& options) {
+		std::ofstream file(path);
+		if (!file) {
+			return false;
+		}
+		file << "{\n  \"simd\": \"" << simdInstructionSet() << "\",\n  \"half_conversion\": \"" << halfConversionInstructionSet() << "\",\n  \"matrix_product\": \"" << matrixMultiplyInstructionSet() << "\",\n  \"threads\": " << options.threads << ",\n  \"results\": [\n";
+		for (std::size_t index = 0; index < results.size(); ++index) {
+			const benchResult& result = results[index];
+			file << "    {\"name\": \"" << result.name << "\", \"size\": " << result.size << ", \"elements\": " << result.elements
+				<< ", \"repetitions\": " << result.repetitions << ", \"seconds\": " << result.seconds << ", \"ns_per_element\": " << result.nsPerElement
+				<< ", \"gb_per_s\": " << result.gigabytesPerSecond << ", \"gflop_per_s\": " << result.gigaflopsPerSecond << "}"
+				<< (index + 1 < results.size() ? ",\n" : "\n");
+		}
+		file << "  ]\n}\n";
+		return bool(file);
+	}
+
+	/**
+	 * Prints the change of every case also found in the baseline CSV, returns whether one got slower than the threshold.
+	 */
+	bool compareBaseline(const std::string& path, const std::vector<benchResult>& results, double threshold) {
+		std::ifstream file(path);
+		if (!file) {
+			std::fprintf(stderr, "cannot read baseline %s\n", path.c_str());
+			return true;
+		}
+		std::map<std::string, double> baseline;
+		std::string line;
+		std::getline(file, line);
+		while (std::getline(file, line)) {
+			std::vector<std::string> columns;
+			std::stringstream stream(line);
+			std::string column;
+			while (std::getline(stream, column, ',')) {
+				columns.push_back(column);
+			}
+			if (columns.size() >= 6) {
+				baseline[columns[0] + "/" + columns[1]] = std::atof(columns[5].c_str());
+			}
+		}
+
+		bool regressed = false;
+		std::printf("\n%-22s %6s %12s %12s %8s\n", "case", "size", "base ns", "ns", "change");
+		for (const benchResult& result : results) {
+			auto found = baseline.find(result.name + "/" + std::to_string(result.size));
+			if (found == baseline.end() || found->second <= 0) {
+				continue;
+			}
+			double change = (result.nsPerElement / found->second - 1) * 100;
+			bool slower = change > threshold;
+			regressed |= slower;
+			std::printf("%-22s %6d %12.3f %12.3f %+7.1f%%%s\n", result.name.c_str(), result.size, found->second, result.nsPerElement, change, slower ? "  REGRESSION" : "");
+		}
+		return regressed;
+	}
+}
+
+int main(int argc, char** argv) {
+	benchOptions options;
+	for (int index = 1; index < argc; ++index) {
+		const char* argument = argv[index];
+		if (std::strcmp(argument, "--help") == 0 || std::strcmp(argument, "-h") == 0) {
+			printUsage(stdout);
+			return 0;
+		}
+		if (std::strcmp(argument, "--counters") == 0) {
+			options.counters = true;
+			continue;
+		}
+		if (!takesValue(argument)) {
+			std::fprintf(stderr, "unknown option %s\n", argument);
+			printUsage(stderr);
+			return 2;
+		}
+		const char* value = index + 1 < argc ? argv[index + 1] : nullptr;
+		if (value == nullptr) {
+			std::fprintf(stderr, "missing value for %s\n", argument);
+			return 2;
+		}
+		if (std::strcmp(argument, "--sizes") == 0) {
+			options.gridSizes = parseSizes(value);
+		}
+		else if (std::strcmp(argument, "--matrix-sizes") == 0) {
+			options.matrixSizes = parseSizes(value);
+		}
+		else if (std::strcmp(argument, "--threads") == 0) {
+			options.threads = std::atoi(value);
+		}
+		else if (std::strcmp(argument, "--min-time") == 0) {
+			options.minTime = std::atof(value);
+		}
+		else if (std::strcmp(argument, "--csv") == 0) {
+			options.csvPath = value;
+		}
+		else if (std::strcmp(argument, "--json") == 0) {
+			options.jsonPath = value;
+		}
+		else if (std::strcmp(argument, "--baseline") == 0) {
+			options.baselinePath = value;
+		}
+		else if (std::strcmp(argument, "--threshold") == 0) {
+			options.threshold = std::atof(value);
+		}
+		++index;
+	}
+
+	std::printf("simd %s, half conversion %s, matrix product %s\n%-22s %6s %12s %10s %10s %8s\n", simdInstructionSet(), halfConversionInstructionSet(), matrixMultiplyInstructionSet(), "case", "size", "ns/element", "GB/s", "GFLOP/s", "reps");
+	std::vector<benchResult> results;
+	matrixThreadPool().setThreadCount(options.threads);
+	if (options.counters) {
+#ifndef SNOWLIB_PROFILE
+		std::fprintf(stderr, "--counters needs a build with SNOWLIB_ENABLE_PROFILER, no stages are profiled\n");
+#endif
+		if (!profiler::instance().setCountersEnabled(true)) {
+			std::fprintf(stderr, "hardware counters unavailable, only stage times are printed\n");
+		}
+	}
+	for (int size : options.gridSizes) {
+		// the counters cover the float32 grid cases only, the later cases run the same stages differently
+		profiler::instance().reset();
+		benchGrid(options, size, results);
+		if (options.counters) {
+			printStageCounters(size);
+		}
+		benchSparse(options, size, results);
+		benchPrecision(options, size, results);
+		benchSpectral(options, size, results);
+		benchActiveTiles(options, size, results);
+	}
+	for (int size : options.matrixSizes) {
+		benchMatrix(options, size, results);
+	}
+
+	if (!options.csvPath.empty() && !writeCsv(options.csvPath, results)) {
+		std::fprintf(stderr, "cannot write %s\n", options.csvPath.c_str());
+		return 2;
+	}
+	if (!options.jsonPath.empty() && !writeJson(options.jsonPath, results, options)) {
+		std::fprintf(stderr, "cannot write %s\n", options.jsonPath.c_str());
+		return 2;
+	}
+	if (!options.baselinePath.empty() && compareBaseline(options.baselinePath, results, options.threshold)) {
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,39 @@
+# Writes OUTPUT, a translation unit defining the table declared in window/embeddedShaders.h from the files in
+# SHADERS (a list). Every shader is stored as its bytes plus a terminating zero under its file name, as bytes
+# rather than a string literal so no source can end the literal early or run into compiler length limits.
+#
+# cmake -DOUTPUT=embeddedShaders.cpp -DSHADERS="a.glsl;b.glsl" -P embedShaders.cmake
+
+set(arrays "")
+set(entries "")
+set(index 0)
+foreach(shader IN LISTS SHADERS)
+	file(READ "${shader}" hex HEX)
+	# 24 bytes a line, cmake regular expressions have no counted repetition
+	set(bytes "")
+	string(LENGTH "${hex}" hexLength)
+	set(offset 0)
+	while (offset LESS hexLength)
+		string(SUBSTRING "${hex}" ${offset} 48 line)
+		string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," line "${line}")
+		string(APPEND bytes "${line}\n\t\t")
+		math(EXPR offset "${offset} + 48")
+	endwhile()
+	get_filename_component(name "${shader}" NAME)
+	string(APPEND arrays "\tconst unsigned char shader${index}[] = {\n\t\t${bytes}0x00\n\t};\n\n")
+	string(APPEND entries "\t{ \"${name}\", shader${index}, sizeof(shader${index}) - 1 },\n")
+	math(EXPR index "${index} + 1")
+endforeach()
+
+set(content "// generated by cmake/embedShaders.cmake from the shaders directory, do not edit\n")
+string(APPEND content "#include \"embeddedShaders.h\"\n\nnamespace {\n${arrays}}\n\n")
+string(APPEND content "const embeddedShader embeddedShaders[] = {\n${entries}};\n\nconst int embeddedShaderCount = ${index};\n")
+
+# only touch the output when it changes, so an unchanged shader set does not rebuild the window
+set(current "")
+if (EXISTS "${OUTPUT}")
+	file(READ "${OUTPUT}" current)
+endif()
+if (NOT current STREQUAL content)
+	file(WRITE "${OUTPUT}" "${content}")
+endif()
@@ -0,0 +1,237 @@
+#pragma once
+
+#include "cmath"
+#include "utility"
+
+/*
+ * Small matrices and vectors with their size in the type, held by value without any allocation. Every operation is
+ * constexpr and written as a fold expression over its compile-time element indices, so it is unrolled completely
+ * with constant indices and no loop left for the optimizer to decide about: a mat4 product is 64 multiply-adds of
+ * straight-line code. For thousands of them at once see matrixBatch.h.
+ */
+
+// the folds only become straight-line code once inlined, so the hot operations do not leave that to the inliner
+#if defined(_MSC_VER)
+#define SNOWLIB_FORCE_INLINE __forceinline
+#else
+#define SNOWLIB_FORCE_INLINE inline __attribute__((always_inline))
+#endif
+
+namespace fixedMatrixDetail {
+	/**
+	 * Calls body(std::integer_sequence<int, 0 .. count - 1>), whose fold over the indices then expands unrolled.
+	 */
+	template <int count, typename Body>
+	SNOWLIB_FORCE_INLINE constexpr decltype(auto) withIndices(const Body& body) {
+		return body(std::make_integer_sequence<int, count>{});
+	}
+}
+
+/**
+ * rows x cols matrix stored row after row. An aggregate, so mat<2, 2>{ 1, 2, 3, 4 } lists the elements row by row;
+ * vectors are single-column matrices (see vec).
+ */
+template <int rows, int cols, typename T = float>
+struct mat {
+	static_assert(rows > 0 && cols > 0, "a matrix needs at least one element");
+
+	T values[rows * cols] = {};
+
+	static constexpr int rowCount = rows;
+	static constexpr int colCount = cols;
+
+	constexpr T& operator()(int row, int col) { return this->values[row * cols + col]; }
+	constexpr const T& operator()(int row, int col) const { return this->values[row * cols + col]; }
+
+	// vector elements, for single-column matrices
+	constexpr T& operator[](int index) { return this->values[index]; }
+	constexpr const T& operator[](int index) const { return this->values[index]; }
+
+	constexpr T& x() requires (cols == 1) { return this->values[0]; }
+	constexpr T& y() requires (cols == 1 && rows >= 2) { return this->values[1]; }
+	constexpr T& z() requires (cols == 1 && rows >= 3) { return this->values[2]; }
+	constexpr T& w() requires (cols == 1 && rows >= 4) { return this->values[3]; }
+	constexpr const T& x() const requires (cols == 1) { return this->values[0]; }
+	constexpr const T& y() const requires (cols == 1 && rows >= 2) { return this->values[1]; }
+	constexpr const T& z() const requires (cols == 1 && rows >= 3) { return this->values[2]; }
+	constexpr const T& w() const requires (cols == 1 && rows >= 4) { return this->values[3]; }
+
+	static constexpr mat filled(T value) {
+		mat result;
+		fixedMatrixDetail::withIndices<rows * cols>([&]<int... index>(std::integer_sequence<int, index...>) {
+			((result.values[index] = value), ...);
+		});
+		return result;
+	}
+
+	static constexpr mat identity() requires (rows == cols) {
+		mat result;
+		fixedMatrixDetail::withIndices<rows>([&]<int... index>(std::integer_sequence<int, index...>) {
+			((result.values[index * cols + index] = T(1)), ...);
+		});
+		return result;
+	}
+
+	SNOWLIB_FORCE_INLINE constexpr mat& operator+=(const mat& other) {
+		fixedMatrixDetail::withIndices<rows * cols>([&]<int... index>(std::integer_sequence<int, index...>) {
+			((this->values[index] += other.values[index]), ...);
+		});
+		return *this;
+	}
+
+	SNOWLIB_FORCE_INLINE constexpr mat& operator-=(const mat& other) {
+		fixedMatrixDetail::withIndices<rows * cols>([&]<int... index>(std::integer_sequence<int, index...>) {
+			((this->values[index] -= other.values[index]), ...);
+		});
+		return *this;
+	}
+
+	SNOWLIB_FORCE_INLINE constexpr mat& operator*=(T scalar) {
+		fixedMatrixDetail::withIndices<rows * cols>([&]<int... index>(std::integer_sequence<int, index...>) {
+			((this->values[index] *= scalar), ...);
+		});
+		return *this;
+	}
+
+	SNOWLIB_FORCE_INLINE constexpr mat& operator/=(T scalar) {
+		fixedMatrixDetail::withIndices<rows * cols>([&]<int... index>(std::integer_sequence<int, index...>) {
+			((this->values[index] /= scalar), ...);
+		});
+		return *this;
+	}
+
+	friend constexpr mat operator+(mat left, const mat& right) { return left += right; }
+	friend constexpr mat operator-(mat left, const mat& right) { return left -= right; }
+	friend constexpr mat operator*(mat left, T scalar) { return left *= scalar; }
+	friend constexpr mat operator*(T scalar, mat right) { return right *= scalar; }
+	friend constexpr mat operator/(mat left, T scalar) { return left /= scalar; }
+	friend constexpr mat operator-(mat operand) { return operand *= T(-1); }
+
+	friend constexpr bool operator==(const mat& left, const mat& right) {
+		return fixedMatrixDetail::withIndices<rows * cols>([&]<int... index>(std::integer_sequence<int, index...>) {
+			return ((left.values[index] == right.values[index]) && ...);
+		});
+	}
+};
+
+template <int size, typename T = float>
+using vec = mat<size, 1, T>;
+
+using vec2 = vec<2>;
+using vec3 = vec<3>;
+using vec4 = vec<4>;
+using mat2 = mat<2, 2>;
+using mat3 = mat<3, 3>;
+using mat4 = mat<4, 4>;
+
+/**
+ * Matrix product, also a matrix applied to a vector. Every result element sums its products from step 0 upwards.
+ */
+template <int rows, int depth, int cols, typename T>
+SNOWLIB_FORCE_INLINE constexpr mat<rows, cols, T> operator*(const mat<rows, depth, T>& left, const mat<depth, cols, T>& right) {
+	mat<rows, cols, T> result;
+	// index runs over (element, step) pairs, steps innermost
+	fixedMatrixDetail::withIndices<rows * cols * depth>([&]<int... index>(std::integer_sequence<int, index...>) {
+		((result.values[index / depth] += left.values[index / depth / cols * depth + index % depth] * right.values[index % depth * cols + index / depth % cols]), ...);
+	});
+	return result;
+}
+
+template <int rows, int cols, typename T>
+SNOWLIB_FORCE_INLINE constexpr mat<cols, rows, T> transpose(const mat<rows, cols, T>& operand) {
+	mat<cols, rows, T> result;
+	fixedMatrixDetail::withIndices<rows * cols>([&]<int... index>(std::integer_sequence<int, index...>) {
+		((result.values[index] = operand.values[index % rows * cols + index / rows]), ...);
+	});
+	return result;
+}
+
+/**
+ * Product of the elements at the same position.
+ */
+template <int rows, int cols, typename T>
+SNOWLIB_FORCE_INLINE constexpr mat<rows, cols, T> elementwiseProduct(const mat<rows, cols, T>& left, const mat<rows, cols, T>& right) {
+	mat<rows, cols, T> result;
+	fixedMatrixDetail::withIndices<rows * cols>([&]<int... index>(std::integer_sequence<int, index...>) {
+		((result.values[index] = left.values[index] * right.values[index]), ...);
+	});
+	return result;
+}
+
+template <int size, typename T>
+SNOWLIB_FORCE_INLINE constexpr T dot(const vec<size, T>& left, const vec<size, T>& right) {
+	T sum = T(0);
+	fixedMatrixDetail::withIndices<size>([&]<int... index>(std::integer_sequence<int, index...>) {
+		((sum += left.values[index] * right.values[index]), ...);
+	});
+	return sum;
+}
+
+template <typename T>
+constexpr vec<3, T> cross(const vec<3, T>& left, const vec<3, T>& right) {
+	return { left[1] * right[2] - left[2] * right[1], left[2] * right[0] - left[0] * right[2], left[0] * right[1] - left[1] * right[0] };
+}
+
+template <int size, typename T>
+constexpr T lengthSquared(const vec<size, T>& operand) {
+	return dot(operand, operand);
+}
+
+template <int size, typename T>
+T length(const vec<size, T>& operand) {
+	return std::sqrt(lengthSquared(operand));
+}
+
+template <int size, typename T>
+vec<size, T> normalize(const vec<size, T>& operand) {
+	return operand / length(operand);
+}
+
+/**
+ * The matrix without one row and one column.
+ */
+template <int size, typename T>
+constexpr mat<size - 1, size - 1, T> submatrix(const mat<size, size, T>& operand, int skipRow, int skipCol) {
+	mat<size - 1, size - 1, T> result;
+	fixedMatrixDetail::withIndices<(size - 1) * (size - 1)>([&]<int... index>(std::integer_sequence<int, index...>) {
+		((result.values[index] = operand(index / (size - 1) + (index / (size - 1) >= skipRow), index % (size - 1) + (index % (size - 1) >= skipCol))), ...);
+	});
+	return result;
+}
+
+/**
+ * Expands along the first row down to 2 x 2, meant for the sizes up to 4 this header is for.
+ */
+template <int size, typename T>
+constexpr T determinant(const mat<size, size, T>& operand) {
+	if constexpr (size == 1) {
+		return operand.values[0];
+	}
+	else if constexpr (size == 2) {
+		return operand.values[0] * operand.values[3] - operand.values[1] * operand.values[2];
+	}
+	else {
+		return fixedMatrixDetail::withIndices<size>([&]<int... col>(std::integer_sequence<int, col...>) {
+			return ((operand.values[col] * determinant(submatrix(operand, 0, col)) * (col % 2 == 0 ? T(1) : T(-1))) + ...);
+		});
+	}
+}
+
+/**
+ * Inverse through the adjugate, a singular matrix gives infinities or NaNs.
+ */
+template <int size, typename T>
+constexpr mat<size, size, T> inverse(const mat<size, size, T>& operand) {
+	mat<size, size, T> result;
+	if constexpr (size == 1) {
+		result.values[0] = T(1) / operand.values[0];
+	}
+	else {
+		T scale = T(1) / determinant(operand);
+		// element (row, col) is the cofactor of (col, row)
+		fixedMatrixDetail::withIndices<size * size>([&]<int... index>(std::integer_sequence<int, index...>) {
+			((result.values[index] = determinant(submatrix(operand, index % size, index / size)) * ((index / size + index % size) % 2 == 0 ? scale : -scale)), ...);
+		});
+	}
+	return result;
+}
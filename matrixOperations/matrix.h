@@ -0,0 +1,499 @@
+#pragma once
+
+#include "algorithm"
+#include "cassert"
+#include "cmath"
+#include "cstddef"
+#include "type_traits"
+#include "memory/alignedAllocator.h"
+#include "memory/frameArena.h"
+
+/*
+ * Dense matrices, views into them and element-wise expressions evaluated lazily.
+ *
+ * a + b - c * s builds a tree of small expression objects and computes nothing; the work happens once the tree is
+ * assigned, in a single loop over the result that reads every operand element once. Assigning into a matrix of the
+ * right shape or into a view allocates nothing, constructing a matrix from an expression allocates its storage once.
+ *
+ * Expressions read their operands where they are, so a destination may only appear in its own expression at the
+ * same position (m = m * 2 + a is fine, m = m.transpose() is not, evaluate into another matrix first).
+ */
+
+template <typename T>
+class matrix;
+
+template <typename T>
+class matrixView;
+
+/**
+ * Base of everything usable as a matrix operand, Derived being the concrete class. Every operand provides
+ * getRows(), getCols(), unitStride() (whether all elements it reads lie next to each other within a row) and
+ * reader<unit>(row), a small object whose operator[](col) gives the element of that row; with unit set it may
+ * assume unitStride(), so evaluation of contiguous rows becomes plain indexed loops the compiler vectorizes.
+ */
+template <typename Derived>
+class matrixExpression {
+public:
+	const Derived& derived() const { return static_cast<const Derived&>(*this); }
+};
+
+namespace matrixDetail {
+	template <typename T, bool unit>
+	struct rowReader {
+		const T* row;
+		std::ptrdiff_t colStride;
+
+		T operator[](int col) const {
+			if constexpr (unit) {
+				return this->row[col];
+			}
+			else {
+				return this->row[col * this->colStride];
+			}
+		}
+	};
+
+	// matrices are held by reference inside expressions, views and other expressions are small and copied
+	template <typename E>
+	struct operand {
+		using type = const E;
+	};
+
+	template <typename T>
+	struct operand<matrix<T>> {
+		using type = const matrix<T>&;
+	};
+
+	template <typename E>
+	using operandType = typename operand<E>::type;
+
+	struct addOperation {
+		template <typename T>
+		static T apply(T left, T right) { return left + right; }
+	};
+
+	struct subtractOperation {
+		template <typename T>
+		static T apply(T left, T right) { return left - right; }
+	};
+
+	struct multiplyOperation {
+		template <typename T>
+		static T apply(T left, T right) { return left * right; }
+	};
+
+	struct divideOperation {
+		template <typename T>
+		static T apply(T left, T right) { return left / right; }
+	};
+
+	struct negateOperation {
+		template <typename T>
+		static T apply(T value) { return -value; }
+	};
+
+	struct absOperation {
+		template <typename T>
+		static T apply(T value) { return std::abs(value); }
+	};
+}
+
+/**
+ * Non-owning window onto matrix elements, row r and column c at data()[r * rowStride + c * colStride]. Blocks,
+ * single rows and columns and transposes of a view are views again, sharing the elements. Assigning to a view
+ * writes its elements, as does assigning one view to another; copying a view only copies the window.
+ * matrixView<const T> gives read-only access.
+ */
+template <typename T>
+class matrixView : public matrixExpression<matrixView<T>> {
+
+protected:
+	T* values = nullptr;
+	int rows = 0;
+	int cols = 0;
+	std::ptrdiff_t rowStride = 0;
+	std::ptrdiff_t colStride = 1;
+
+public:
+	using valueType = std::remove_const_t<T>;
+
+	matrixView() = default;
+
+	/**
+	 * View of rows * cols elements stored row after row without padding.
+	 */
+	matrixView(T* values, int rows, int cols) : matrixView(values, rows, cols, cols, 1) {}
+
+	/**
+	 * @param values Element (0, 0).
+	 * @param rows Number of rows.
+	 * @param cols Number of columns.
+	 * @param rowStride Elements from one row to the next.
+	 * @param colStride Elements from one column to the next.
+	 */
+	matrixView(T* values, int rows, int cols, std::ptrdiff_t rowStride, std::ptrdiff_t colStride) {
+		this->values = values;
+		this->rows = rows;
+		this->cols = cols;
+		this->rowStride = rowStride;
+		this->colStride = colStride;
+	}
+
+	matrixView(const matrixView&) = default;
+
+	// a read-only view of the same elements
+	template <typename U, typename = std::enable_if_t<std::is_same_v<const U, T> && !std::is_same_v<U, T>>>
+	matrixView(const matrixView<U>& other)
+		: matrixView(other.data(), other.getRows(), other.getCols(), other.getRowStride(), other.getColStride()) {}
+
+	matrixView& operator=(const matrixView& other) {
+		return this->assign(other);
+	}
+
+	template <typename E>
+	matrixView& operator=(const matrixExpression<E>& expression) {
+		return this->assign(expression.derived());
+	}
+
+	template <typename E>
+	matrixView& operator+=(const matrixExpression<E>& expression) {
+		return this->assign(*this + expression);
+	}
+
+	template <typename E>
+	matrixView& operator-=(const matrixExpression<E>& expression) {
+		return this->assign(*this - expression);
+	}
+
+	matrixView& operator*=(valueType scalar) {
+		return this->assign(*this * scalar);
+	}
+
+	int getRows() const { return this->rows; }
+	int getCols() const { return this->cols; }
+	std::ptrdiff_t getRowStride() const { return this->rowStride; }
+	std::ptrdiff_t getColStride() const { return this->colStride; }
+	T* data() const { return this->values; }
+
+	T& operator()(int row, int col) const { return this->values[row * this->rowStride + col * this->colStride]; }
+
+	/**
+	 * rows * cols elements starting at (row, col).
+	 */
+	matrixView block(int row, int col, int rows, int cols) const {
+		assert(row >= 0 && col >= 0 && row + rows <= this->rows && col + cols <= this->cols);
+		return matrixView(&(*this)(row, col), rows, cols, this->rowStride, this->colStride);
+	}
+
+	matrixView row(int row) const { return this->block(row, 0, 1, this->cols); }
+	matrixView col(int col) const { return this->block(0, col, this->rows, 1); }
+
+	/**
+	 * The same elements with rows and columns swapped.
+	 */
+	matrixView transpose() const { return matrixView(this->values, this->cols, this->rows, this->colStride, this->rowStride); }
+
+	bool unitStride() const { return this->colStride == 1; }
+
+	template <bool unit>
+	matrixDetail::rowReader<valueType, unit> reader(int row) const {
+		return { this->values + row * this->rowStride, this->colStride };
+	}
+
+	/**
+	 * Writes an expression of the same shape into the elements, in one pass without temporaries.
+	 */
+	template <typename E>
+	matrixView& assign(const E& expression);
+};
+
+/**
+ * Matrix owning its elements, stored row after row without padding in cache line aligned memory.
+ */
+template <typename T>
+class matrix : public matrixExpression<matrix<T>> {
+
+protected:
+	int rows = 0;
+	int cols = 0;
+	alignedVector<T> values;
+
+public:
+	using valueType = T;
+
+	matrix() = default;
+
+	/**
+	 * @param rows Number of rows.
+	 * @param cols Number of columns.
+	 * @param initialValue Value every element starts with.
+	 * @param resource Where the elements are allocated, nullptr for the heap, e.g. &matrixScratchArena() for a temporary.
+	 */
+	matrix(int rows, int cols, T initialValue = T(), std::pmr::memory_resource* resource = nullptr)
+		: rows(rows), cols(cols), values(std::size_t(rows) * std::size_t(cols), initialValue, alignedAllocator<T>(resource)) {}
+
+	/**
+	 * Evaluates an expression into new storage, the only allocation the expression makes.
+	 */
+	template <typename E>
+	matrix(const matrixExpression<E>& expression, std::pmr::memory_resource* resource = nullptr)
+		: rows(expression.derived().getRows()), cols(expression.derived().getCols()), values(std::size_t(rows) * std::size_t(cols), alignedAllocator<T>(resource)) {
+		this->view().assign(expression.derived());
+	}
+
+	matrix(const matrix&) = default;
+	matrix(matrix&&) noexcept = default;
+	matrix& operator=(const matrix&) = default;
+	matrix& operator=(matrix&&) noexcept = default;
+
+	/**
+	 * Evaluates an expression into the matrix, reusing its storage when the shape already matches.
+	 */
+	template <typename E>
+	matrix& operator=(const matrixExpression<E>& expression) {
+		const E& source = expression.derived();
+		if (source.getRows() != this->rows || source.getCols() != this->cols) {
+			// the expression may read this matrix only where shapes match, so resizing cannot pull storage from under it
+			this->resize(source.getRows(), source.getCols());
+		}
+		this->view().assign(source);
+		return *this;
+	}
+
+	template <typename E>
+	matrix& operator+=(const matrixExpression<E>& expression) {
+		this->view() += expression;
+		return *this;
+	}
+
+	template <typename E>
+	matrix& operator-=(const matrixExpression<E>& expression) {
+		this->view() -= expression;
+		return *this;
+	}
+
+	matrix& operator*=(T scalar) {
+		this->view() *= scalar;
+		return *this;
+	}
+
+	/**
+	 * Changes the shape, elements are left unspecified when the element count changes.
+	 */
+	void resize(int rows, int cols) {
+		this->rows = rows;
+		this->cols = cols;
+		this->values.resize(std::size_t(rows) * std::size_t(cols));
+	}
+
+	int getRows() const { return this->rows; }
+	int getCols() const { return this->cols; }
+	std::pmr::memory_resource* getResource() const { return this->values.get_allocator().getResource(); }
+	T* data() { return this->values.data(); }
+	const T* data() const { return this->values.data(); }
+
+	T& operator()(int row, int col) { return this->values[std::size_t(row) * this->cols + col]; }
+	T operator()(int row, int col) const { return this->values[std::size_t(row) * this->cols + col]; }
+
+	matrixView<T> view() { return matrixView<T>(this->values.data(), this->rows, this->cols); }
+	matrixView<const T> view() const { return matrixView<const T>(this->values.data(), this->rows, this->cols); }
+
+	operator matrixView<T>() { return this->view(); }
+	operator matrixView<const T>() const { return this->view(); }
+
+	matrixView<T> block(int row, int col, int rows, int cols) { return this->view().block(row, col, rows, cols); }
+	matrixView<const T> block(int row, int col, int rows, int cols) const { return this->view().block(row, col, rows, cols); }
+	matrixView<T> row(int row) { return this->view().row(row); }
+	matrixView<const T> row(int row) const { return this->view().row(row); }
+	matrixView<T> col(int col) { return this->view().col(col); }
+	matrixView<const T> col(int col) const { return this->view().col(col); }
+	matrixView<T> transpose() { return this->view().transpose(); }
+	matrixView<const T> transpose() const { return this->view().transpose(); }
+
+	void fill(T value) {
+		std::fill(this->values.begin(), this->values.end(), value);
+	}
+
+	bool unitStride() const { return true; }
+
+	template <bool unit>
+	matrixDetail::rowReader<T, unit> reader(int row) const {
+		return { this->values.data() + std::size_t(row) * this->cols, 1 };
+	}
+};
+
+/**
+ * Arena of the calling thread for matrix temporaries: matrices made with it, matrixProduct(left, right,
+ * &matrixScratchArena()) included, take no heap memory once it has grown to the largest frame. Whoever owns the
+ * frame calls reset() on it, or a frameArenaScope gives back what one computation took.
+ */
+inline frameArena& matrixScratchArena() {
+	thread_local frameArena arena;
+	return arena;
+}
+
+/**
+ * Element-wise combination of two operands of the same shape.
+ */
+template <typename Left, typename Right, typename Operation>
+class binaryExpression : public matrixExpression<binaryExpression<Left, Right, Operation>> {
+
+public:
+	using valueType = typename Left::valueType;
+	static_assert(std::is_same_v<valueType, typename Right::valueType>, "operands must have the same element type");
+
+protected:
+	matrixDetail::operandType<Left> left;
+	matrixDetail::operandType<Right> right;
+
+public:
+	binaryExpression(const Left& left, const Right& right) : left(left), right(right) {
+		assert(left.getRows() == right.getRows() && left.getCols() == right.getCols());
+	}
+
+	int getRows() const { return this->left.getRows(); }
+	int getCols() const { return this->left.getCols(); }
+	bool unitStride() const { return this->left.unitStride() && this->right.unitStride(); }
+
+	template <bool unit>
+	auto reader(int row) const {
+		struct combinedReader {
+			decltype(std::declval<const Left&>().template reader<unit>(0)) left;
+			decltype(std::declval<const Right&>().template reader<unit>(0)) right;
+
+			valueType operator[](int col) const { return Operation::apply(this->left[col], this->right[col]); }
+		};
+		return combinedReader{ this->left.template reader<unit>(row), this->right.template reader<unit>(row) };
+	}
+};
+
+/**
+ * Every element of an operand combined with the same scalar, scalar on the right.
+ */
+template <typename Operand, typename Operation>
+class scalarExpression : public matrixExpression<scalarExpression<Operand, Operation>> {
+
+public:
+	using valueType = typename Operand::valueType;
+
+protected:
+	matrixDetail::operandType<Operand> operand;
+	valueType scalar;
+
+public:
+	scalarExpression(const Operand& operand, valueType scalar) : operand(operand), scalar(scalar) {}
+
+	int getRows() const { return this->operand.getRows(); }
+	int getCols() const { return this->operand.getCols(); }
+	bool unitStride() const { return this->operand.unitStride(); }
+
+	template <bool unit>
+	auto reader(int row) const {
+		struct scaledReader {
+			decltype(std::declval<const Operand&>().template reader<unit>(0)) operand;
+			valueType scalar;
+
+			valueType operator[](int col) const { return Operation::apply(this->operand[col], this->scalar); }
+		};
+		return scaledReader{ this->operand.template reader<unit>(row), this->scalar };
+	}
+};
+
+/**
+ * A function applied to every element of an operand.
+ */
+template <typename Operand, typename Operation>
+class unaryExpression : public matrixExpression<unaryExpression<Operand, Operation>> {
+
+public:
+	using valueType = typename Operand::valueType;
+
+protected:
+	matrixDetail::operandType<Operand> operand;
+
+public:
+	explicit unaryExpression(const Operand& operand) : operand(operand) {}
+
+	int getRows() const { return this->operand.getRows(); }
+	int getCols() const { return this->operand.getCols(); }
+	bool unitStride() const { return this->operand.unitStride(); }
+
+	template <bool unit>
+	auto reader(int row) const {
+		struct mappedReader {
+			decltype(std::declval<const Operand&>().template reader<unit>(0)) operand;
+
+			valueType operator[](int col) const { return Operation::apply(this->operand[col]); }
+		};
+		return mappedReader{ this->operand.template reader<unit>(row) };
+	}
+};
+
+template <typename T>
+template <typename E>
+matrixView<T>& matrixView<T>::assign(const E& expression) {
+	static_assert(!std::is_const_v<T>, "cannot assign to a read-only view");
+	assert(expression.getRows() == this->rows && expression.getCols() == this->cols);
+	if (this->unitStride() && expression.unitStride()) {
+		for (int row = 0; row < this->rows; ++row) {
+			T* out = this->values + row * this->rowStride;
+			auto in = expression.template reader<true>(row);
+			for (int col = 0; col < this->cols; ++col) {
+				out[col] = in[col];
+			}
+		}
+	}
+	else {
+		for (int row = 0; row < this->rows; ++row) {
+			T* out = this->values + row * this->rowStride;
+			auto in = expression.template reader<false>(row);
+			for (int col = 0; col < this->cols; ++col) {
+				out[col * this->colStride] = in[col];
+			}
+		}
+	}
+	return *this;
+}
+
+template <typename Left, typename Right>
+binaryExpression<Left, Right, matrixDetail::addOperation> operator+(const matrixExpression<Left>& left, const matrixExpression<Right>& right) {
+	return { left.derived(), right.derived() };
+}
+
+template <typename Left, typename Right>
+binaryExpression<Left, Right, matrixDetail::subtractOperation> operator-(const matrixExpression<Left>& left, const matrixExpression<Right>& right) {
+	return { left.derived(), right.derived() };
+}
+
+/**
+ * Product of the elements at the same position, the matrix product is matrixMultiply().
+ */
+template <typename Left, typename Right>
+binaryExpression<Left, Right, matrixDetail::multiplyOperation> elementwiseProduct(const matrixExpression<Left>& left, const matrixExpression<Right>& right) {
+	return { left.derived(), right.derived() };
+}
+
+template <typename Operand>
+scalarExpression<Operand, matrixDetail::multiplyOperation> operator*(const matrixExpression<Operand>& operand, typename Operand::valueType scalar) {
+	return { operand.derived(), scalar };
+}
+
+template <typename Operand>
+scalarExpression<Operand, matrixDetail::multiplyOperation> operator*(typename Operand::valueType scalar, const matrixExpression<Operand>& operand) {
+	return { operand.derived(), scalar };
+}
+
+template <typename Operand>
+scalarExpression<Operand, matrixDetail::divideOperation> operator/(const matrixExpression<Operand>& operand, typename Operand::valueType scalar) {
+	return { operand.derived(), scalar };
+}
+
+template <typename Operand>
+unaryExpression<Operand, matrixDetail::negateOperation> operator-(const matrixExpression<Operand>& operand) {
+	return unaryExpression<Operand, matrixDetail::negateOperation>(operand.derived());
+}
+
+template <typename Operand>
+unaryExpression<Operand, matrixDetail::absOperation> elementwiseAbs(const matrixExpression<Operand>& operand) {
+	return unaryExpression<Operand, matrixDetail::absOperation>(operand.derived());
+}
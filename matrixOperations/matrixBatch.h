@@ -0,0 +1,141 @@
+#pragma once
+
+#include "algorithm"
+#include "fixedMatrix.h"
+#include "memory/alignedAllocator.h"
+
+/*
+ * Thousands of small matrices or vectors of one size, stored structure-of-arrays in chunks of batchChunk items:
+ * within a chunk, element (row, col) of its batchChunk matrices lies in one contiguous run. An operation on the
+ * batch is the fixed-size operation unrolled over the elements with every step running over a whole run in SIMD
+ * width, and a chunk is one contiguous block of memory, so a batch streams through the caches no matter how many
+ * elements a matrix has. The last chunk is padded with zeros, so the loops need no remainder handling.
+ */
+
+inline constexpr int batchChunk = 16;
+
+/**
+ * count matrices of rows x cols.
+ */
+template <int rows, int cols, typename T = float>
+class matrixBatch {
+
+protected:
+	static constexpr int elements = rows * cols;
+
+	int count = 0;
+	int chunkCount = 0;
+	alignedVector<T> values;
+
+public:
+	matrixBatch() = default;
+
+	/**
+	 * @param count Number of matrices, all zero.
+	 */
+	explicit matrixBatch(int count) {
+		this->resize(count);
+	}
+
+	/**
+	 * Changes the number of matrices, all of them zero afterwards.
+	 */
+	void resize(int count) {
+		this->count = count;
+		this->chunkCount = (count + batchChunk - 1) / batchChunk;
+		this->values.assign(std::size_t(this->chunkCount) * elements * batchChunk, T(0));
+	}
+
+	int size() const { return this->count; }
+	int getChunkCount() const { return this->chunkCount; }
+
+	/**
+	 * Element (row, col) of the batchChunk matrices of one chunk, matrix chunk * batchChunk + i at index i.
+	 */
+	T* run(int chunk, int row, int col) { return this->values.data() + (std::size_t(chunk) * elements + row * cols + col) * batchChunk; }
+	const T* run(int chunk, int row, int col) const { return this->values.data() + (std::size_t(chunk) * elements + row * cols + col) * batchChunk; }
+
+	mat<rows, cols, T> get(int index) const {
+		const T* chunk = this->values.data() + std::size_t(index / batchChunk) * elements * batchChunk + index % batchChunk;
+		mat<rows, cols, T> result;
+		fixedMatrixDetail::withIndices<elements>([&]<int... element>(std::integer_sequence<int, element...>) {
+			((result.values[element] = chunk[element * batchChunk]), ...);
+		});
+		return result;
+	}
+
+	void set(int index, const mat<rows, cols, T>& value) {
+		T* chunk = this->values.data() + std::size_t(index / batchChunk) * elements * batchChunk + index % batchChunk;
+		fixedMatrixDetail::withIndices<elements>([&]<int... element>(std::integer_sequence<int, element...>) {
+			((chunk[element * batchChunk] = value.values[element]), ...);
+		});
+	}
+};
+
+template <int size, typename T = float>
+using vectorBatch = matrixBatch<size, 1, T>;
+
+namespace fixedMatrixDetail {
+	/**
+	 * result[i] += left[i] * right[i] over one run, a fixed trip count over arrays that cannot alias.
+	 */
+	template <typename T>
+	SNOWLIB_FORCE_INLINE void multiplyAddRun(T* __restrict result, const T* __restrict left, const T* __restrict right) {
+		for (int item = 0; item < batchChunk; ++item) {
+			result[item] += left[item] * right[item];
+		}
+	}
+
+	/**
+	 * result[i] += scalar * operand[i] over one run.
+	 */
+	template <typename T>
+	SNOWLIB_FORCE_INLINE void scaleAddRun(T* __restrict result, T scalar, const T* __restrict operand) {
+		for (int item = 0; item < batchChunk; ++item) {
+			result[item] += scalar * operand[item];
+		}
+	}
+}
+
+/**
+ * result[i] = left[i] * right[i] for every i. result may be left or right.
+ */
+template <int rows, int depth, int cols, typename T>
+void multiplyBatch(const matrixBatch<rows, depth, T>& left, const matrixBatch<depth, cols, T>& right, matrixBatch<rows, cols, T>& result) {
+	if (result.size() != left.size()) {
+		result.resize(left.size());
+	}
+	for (int chunk = 0; chunk < left.getChunkCount(); ++chunk) {
+		// copies on the stack cannot alias, so every run vectorizes without runtime overlap checks
+		alignas(64) T leftItems[rows * depth * batchChunk];
+		alignas(64) T rightItems[depth * cols * batchChunk];
+		alignas(64) T resultItems[rows * cols * batchChunk] = {};
+		std::copy_n(left.run(chunk, 0, 0), rows * depth * batchChunk, leftItems);
+		std::copy_n(right.run(chunk, 0, 0), depth * cols * batchChunk, rightItems);
+		// the fixed-size product with every multiply-add running over a whole run, same (element, step) order
+		fixedMatrixDetail::withIndices<rows * cols * depth>([&]<int... index>(std::integer_sequence<int, index...>) {
+			(fixedMatrixDetail::multiplyAddRun(resultItems + index / depth * batchChunk, leftItems + (index / depth / cols * depth + index % depth) * batchChunk,
+				rightItems + (index % depth * cols + index / depth % cols) * batchChunk), ...);
+		});
+		std::copy_n(resultItems, rows * cols * batchChunk, result.run(chunk, 0, 0));
+	}
+}
+
+/**
+ * result[i] = transform * vectors[i] for every i, one matrix applied to a whole batch. result may be vectors.
+ */
+template <int rows, int cols, typename T>
+void transformBatch(const mat<rows, cols, T>& transform, const vectorBatch<cols, T>& vectors, vectorBatch<rows, T>& result) {
+	if (result.size() != vectors.size()) {
+		result.resize(vectors.size());
+	}
+	for (int chunk = 0; chunk < vectors.getChunkCount(); ++chunk) {
+		alignas(64) T vectorItems[cols * batchChunk];
+		alignas(64) T resultItems[rows * batchChunk] = {};
+		std::copy_n(vectors.run(chunk, 0, 0), cols * batchChunk, vectorItems);
+		fixedMatrixDetail::withIndices<rows * cols>([&]<int... index>(std::integer_sequence<int, index...>) {
+			(fixedMatrixDetail::scaleAddRun(resultItems + index / cols * batchChunk, transform.values[index], vectorItems + index % cols * batchChunk), ...);
+		});
+		std::copy_n(resultItems, rows * batchChunk, result.run(chunk, 0, 0));
+	}
+}
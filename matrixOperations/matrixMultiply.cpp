@@ -0,0 +1,232 @@
+#include "matrixMultiply.h"
+#include "matrixMultiplyKernels.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+namespace {
+	// rows of the right operand packed at once, a kernelCols wide sliver of them stays in L1
+	constexpr int blockDepth = 256;
+	// rows of the left operand packed at once, blockRows x blockDepth stays in L2
+	constexpr int blockRows = 168;
+	// columns of the right operand packed at once, blockDepth x blockCols stays in L3
+	constexpr int blockCols = 4080;
+	// products of fewer multiply-adds run on the calling thread alone
+	constexpr double parallelThreshold = 64.0 * 64.0 * 64.0;
+
+	void genericKernel(int depth, const float* packedLeft, const float* packedRight, float* result, std::ptrdiff_t rowStride, bool accumulate) {
+		// fixed bounds, so the compiler keeps the tile in vector registers on whatever the baseline is
+		float sums[kernelRows][kernelCols] = {};
+		for (int step = 0; step < depth; ++step) {
+			for (int row = 0; row < kernelRows; ++row) {
+				float left = packedLeft[row];
+				for (int col = 0; col < kernelCols; ++col) {
+					sums[row][col] += left * packedRight[col];
+				}
+			}
+			packedLeft += kernelRows;
+			packedRight += kernelCols;
+		}
+		for (int row = 0; row < kernelRows; ++row) {
+			float* out = result + row * rowStride;
+			for (int col = 0; col < kernelCols; ++col) {
+				out[col] = accumulate ? out[col] + sums[row][col] : sums[row][col];
+			}
+		}
+	}
+
+	bool processorHasAvx2() {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+		int registers[4];
+		__cpuid(registers, 0);
+		if (registers[0] < 7) {
+			return false;
+		}
+		__cpuid(registers, 1);
+		bool fma = (registers[2] & (1 << 12)) != 0;
+		bool osSavesRegisters = (registers[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+		__cpuidex(registers, 7, 0);
+		bool avx2 = (registers[1] & (1 << 5)) != 0;
+		return fma && osSavesRegisters && avx2;
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+		return false;
+#endif
+	}
+
+	struct kernelChoice {
+		matrixMultiplyKernel kernel = genericKernel;
+		const char* name = "generic";
+
+		kernelChoice() {
+			const char* forced = std::getenv("SNOWLIB_GEMM");
+			if (forced != nullptr && std::strcmp(forced, "generic") == 0) {
+				return;
+			}
+			matrixMultiplyKernel avx2 = avx2MatrixMultiplyKernel();
+			if (avx2 != nullptr && processorHasAvx2()) {
+				this->kernel = avx2;
+				this->name = "avx2";
+			}
+		}
+	};
+
+	const kernelChoice& chosenKernel() {
+		static const kernelChoice choice;
+		return choice;
+	}
+
+	// packing space reused by every product a thread takes part in, packed slivers start on cache lines
+	thread_local alignedVector<float> packedLeftBuffer;
+	thread_local alignedVector<float> packedRightBuffer;
+
+	/**
+	 * Copies rows x depth elements of left from (row, depthStart) into slivers of kernelRows rows, each stored
+	 * column after column. The last sliver is padded with zeros.
+	 */
+	void packLeft(const matrixView<const float>& left, int row, int rows, int depthStart, int depth, float* packed) {
+		for (int sliver = 0; sliver < rows; sliver += kernelRows) {
+			int sliverRows = std::min(kernelRows, rows - sliver);
+			for (int step = 0; step < depth; ++step) {
+				for (int index = 0; index < kernelRows; ++index) {
+					packed[index] = index < sliverRows ? left(row + sliver + index, depthStart + step) : 0.0f;
+				}
+				packed += kernelRows;
+			}
+		}
+	}
+
+	/**
+	 * Copies slivers [firstSliver, lastSliver) of the depth x cols panel of right at (depthStart, col), each
+	 * kernelCols columns stored row after row. The last sliver is padded with zeros.
+	 */
+	void packRight(const matrixView<const float>& right, int depthStart, int depth, int col, int cols, int firstSliver, int lastSliver, float* packed) {
+		for (int sliver = firstSliver; sliver < lastSliver; ++sliver) {
+			int sliverCol = sliver * kernelCols;
+			int sliverCols = std::min(kernelCols, cols - sliverCol);
+			float* out = packed + std::size_t(sliver) * kernelCols * depth;
+			for (int step = 0; step < depth; ++step) {
+				const float* in = &right(depthStart + step, col + sliverCol);
+				std::ptrdiff_t stride = right.getColStride();
+				for (int index = 0; index < kernelCols; ++index) {
+					out[index] = index < sliverCols ? in[index * stride] : 0.0f;
+				}
+				out += kernelCols;
+			}
+		}
+	}
+
+	/**
+	 * Multiplies a packed block of the left operand with the packed panel of the right one into result.
+	 */
+	void multiplyBlock(matrixMultiplyKernel kernel, const float* packedLeft, const float* packedRight, const matrixView<float>& result, int row, int rows,
+		int col, int cols, int depth, bool accumulate) {
+		bool unitCols = result.getColStride() == 1;
+		for (int sliverCol = 0; sliverCol < cols; sliverCol += kernelCols) {
+			int tileCols = std::min(kernelCols, cols - sliverCol);
+			const float* right = packedRight + std::size_t(sliverCol / kernelCols) * kernelCols * depth;
+			for (int sliverRow = 0; sliverRow < rows; sliverRow += kernelRows) {
+				int tileRows = std::min(kernelRows, rows - sliverRow);
+				const float* left = packedLeft + std::size_t(sliverRow / kernelRows) * kernelRows * depth;
+				float* out = &result(row + sliverRow, col + sliverCol);
+				if (unitCols && tileRows == kernelRows && tileCols == kernelCols) {
+					kernel(depth, left, right, out, result.getRowStride(), accumulate);
+					continue;
+				}
+				// edge tiles and strided results go through a full tile on the stack
+				alignas(64) float tile[kernelRows * kernelCols];
+				kernel(depth, left, right, tile, kernelCols, false);
+				for (int tileRow = 0; tileRow < tileRows; ++tileRow) {
+					for (int tileCol = 0; tileCol < tileCols; ++tileCol) {
+						float& element = result(row + sliverRow + tileRow, col + sliverCol + tileCol);
+						element = accumulate ? element + tile[tileRow * kernelCols + tileCol] : tile[tileRow * kernelCols + tileCol];
+					}
+				}
+			}
+		}
+	}
+}
+
+threadPool& matrixThreadPool() {
+	static threadPool pool;
+	return pool;
+}
+
+const char* matrixMultiplyInstructionSet() {
+	return chosenKernel().name;
+}
+
+void matrixMultiply(matrixView<const float> left, matrixView<const float> right, matrixView<float> result) {
+	assert(left.getCols() == right.getRows() && result.getRows() == left.getRows() && result.getCols() == right.getCols());
+	int rows = result.getRows();
+	int cols = result.getCols();
+	int depth = left.getCols();
+	if (rows == 0 || cols == 0) {
+		return;
+	}
+	if (depth == 0) {
+		for (int row = 0; row < rows; ++row) {
+			for (int col = 0; col < cols; ++col) {
+				result(row, col) = 0.0f;
+			}
+		}
+		return;
+	}
+
+	matrixMultiplyKernel kernel = chosenKernel().kernel;
+	threadPool& pool = matrixThreadPool();
+	bool parallel = double(rows) * double(cols) * double(depth) >= parallelThreshold && pool.getThreadCount() > 1;
+
+	// enough row blocks for every thread, in whole slivers
+	int threads = parallel ? pool.getThreadCount() : 1;
+	int rowsPerBlock = (rows + threads - 1) / threads;
+	rowsPerBlock = std::min(blockRows, (rowsPerBlock + kernelRows - 1) / kernelRows * kernelRows);
+	int rowBlocks = (rows + rowsPerBlock - 1) / rowsPerBlock;
+
+	alignedVector<float>& packedRight = packedRightBuffer;
+	for (int col = 0; col < cols; col += blockCols) {
+		int panelCols = std::min(blockCols, cols - col);
+		int slivers = (panelCols + kernelCols - 1) / kernelCols;
+		for (int depthStart = 0; depthStart < depth; depthStart += blockDepth) {
+			int panelDepth = std::min(blockDepth, depth - depthStart);
+			// the first panel of the depth writes the result, the others add to it
+			bool accumulate = depthStart > 0;
+
+			packedRight.resize(std::size_t(slivers) * kernelCols * panelDepth);
+			float* packedPanel = packedRight.data();
+			auto packSlivers = [&](int from, int to) {
+				packRight(right, depthStart, panelDepth, col, panelCols, from, to, packedPanel);
+			};
+			auto multiplyBlocks = [&](int from, int to) {
+				alignedVector<float>& packedLeft = packedLeftBuffer;
+				packedLeft.resize(std::size_t(rowsPerBlock + kernelRows) * panelDepth);
+				for (int block = from; block < to; ++block) {
+					int row = block * rowsPerBlock;
+					int blockRowCount = std::min(rowsPerBlock, rows - row);
+					packLeft(left, row, blockRowCount, depthStart, panelDepth, packedLeft.data());
+					multiplyBlock(kernel, packedLeft.data(), packedPanel, result, row, blockRowCount, col, panelCols, panelDepth, accumulate);
+				}
+			};
+
+			if (parallel) {
+				pool.parallelFor(0, slivers, packSlivers);
+				pool.parallelFor(0, rowBlocks, multiplyBlocks);
+			}
+			else {
+				packSlivers(0, slivers);
+				multiplyBlocks(0, rowBlocks);
+			}
+		}
+	}
+}
+
+matrix<float> matrixProduct(matrixView<const float> left, matrixView<const float> right, std::pmr::memory_resource* resource) {
+	matrix<float> result(left.getRows(), right.getCols(), 0.0f, resource);
+	matrixMultiply(left, right, result.view());
+	return result;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "matrix.h"
+#include "threading/threadPool.h"
+
+/*
+ * Matrix product of float matrices, blocked for the caches the way BLAS implementations do it: the right operand is
+ * packed in panels of blockDepth rows that stay in L3, the left one in blocks that stay in L2, and a register-blocked
+ * micro-kernel multiplies a 6 x 16 tile of the result out of the packed data. The micro-kernel uses AVX2 and FMA when
+ * the processor running the program has them, whatever the build flags, and portable code the compiler vectorizes
+ * otherwise. Blocks of result rows are shared out over matrixThreadPool().
+ */
+
+/**
+ * result = left * right for left of M x K, right of K x N and result of M x N. The views may have any strides (a
+ * transpose costs nothing), result must not overlap either operand.
+ */
+void matrixMultiply(matrixView<const float> left, matrixView<const float> right, matrixView<float> result);
+
+/**
+ * left * right in a new matrix, allocated from resource when one is given.
+ */
+matrix<float> matrixProduct(matrixView<const float> left, matrixView<const float> right, std::pmr::memory_resource* resource = nullptr);
+
+/**
+ * Threads the products run on, the hardware concurrency unless changed with setThreadCount().
+ */
+threadPool& matrixThreadPool();
+
+/**
+ * Micro-kernel the products use, "avx2" or "generic". Setting the environment variable SNOWLIB_GEMM to generic
+ * forces the portable one, e.g. to compare the two.
+ */
+const char* matrixMultiplyInstructionSet();
@@ -0,0 +1,64 @@
+#include "matrixMultiplyKernels.h"
+
+// built with AVX2 and FMA enabled for this file alone, it only runs once matrixMultiply.cpp found both at runtime
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+#include <immintrin.h>
+
+namespace {
+	void avx2Kernel(int depth, const float* packedLeft, const float* packedRight, float* result, std::ptrdiff_t rowStride, bool accumulate) {
+		static_assert(kernelRows == 6 && kernelCols == 16, "the kernel holds a 6 x 16 tile in 12 registers");
+		__m256 sum00 = _mm256_setzero_ps(), sum01 = _mm256_setzero_ps();
+		__m256 sum10 = _mm256_setzero_ps(), sum11 = _mm256_setzero_ps();
+		__m256 sum20 = _mm256_setzero_ps(), sum21 = _mm256_setzero_ps();
+		__m256 sum30 = _mm256_setzero_ps(), sum31 = _mm256_setzero_ps();
+		__m256 sum40 = _mm256_setzero_ps(), sum41 = _mm256_setzero_ps();
+		__m256 sum50 = _mm256_setzero_ps(), sum51 = _mm256_setzero_ps();
+
+		for (int step = 0; step < depth; ++step) {
+			__m256 right0 = _mm256_load_ps(packedRight);
+			__m256 right1 = _mm256_load_ps(packedRight + 8);
+			__m256 left = _mm256_broadcast_ss(packedLeft + 0);
+			sum00 = _mm256_fmadd_ps(left, right0, sum00);
+			sum01 = _mm256_fmadd_ps(left, right1, sum01);
+			left = _mm256_broadcast_ss(packedLeft + 1);
+			sum10 = _mm256_fmadd_ps(left, right0, sum10);
+			sum11 = _mm256_fmadd_ps(left, right1, sum11);
+			left = _mm256_broadcast_ss(packedLeft + 2);
+			sum20 = _mm256_fmadd_ps(left, right0, sum20);
+			sum21 = _mm256_fmadd_ps(left, right1, sum21);
+			left = _mm256_broadcast_ss(packedLeft + 3);
+			sum30 = _mm256_fmadd_ps(left, right0, sum30);
+			sum31 = _mm256_fmadd_ps(left, right1, sum31);
+			left = _mm256_broadcast_ss(packedLeft + 4);
+			sum40 = _mm256_fmadd_ps(left, right0, sum40);
+			sum41 = _mm256_fmadd_ps(left, right1, sum41);
+			left = _mm256_broadcast_ss(packedLeft + 5);
+			sum50 = _mm256_fmadd_ps(left, right0, sum50);
+			sum51 = _mm256_fmadd_ps(left, right1, sum51);
+			packedLeft += kernelRows;
+			packedRight += kernelCols;
+		}
+
+		__m256 sums[kernelRows][2] = {
+			{ sum00, sum01 }, { sum10, sum11 }, { sum20, sum21 }, { sum30, sum31 }, { sum40, sum41 }, { sum50, sum51 }
+		};
+		for (int row = 0; row < kernelRows; ++row) {
+			float* out = result + row * rowStride;
+			if (accumulate) {
+				sums[row][0] = _mm256_add_ps(sums[row][0], _mm256_loadu_ps(out));
+				sums[row][1] = _mm256_add_ps(sums[row][1], _mm256_loadu_ps(out + 8));
+			}
+			_mm256_storeu_ps(out, sums[row][0]);
+			_mm256_storeu_ps(out + 8, sums[row][1]);
+		}
+	}
+}
+
+matrixMultiplyKernel avx2MatrixMultiplyKernel() {
+	return avx2Kernel;
+}
+#else
+matrixMultiplyKernel avx2MatrixMultiplyKernel() {
+	return nullptr;
+}
+#endif
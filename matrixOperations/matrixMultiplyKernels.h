@@ -0,0 +1,25 @@
+#pragma once
+
+#include "cstddef"
+
+// internal to the matrix product, shared by matrixMultiply.cpp and the micro-kernels built for other instruction sets
+
+// the tile of the result one micro-kernel call computes
+inline constexpr int kernelRows = 6;
+inline constexpr int kernelCols = 16;
+
+/**
+ * Computes a kernelRows x kernelCols tile of the result from packed operands.
+ * @param depth Length of the products summed.
+ * @param packedLeft depth columns of kernelRows values each.
+ * @param packedRight depth rows of kernelCols values each, 64 byte aligned.
+ * @param result Element (0, 0) of the tile, rows rowStride apart and columns adjacent.
+ * @param rowStride Elements from one result row to the next.
+ * @param accumulate Whether the tile is added to result rather than written over it.
+ */
+typedef void (*matrixMultiplyKernel)(int depth, const float* packedLeft, const float* packedRight, float* result, std::ptrdiff_t rowStride, bool accumulate);
+
+/**
+ * The AVX2 / FMA micro-kernel, null when this build has none (not an x86 target).
+ */
+matrixMultiplyKernel avx2MatrixMultiplyKernel();
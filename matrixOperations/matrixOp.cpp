@@ -1,80 +1,61 @@
 #include "matrixOp.h"
+#include "matrix.h"
+#include "matrixMultiply.h"
+#include <stdexcept>
+#include <string>
 using namespace std;
 
+namespace {
+	// the element loops these replace read the operands with at(), so operands that do not match still throw
+	void checkSameSize(const vector<float>& first, const vector<float>& second, const char* function) {
+		if (second.size() != first.size()) {
+			throw out_of_range(string(function) + ": operands of " + to_string(first.size()) + " and " + to_string(second.size()) + " elements");
+		}
+	}
+}
 
-
+// the operands are taken over anyway, so the result is written into the first one and handed back without allocating
 unique_ptr<vector<float>> matrixAdd(unique_ptr<vector<float>>(givenVector1), unique_ptr<vector<float>>(givenVector2), int width) {
-	int height = givenVector1->size() / width;
-	vector<float> returnVector;
-	unsigned int totalElements = width * height;
-	
-	returnVector.resize(totalElements);
-	for (unsigned int i = 0; i < totalElements; ++i) {
-		returnVector[i] = givenVector1->at(i) + givenVector2->at(i);
-	}
-	return move(make_unique<vector<float>>(returnVector));
+	checkSameSize(*givenVector1, *givenVector2, "matrixAdd");
+	int height = int(givenVector1->size()) / width;
+	matrixView<float> result(givenVector1->data(), height, width);
+	result += matrixView<const float>(givenVector2->data(), height, width);
+	return givenVector1;
 }
 
 unique_ptr<vector<float>> matrixSubtract(unique_ptr<vector<float>>(givenVector1), unique_ptr<vector<float>>(givenVector2), int width) {
-	int height = givenVector1->size() / width;
-	vector<float> returnVector;
-	unsigned int totalElements = width * height;
-
-	returnVector.resize(totalElements);
-	for (unsigned int i = 0; i < totalElements; ++i) {
-		returnVector[i] = givenVector1->at(i) - givenVector2->at(i);
-	}
-	return move(make_unique<vector<float>>(returnVector));
+	checkSameSize(*givenVector1, *givenVector2, "matrixSubtract");
+	int height = int(givenVector1->size()) / width;
+	matrixView<float> result(givenVector1->data(), height, width);
+	result -= matrixView<const float>(givenVector2->data(), height, width);
+	return givenVector1;
 }
 
 unique_ptr<vector<float>> matrixSubtractAbs(unique_ptr<vector<float>>(givenVector1), unique_ptr<vector<float>>(givenVector2), int width) {
-	int height = givenVector1->size() / width;
-	vector<float> returnVector;
-	unsigned int totalElements = width * height;
-
-	returnVector.resize(totalElements);
-	for (unsigned int i = 0; i < totalElements; ++i) {
-		returnVector[i] = abs(givenVector1->at(i) - givenVector2->at(i));
-	}
-	return move(make_unique<vector<float>>(returnVector));
+	checkSameSize(*givenVector1, *givenVector2, "matrixSubtractAbs");
+	int height = int(givenVector1->size()) / width;
+	matrixView<float> result(givenVector1->data(), height, width);
+	result = elementwiseAbs(result - matrixView<const float>(givenVector2->data(), height, width));
+	return givenVector1;
 }
 
 unique_ptr<vector<float>> matrixScalarMultiply(unique_ptr<vector<float>>(givenVector1), float scaler, int width) {
-
-	int height = givenVector1->size() / width;
-	vector<float> returnVector;
-	unsigned int totalElements = width * height;
-
-	returnVector.resize(totalElements);
-	for (unsigned int i = 0; i < totalElements; ++i) {
-		returnVector[i] = givenVector1->at(i) * scaler;
-	}
-	return move(make_unique<vector<float>>(returnVector));
-
+	int height = int(givenVector1->size()) / width;
+	matrixView<float> result(givenVector1->data(), height, width);
+	result *= scaler;
+	return givenVector1;
 }
 
 unique_ptr<vector<float>> matrixMultiply(unique_ptr<vector<float>> givenVector1, unique_ptr<vector<float>> givenVector2, int width1) {
 
-	//height of the first width of the second.
-	int height1 = givenVector1->size() / width1;
-	vector<float> returnVector;
-	unsigned int totalElements = height1 * height1;
-	float tempAddition = 0;
-	returnVector.resize(totalElements);
-
-	for (unsigned int x = 0; x < height1; ++x) {
-		for (unsigned int y = 0; y < height1; ++y) {
-
-			tempAddition = 0;
-
-			for (unsigned int xAdd = 0; xAdd < width1; ++xAdd) {
-				
-				tempAddition += givenVector1->at(y * width1 + xAdd) * givenVector2->at(x + height1 * xAdd);
-			}
-
-			returnVector[x + y * height1] = tempAddition;
-		}
+	// the width of the first is the height of the second, the product is as high as the first and as wide as the second
+	if (width1 <= 0 || givenVector2->size() % size_t(width1) != 0) {
+		throw out_of_range("matrixMultiply: " + to_string(givenVector2->size()) + " elements are no whole rows of " + to_string(width1));
 	}
-
-	return make_unique<vector<float>>(returnVector);
+	int height1 = int(givenVector1->size()) / width1;
+	int width2 = int(givenVector2->size()) / width1;
+	unique_ptr<vector<float>> product = make_unique<vector<float>>(size_t(height1) * width2);
+	matrixMultiply(matrixView<const float>(givenVector1->data(), height1, width1), matrixView<const float>(givenVector2->data(), width1, width2),
+		matrixView<float>(product->data(), height1, width2));
+	return product;
 }
@@ -1,5 +1,7 @@
 #include "iostream"
 #include "vector"
+#include "memory"
+#include "cmath"
 #pragma once
 using namespace std;
 
@@ -0,0 +1,388 @@
+#include "sparseMatrix.h"
+#include "matrixMultiply.h"
+#include "solver/simdKernels.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace {
+	// rows one task of a product takes, enough work per task to hide the hand-over
+	constexpr int rowsPerTask = 4096;
+	// products with fewer stored elements run on the calling thread alone
+	constexpr long long parallelThreshold = 32 * 1024;
+
+	// partial results of the transposed product, one slice of the columns per thread
+	thread_local alignedVector<float> transposePartials;
+
+	/**
+	 * Calls body(from, to) over [0, count) in tasks of at most rowsPerTask, on the matrix threads when the work
+	 * is large enough. Short tasks keep what a body revisits in cache on a single thread as well.
+	 */
+	template <typename Body>
+	void forEachRowRange(int count, long long work, const Body& body) {
+		threadPool& pool = matrixThreadPool();
+		int tasks = (count + rowsPerTask - 1) / rowsPerTask;
+		auto runTasks = [&](int from, int to) {
+			for (int task = from; task < to; ++task) {
+				body(task * rowsPerTask, std::min((task + 1) * rowsPerTask, count));
+			}
+		};
+		if (work < parallelThreshold || pool.getThreadCount() == 1 || tasks < 2) {
+			runTasks(0, tasks);
+			return;
+		}
+		pool.parallelFor(0, tasks, runTasks);
+	}
+}
+
+std::vector<matrixTriplet> stencilTriplets(int width, int height, float centre, float k, bool dirichletBoundary) {
+	std::vector<matrixTriplet> triplets;
+	triplets.reserve(std::size_t(width) * height * 5);
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			int cell = y * width + x;
+			int neighbours = 0;
+			auto couple = [&](int neighbourX, int neighbourY) {
+				if (neighbourX >= 0 && neighbourX < width && neighbourY >= 0 && neighbourY < height) {
+					triplets.push_back({ cell, neighbourY * width + neighbourX, -k });
+					++neighbours;
+				}
+			};
+			couple(x, y - 1);
+			couple(x - 1, y);
+			couple(x + 1, y);
+			couple(x, y + 1);
+			triplets.push_back({ cell, cell, centre + k * float(dirichletBoundary ? 4 : neighbours) });
+		}
+	}
+	return triplets;
+}
+
+sparseMatrix::sparseMatrix(int rows, int cols, const std::vector<matrixTriplet>& triplets) {
+	this->rows = rows;
+	this->cols = cols;
+
+	// counting sort by row, then every row sorted by column with the duplicates summed
+	alignedVector<int> starts(std::size_t(rows) + 1, 0);
+	for (const matrixTriplet& triplet : triplets) {
+		assert(triplet.row >= 0 && triplet.row < rows && triplet.col >= 0 && triplet.col < cols);
+		++starts[std::size_t(triplet.row) + 1];
+	}
+	for (int row = 0; row < rows; ++row) {
+		starts[std::size_t(row) + 1] += starts[row];
+	}
+	std::vector<std::pair<int, float>> sorted(triplets.size());
+	alignedVector<int> fill(starts.begin(), starts.end() - 1);
+	for (const matrixTriplet& triplet : triplets) {
+		sorted[std::size_t(fill[triplet.row]++)] = { triplet.col, triplet.value };
+	}
+
+	this->rowStart.assign(std::size_t(rows) + 1, 0);
+	this->colIndex.clear();
+	this->values.clear();
+	this->colIndex.reserve(triplets.size());
+	this->values.reserve(triplets.size());
+	for (int row = 0; row < rows; ++row) {
+		auto first = sorted.begin() + starts[row];
+		auto last = sorted.begin() + starts[std::size_t(row) + 1];
+		std::sort(first, last, [](const std::pair<int, float>& left, const std::pair<int, float>& right) { return left.first < right.first; });
+		for (auto entry = first; entry != last; ++entry) {
+			if (entry != first && entry->first == this->colIndex.back()) {
+				this->values.back() += entry->second;
+			}
+			else {
+				this->colIndex.push_back(entry->first);
+				this->values.push_back(entry->second);
+			}
+		}
+		this->rowStart[std::size_t(row) + 1] = int(this->values.size());
+	}
+}
+
+float sparseMatrix::at(int row, int col) const {
+	const int* first = this->colIndex.data() + this->rowStart[row];
+	const int* last = this->colIndex.data() + this->rowStart[std::size_t(row) + 1];
+	const int* found = std::lower_bound(first, last, col);
+	return found != last && *found == col ? this->values[std::size_t(found - this->colIndex.data())] : 0.0f;
+}
+
+void sparseMatrix::multiply(const float* vector, float* result) const {
+	const int* starts = this->rowStart.data();
+	const int* columns = this->colIndex.data();
+	const float* elements = this->values.data();
+	forEachRowRange(this->rows, this->getNonZeroCount(), [=](int from, int to) {
+		for (int row = from; row < to; ++row) {
+			float sum = 0.0f;
+			for (int index = starts[row]; index < starts[row + 1]; ++index) {
+				sum += elements[index] * vector[columns[index]];
+			}
+			result[row] = sum;
+		}
+	});
+}
+
+void sparseMatrix::multiplyTransposed(const float* vector, float* result) const {
+	const int* starts = this->rowStart.data();
+	const int* columns = this->colIndex.data();
+	const float* elements = this->values.data();
+	auto scatter = [=](int from, int to, float* target) {
+		for (int row = from; row < to; ++row) {
+			float scale = vector[row];
+			for (int index = starts[row]; index < starts[row + 1]; ++index) {
+				target[columns[index]] += elements[index] * scale;
+			}
+		}
+	};
+
+	threadPool& pool = matrixThreadPool();
+	int parts = std::min(pool.getThreadCount(), (this->rows + rowsPerTask - 1) / rowsPerTask);
+	if (this->getNonZeroCount() < parallelThreshold || parts < 2) {
+		std::fill(result, result + this->cols, 0.0f);
+		scatter(0, this->rows, result);
+		return;
+	}
+
+	// rows of different parts may add to the same column, every part scatters into a partial result of its own
+	alignedVector<float>& partials = transposePartials;
+	partials.assign(std::size_t(parts) * this->cols, 0.0f);
+	float* partial = partials.data();
+	int rowsPerPart = (this->rows + parts - 1) / parts;
+	int cols = this->cols;
+	pool.parallelFor(0, parts, [&](int from, int to) {
+		for (int part = from; part < to; ++part) {
+			scatter(part * rowsPerPart, std::min((part + 1) * rowsPerPart, this->rows), partial + std::size_t(part) * cols);
+		}
+	});
+	forEachRowRange(cols, (long long)parts * cols, [=](int from, int to) {
+		for (int col = from; col < to; ++col) {
+			float sum = 0.0f;
+			for (int part = 0; part < parts; ++part) {
+				sum += partial[std::size_t(part) * cols + col];
+			}
+			result[col] = sum;
+		}
+	});
+}
+
+void sparseMatrix::scale(float factor) {
+	for (float& value : this->values) {
+		value *= factor;
+	}
+}
+
+void sparseMatrix::addTo(matrixView<float> dense, float factor) const {
+	assert(dense.getRows() == this->rows && dense.getCols() == this->cols);
+	for (int row = 0; row < this->rows; ++row) {
+		for (int index = this->rowStart[row]; index < this->rowStart[std::size_t(row) + 1]; ++index) {
+			dense(row, this->colIndex[index]) += factor * this->values[index];
+		}
+	}
+}
+
+matrix<float> sparseMatrix::toDense() const {
+	matrix<float> dense(this->rows, this->cols, 0.0f);
+	this->addTo(dense.view());
+	return dense;
+}
+
+diagonalMatrix::diagonalMatrix(int rows, int cols, const std::vector<matrixTriplet>& triplets) {
+	this->rows = rows;
+	this->cols = cols;
+
+	this->offsets.clear();
+	for (const matrixTriplet& triplet : triplets) {
+		assert(triplet.row >= 0 && triplet.row < rows && triplet.col >= 0 && triplet.col < cols);
+		this->offsets.push_back(triplet.col - triplet.row);
+	}
+	std::sort(this->offsets.begin(), this->offsets.end());
+	this->offsets.erase(std::unique(this->offsets.begin(), this->offsets.end()), this->offsets.end());
+
+	this->values.assign(this->offsets.size() * std::size_t(rows), 0.0f);
+	for (const matrixTriplet& triplet : triplets) {
+		std::size_t diagonal = std::size_t(std::lower_bound(this->offsets.begin(), this->offsets.end(), triplet.col - triplet.row) - this->offsets.begin());
+		this->values[diagonal * rows + triplet.row] += triplet.value;
+	}
+}
+
+float diagonalMatrix::at(int row, int col) const {
+	auto found = std::lower_bound(this->offsets.begin(), this->offsets.end(), col - row);
+	if (found == this->offsets.end() || *found != col - row) {
+		return 0.0f;
+	}
+	return this->values[std::size_t(found - this->offsets.begin()) * this->rows + row];
+}
+
+void diagonalMatrix::multiply(const float* vector, float* result) const {
+	const int* diagonals = this->offsets.data();
+	int diagonalCount = this->getDiagonalCount();
+	const float* elements = this->values.data();
+	int rows = this->rows;
+	int cols = this->cols;
+	forEachRowRange(rows, (long long)diagonalCount * rows, [=](int from, int to) {
+		std::fill(result + from, result + to, 0.0f);
+		// one diagonal at a time over the task's rows, which stay in cache between diagonals
+		for (int diagonal = 0; diagonal < diagonalCount; ++diagonal) {
+			int offset = diagonals[diagonal];
+			int first = std::max(from, -offset);
+			int last = std::min(to, cols - offset);
+			const float* band = elements + std::size_t(diagonal) * rows;
+			for (int row = first; row < last; ++row) {
+				result[row] += band[row] * vector[row + offset];
+			}
+		}
+	});
+}
+
+void diagonalMatrix::multiplyTransposed(const float* vector, float* result) const {
+	const int* diagonals = this->offsets.data();
+	int diagonalCount = this->getDiagonalCount();
+	const float* elements = this->values.data();
+	int rows = this->rows;
+	int cols = this->cols;
+	// column col of the transpose's row gathers element (col - offset, col) of every diagonal, no scattering needed
+	forEachRowRange(cols, (long long)diagonalCount * cols, [=](int from, int to) {
+		std::fill(result + from, result + to, 0.0f);
+		for (int diagonal = 0; diagonal < diagonalCount; ++diagonal) {
+			int offset = diagonals[diagonal];
+			int first = std::max(from, offset);
+			int last = std::min(to, rows + offset);
+			const float* band = elements + std::size_t(diagonal) * rows;
+			for (int col = first; col < last; ++col) {
+				result[col] += band[col - offset] * vector[col - offset];
+			}
+		}
+	});
+}
+
+void diagonalMatrix::scale(float factor) {
+	for (float& value : this->values) {
+		value *= factor;
+	}
+}
+
+void diagonalMatrix::addTo(matrixView<float> dense, float factor) const {
+	assert(dense.getRows() == this->rows && dense.getCols() == this->cols);
+	for (int diagonal = 0; diagonal < this->getDiagonalCount(); ++diagonal) {
+		int offset = this->offsets[std::size_t(diagonal)];
+		for (int row = std::max(0, -offset); row < std::min(this->rows, this->cols - offset); ++row) {
+			dense(row, row + offset) += factor * this->values[std::size_t(diagonal) * this->rows + row];
+		}
+	}
+}
+
+matrix<float> diagonalMatrix::toDense() const {
+	matrix<float> dense(this->rows, this->cols, 0.0f);
+	this->addTo(dense.view());
+	return dense;
+}
+
+void sparseConjugateGradient::solve(const sparseMatrix& A, const float* rhs, float* solution) {
+	this->run(A, rhs, solution);
+}
+
+void sparseConjugateGradient::solve(const diagonalMatrix& A, const float* rhs, float* solution) {
+	this->run(A, rhs, solution);
+}
+
+int sparseConjugateGradient::lastIterations() const {
+	return this->iterations;
+}
+
+float sparseConjugateGradient::lastResidual() const {
+	return this->residualNorm;
+}
+
+template <typename Operator>
+void sparseConjugateGradient::run(const Operator& A, const float* rhs, float* solution) {
+	assert(A.getRows() == A.getCols());
+	this->iterations = 0;
+	this->residualNorm = 0;
+	int count = A.getRows();
+	if (count < 1) {
+		return;
+	}
+
+	std::size_t size = std::size_t(count);
+	this->inverseDiagonal.resize(size);
+	this->residual.resize(size);
+	this->search.resize(size);
+	this->preconditioned.resize(size);
+	this->applied.resize(size);
+	float* inverseDiagonal = this->inverseDiagonal.data();
+	float* residual = this->residual.data();
+	float* search = this->search.data();
+	float* preconditioned = this->preconditioned.data();
+	float* applied = this->applied.data();
+	for (int row = 0; row < count; ++row) {
+		float diagonal = A.at(row, row);
+		inverseDiagonal[row] = diagonal != 0.0f ? 1.0f / diagonal : 1.0f;
+	}
+
+	// r = rhs - A x
+	A.multiply(solution, applied);
+	forEachRowRange(count, count, [=](int from, int to) {
+		for (int row = from; row < to; ++row) {
+			residual[row] = rhs[row] - applied[row];
+		}
+	});
+	double rhsNorm = std::sqrt(this->dot(rhs, rhs, count));
+	double norm = std::sqrt(this->dot(residual, residual, count));
+	// a zero right hand side is solved by zero, measure against 1 so the loop still terminates
+	double scale = rhsNorm > 0 ? rhsNorm : 1.0;
+
+	if (norm / scale > this->tolerance) {
+		forEachRowRange(count, count, [=](int from, int to) {
+			for (int row = from; row < to; ++row) {
+				preconditioned[row] = residual[row] * inverseDiagonal[row];
+				search[row] = preconditioned[row];
+			}
+		});
+		double sigma = this->dot(preconditioned, residual, count);
+
+		while (this->iterations < this->maxIterations) {
+			A.multiply(search, applied);
+			double curvature = this->dot(search, applied, count);
+			if (curvature <= 0) {
+				break;
+			}
+			float alpha = float(sigma / curvature);
+			forEachRowRange(count, count, [=](int from, int to) {
+				for (int row = from; row < to; ++row) {
+					solution[row] += alpha * search[row];
+					residual[row] -= alpha * applied[row];
+					preconditioned[row] = residual[row] * inverseDiagonal[row];
+				}
+			});
+			++this->iterations;
+
+			norm = std::sqrt(this->dot(residual, residual, count));
+			if (norm / scale <= this->tolerance) {
+				break;
+			}
+
+			double sigmaNew = this->dot(preconditioned, residual, count);
+			float beta = float(sigmaNew / sigma);
+			sigma = sigmaNew;
+			forEachRowRange(count, count, [=](int from, int to) {
+				for (int row = from; row < to; ++row) {
+					search[row] = preconditioned[row] + beta * search[row];
+				}
+			});
+		}
+	}
+	this->residualNorm = float(norm / scale);
+}
+
+double sparseConjugateGradient::dot(const float* a, const float* b, int count) {
+	int tasks = (count + rowsPerTask - 1) / rowsPerTask;
+	this->partialDots.assign(std::size_t(tasks), 0.0);
+	double* partials = this->partialDots.data();
+	forEachRowRange(count, count, [=](int from, int to) {
+		partials[from / rowsPerTask] = dotRow(a + from, b + from, to - from);
+	});
+	double sum = 0;
+	for (int task = 0; task < tasks; ++task) {
+		sum += partials[task];
+	}
+	return sum;
+}
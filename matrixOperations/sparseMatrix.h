@@ -0,0 +1,184 @@
+#pragma once
+
+#include "vector"
+#include "matrix.h"
+
+/*
+ * Sparse matrices for operators far too large to store dense, such as the N² x N² 5-point Laplacian of an N x N
+ * grid, which has at most five non-zeros per row. sparseMatrix is compressed sparse rows and holds any pattern,
+ * diagonalMatrix stores whole diagonals and suits banded stencil operators: its product is a few unit-stride
+ * multiply-adds per row that vectorize, with no column indices to load. Both are assembled from (row, col, value)
+ * triplets and multiply vectors of floats stored contiguously, on the threads of matrixThreadPool().
+ */
+
+struct matrixTriplet {
+	int row;
+	int col;
+	float value;
+};
+
+/**
+ * Triplets of the operator conjugateGradientSolver applies to a width x height block of cells numbered row after
+ * row, (centre + k * n) x - k * (sum of the n neighbours). With dirichletBoundary every cell counts four neighbours,
+ * the ones outside the block being zero, otherwise only the neighbours inside the block count. The starting point
+ * for custom operators solved with sparseConjugateGradient: obstacles drop couplings, variable viscosity scales
+ * them per cell.
+ */
+std::vector<matrixTriplet> stencilTriplets(int width, int height, float centre, float k, bool dirichletBoundary);
+
+/**
+ * rows x cols matrix in compressed sparse rows: the non-zeros of row r are values[getRowStart()[r] ..
+ * getRowStart()[r + 1]) at the columns in the same range of getColIndex(), ascending.
+ */
+class sparseMatrix {
+
+protected:
+	int rows = 0;
+	int cols = 0;
+	alignedVector<int> rowStart;
+	alignedVector<int> colIndex;
+	alignedVector<float> values;
+
+public:
+	sparseMatrix() = default;
+
+	/**
+	 * Assembles the matrix, triplets at the same position are summed. Entries whose value is zero are kept,
+	 * so a pattern can be assembled once and its values changed later.
+	 */
+	sparseMatrix(int rows, int cols, const std::vector<matrixTriplet>& triplets);
+
+	int getRows() const { return this->rows; }
+	int getCols() const { return this->cols; }
+	int getNonZeroCount() const { return int(this->values.size()); }
+
+	const int* getRowStart() const { return this->rowStart.data(); }
+	const int* getColIndex() const { return this->colIndex.data(); }
+	float* getValues() { return this->values.data(); }
+	const float* getValues() const { return this->values.data(); }
+
+	/**
+	 * Element (row, col), 0 where nothing is stored.
+	 */
+	float at(int row, int col) const;
+
+	/**
+	 * result = A * vector, vector of getCols() and result of getRows() elements, not overlapping.
+	 */
+	void multiply(const float* vector, float* result) const;
+
+	/**
+	 * result = transpose(A) * vector, vector of getRows() and result of getCols() elements, not overlapping.
+	 * Rows are scattered into one partial result per thread that are summed afterwards.
+	 */
+	void multiplyTransposed(const float* vector, float* result) const;
+
+	/**
+	 * A *= factor.
+	 */
+	void scale(float factor);
+
+	/**
+	 * dense += factor * A, dense being of the same shape.
+	 */
+	void addTo(matrixView<float> dense, float factor = 1.0f) const;
+
+	matrix<float> toDense() const;
+};
+
+/**
+ * rows x cols matrix stored by diagonals: diagonal d holds element (row, row + getOffsets()[d]) of every row at
+ * getValues()[d * rows + row], zero where that column lies outside the matrix. Offsets ascend.
+ */
+class diagonalMatrix {
+
+protected:
+	int rows = 0;
+	int cols = 0;
+	std::vector<int> offsets;
+	alignedVector<float> values;
+
+public:
+	diagonalMatrix() = default;
+
+	/**
+	 * Assembles the matrix with a diagonal for every offset col - row a triplet has, triplets at the same
+	 * position are summed. Meant for a few diagonals, a scattered pattern is better kept in a sparseMatrix.
+	 */
+	diagonalMatrix(int rows, int cols, const std::vector<matrixTriplet>& triplets);
+
+	int getRows() const { return this->rows; }
+	int getCols() const { return this->cols; }
+	int getDiagonalCount() const { return int(this->offsets.size()); }
+
+	const std::vector<int>& getOffsets() const { return this->offsets; }
+	float* getValues() { return this->values.data(); }
+	const float* getValues() const { return this->values.data(); }
+
+	float at(int row, int col) const;
+
+	/**
+	 * result = A * vector, vector of getCols() and result of getRows() elements, not overlapping.
+	 */
+	void multiply(const float* vector, float* result) const;
+
+	/**
+	 * result = transpose(A) * vector, vector of getRows() and result of getCols() elements, not overlapping.
+	 */
+	void multiplyTransposed(const float* vector, float* result) const;
+
+	void scale(float factor);
+
+	void addTo(matrixView<float> dense, float factor = 1.0f) const;
+
+	matrix<float> toDense() const;
+};
+
+/**
+ * Jacobi preconditioned conjugate gradient on an assembled operator, for the systems the built-in stencil of
+ * conjugateGradientSolver cannot express, such as stencilTriplets() with the couplings of obstacle cells dropped
+ * or scaled per cell for variable viscosity. The operator must be square, symmetric and positive definite, the
+ * preconditioner divides by its diagonal. Iterates until |rhs - A x| / |rhs| drops below tolerance, the products
+ * run on the threads of matrixThreadPool(). The working vectors are kept, so repeated solves of one size do not
+ * allocate.
+ */
+class sparseConjugateGradient {
+
+public:
+	// stop once |rhs - A x| / |rhs| is below this
+	float tolerance = 1e-4f;
+	int maxIterations = 200;
+
+protected:
+	// 1 / the diagonal of the operator, 1 where the diagonal is zero
+	alignedVector<float> inverseDiagonal;
+	alignedVector<float> residual;
+	alignedVector<float> search;
+	alignedVector<float> preconditioned;
+	alignedVector<float> applied;
+	// the dot product of every task, added up in order so the result does not depend on the threads
+	alignedVector<double> partialDots;
+
+	int iterations = 0;
+	float residualNorm = 0;
+
+public:
+	/**
+	 * @param rhs Right hand side, getRows() elements.
+	 * @param solution Where the iteration starts, receives the result. getRows() elements, not overlapping rhs.
+	 */
+	void solve(const sparseMatrix& A, const float* rhs, float* solution);
+	void solve(const diagonalMatrix& A, const float* rhs, float* solution);
+
+	/**
+	 * Iterations and relative residual of the last solve().
+	 */
+	int lastIterations() const;
+	float lastResidual() const;
+
+private:
+	template <typename Operator>
+	void run(const Operator& A, const float* rhs, float* solution);
+
+	double dot(const float* a, const float* b, int count);
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "cstddef"
+#include "memory_resource"
+#include "new"
+#include "type_traits"
+#include "vector"
+#include "allocationCounter.h"
+
+/**
+ * Allocator handing out memory aligned to Alignment bytes (a cache line by default), so SIMD kernels
+ * can rely on every array starting on a cache line boundary. Memory comes from the heap, or from a
+ * memory resource such as a frameArena when one is given. Moves and swaps take the resource along, copies
+ * of a container go to the heap, so a copy never outlives the arena it was made from.
+ */
+template <typename T, std::size_t Alignment = 64>
+class alignedAllocator {
+public:
+	using value_type = T;
+	using propagate_on_container_move_assignment = std::true_type;
+	using propagate_on_container_swap = std::true_type;
+
+	template <typename U>
+	struct rebind {
+		using other = alignedAllocator<U, Alignment>;
+	};
+
+protected:
+	std::pmr::memory_resource* resource = nullptr;
+
+public:
+	alignedAllocator() noexcept = default;
+
+	/**
+	 * @param resource Where the memory comes from, nullptr for the heap.
+	 */
+	alignedAllocator(std::pmr::memory_resource* resource) noexcept : resource(resource) {}
+
+	template <typename U>
+	alignedAllocator(const alignedAllocator<U, Alignment>& other) noexcept : resource(other.getResource()) {}
+
+	std::pmr::memory_resource* getResource() const noexcept { return this->resource; }
+
+	alignedAllocator select_on_container_copy_construction() const noexcept { return alignedAllocator(); }
+
+	T* allocate(std::size_t count) {
+		if (this->resource != nullptr) {
+			return static_cast<T*>(this->resource->allocate(count * sizeof(T), Alignment));
+		}
+#ifdef SNOWLIB_COUNT_ALLOCATIONS
+		alignedAllocationCount.fetch_add(1, std::memory_order_relaxed);
+#endif
+		return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(Alignment)));
+	}
+
+	void deallocate(T* pointer, std::size_t count) noexcept {
+		if (this->resource != nullptr) {
+			this->resource->deallocate(pointer, count * sizeof(T), Alignment);
+			return;
+		}
+		::operator delete(pointer, std::align_val_t(Alignment));
+	}
+
+	template <typename U>
+	bool operator==(const alignedAllocator<U, Alignment>& other) const noexcept { return this->resource == other.getResource(); }
+
+	template <typename U>
+	bool operator!=(const alignedAllocator<U, Alignment>& other) const noexcept { return this->resource != other.getResource(); }
+};
+
+template <typename T>
+using alignedVector = std::vector<T, alignedAllocator<T>>;
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "atomic"
+#include "cstdint"
+
+/**
+ * Number of allocations made through alignedAllocator so far. Only counted when SNOWLIB_COUNT_ALLOCATIONS
+ * is defined (Debug builds), otherwise it stays 0.
+ */
+inline std::atomic<std::uint64_t> alignedAllocationCount{ 0 };
@@ -0,0 +1,103 @@
+#include "frameArena.h"
+#include "allocationCounter.h"
+#include <cassert>
+#include <new>
+
+namespace {
+	// a frame that outgrows the arena gets at least this much more, so a few small temporaries do not add a block each
+	constexpr std::size_t minimumBlock = 64 * 1024;
+
+	std::size_t roundUp(std::size_t bytes, std::size_t alignment) {
+		return (bytes + alignment - 1) & ~(alignment - 1);
+	}
+}
+
+frameArena::frameArena(std::size_t capacity) {
+	this->reserve(capacity);
+}
+
+frameArena::~frameArena() {
+	this->releaseBlocks();
+}
+
+void frameArena::addBlock(std::size_t size) {
+#ifdef SNOWLIB_COUNT_ALLOCATIONS
+	alignedAllocationCount.fetch_add(1, std::memory_order_relaxed);
+#endif
+	size = roundUp(size, alignment);
+	this->blocks.push_back({ static_cast<std::byte*>(::operator new(size, std::align_val_t(alignment))), size });
+}
+
+void frameArena::releaseBlocks() {
+	for (block& released : this->blocks) {
+		::operator delete(released.memory, std::align_val_t(alignment));
+	}
+	this->blocks.clear();
+	this->current = 0;
+	this->offset = 0;
+}
+
+std::size_t frameArena::getCapacity() const {
+	std::size_t capacity = 0;
+	for (const block& counted : this->blocks) {
+		capacity += counted.size;
+	}
+	return capacity;
+}
+
+void* frameArena::do_allocate(std::size_t bytes, std::size_t requestedAlignment) {
+	std::size_t allocationAlignment = std::max(requestedAlignment, alignment);
+	// sizes are whole cache lines, so the next allocation starts on one without padding
+	std::size_t size = roundUp(std::max<std::size_t>(bytes, 1), alignment);
+	// what the allocation can take in a single block, padding for a stricter alignment included
+	std::size_t charged = size + (allocationAlignment - alignment);
+
+	for (;;) {
+		if (this->current == this->blocks.size()) {
+			this->addBlock(std::max({ charged, this->getCapacity(), minimumBlock }));
+		}
+		block& target = this->blocks[this->current];
+		std::uintptr_t base = reinterpret_cast<std::uintptr_t>(target.memory);
+		std::size_t start = roundUp(base + this->offset, allocationAlignment) - base;
+		if (start + size <= target.size) {
+			this->offset = start + size;
+			this->used += charged;
+			this->framePeak = std::max(this->framePeak, this->used);
+			return target.memory + start;
+		}
+		// the rest of this block is left unused until the frame ends
+		++this->current;
+		this->offset = 0;
+	}
+}
+
+void frameArena::reserve(std::size_t capacity) {
+	assert(this->used == 0);
+	if (this->blocks.size() == 1 && this->blocks[0].size >= capacity) {
+		return;
+	}
+	std::size_t size = std::max(capacity, this->getCapacity());
+	this->releaseBlocks();
+	this->addBlock(size);
+}
+
+void frameArena::reset() {
+	this->lastFramePeak = this->framePeak;
+	this->peak = std::max(this->peak, this->framePeak);
+	this->framePeak = 0;
+	this->used = 0;
+	this->current = 0;
+	this->offset = 0;
+	++this->frames;
+	// a frame that needed several blocks fits in one of the largest frame's size from now on
+	if (this->blocks.size() > 1) {
+		this->releaseBlocks();
+		this->addBlock(this->peak);
+	}
+}
+
+void frameArena::rewind(const marker& where) {
+	this->current = where.block;
+	this->offset = where.offset;
+	this->used = where.used;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "algorithm"
+#include "cstddef"
+#include "cstdint"
+#include "memory_resource"
+#include "vector"
+
+/**
+ * Bump allocator for temporaries that live no longer than a frame (one simulation step), usable anywhere a
+ * std::pmr::memory_resource is, alignedAllocator included. An allocation moves a pointer forward through one
+ * cache line aligned block, every allocation starts on a cache line and freeing one does nothing; the memory
+ * comes back when a frameArenaScope ends or reset() is called.
+ * When a frame needs more than the block holds another block is added, and the next reset() replaces them by
+ * one block of the largest frame seen so far, so once the frames have been sized the arena never touches the
+ * heap again. Not thread-safe: one thread allocates, workers may use the memory handed out.
+ */
+class frameArena : public std::pmr::memory_resource {
+
+public:
+	static constexpr std::size_t alignment = 64;
+
+	/**
+	 * Position in the arena, see frameArenaScope.
+	 */
+	struct marker {
+		std::size_t block = 0;
+		std::size_t offset = 0;
+		std::size_t used = 0;
+	};
+
+protected:
+	struct block {
+		std::byte* memory = nullptr;
+		std::size_t size = 0;
+	};
+
+	std::vector<block> blocks;
+	// block being allocated from and the bytes already taken from it
+	std::size_t current = 0;
+	std::size_t offset = 0;
+	// bytes handed out, rounded to the alignment, since the frame began
+	std::size_t used = 0;
+	std::size_t framePeak = 0;
+	std::size_t lastFramePeak = 0;
+	std::size_t peak = 0;
+	std::uint64_t frames = 0;
+
+	void addBlock(std::size_t size);
+	void releaseBlocks();
+
+	void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+	void do_deallocate(void*, std::size_t, std::size_t) override {}
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+public:
+	frameArena() = default;
+
+	/**
+	 * @param capacity Bytes the first block holds.
+	 */
+	explicit frameArena(std::size_t capacity);
+	~frameArena() override;
+
+	frameArena(const frameArena&) = delete;
+	frameArena& operator=(const frameArena&) = delete;
+
+	/**
+	 * Makes sure a frame of capacity bytes fits in one block. Only allowed while nothing is allocated.
+	 */
+	void reserve(std::size_t capacity);
+
+	/**
+	 * Ends the frame: records its peak, gives back everything allocated and merges the blocks into one.
+	 * Memory handed out before must not be used afterwards.
+	 */
+	void reset();
+
+	marker position() const { return { this->current, this->offset, this->used }; }
+
+	/**
+	 * Gives back everything allocated since position() returned where.
+	 */
+	void rewind(const marker& where);
+
+	/**
+	 * Bytes allocated now, in the current frame so far at most, in the last finished frame at most and in any
+	 * frame since the arena was made. The peaks are what a production grid's arena should be reserved for.
+	 */
+	std::size_t getUsed() const { return this->used; }
+	std::size_t getFramePeak() const { return this->framePeak; }
+	std::size_t getLastFramePeak() const { return this->lastFramePeak; }
+	std::size_t getPeak() const { return std::max(this->peak, this->framePeak); }
+
+	std::size_t getCapacity() const;
+	int getBlockCount() const { return int(this->blocks.size()); }
+	std::uint64_t getFrameCount() const { return this->frames; }
+};
+
+/**
+ * Gives back what is allocated from an arena during its lifetime, so a stage can take temporaries from the frame
+ * arena and leave the space to the stages after it.
+ */
+class frameArenaScope {
+
+protected:
+	frameArena& arena;
+	frameArena::marker start;
+
+public:
+	explicit frameArenaScope(frameArena& arena) : arena(arena), start(arena.position()) {}
+	~frameArenaScope() { this->arena.rewind(this->start); }
+
+	frameArenaScope(const frameArenaScope&) = delete;
+	frameArenaScope& operator=(const frameArenaScope&) = delete;
+};
@@ -0,0 +1,301 @@
+#include "profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+#endif
+
+namespace {
+	const char* stageNames[profileStageCount] = {
+		"input", "projection", "advection", "diffusion", "colour", "upload", "swap"
+	};
+
+	// small ids for the timeline, in the order threads first record a scope
+	std::atomic<std::uint16_t> nextThreadId{ 0 };
+	thread_local int threadId = -1;
+
+	int currentThreadId() {
+		if (threadId < 0) {
+			threadId = nextThreadId.fetch_add(1, std::memory_order_relaxed);
+		}
+		return threadId;
+	}
+
+#if defined(__linux__)
+	// counters count the thread that opened them, so every thread opens its own on first use
+	struct threadCounters {
+		int cycles = -1;
+		int cacheMisses = -1;
+		bool opened = false;
+
+		~threadCounters() {
+			if (this->cycles >= 0) {
+				close(this->cycles);
+			}
+			if (this->cacheMisses >= 0) {
+				close(this->cacheMisses);
+			}
+		}
+	};
+	thread_local threadCounters counters;
+
+	int openCounter(std::uint32_t type, std::uint64_t config) {
+		perf_event_attr attributes;
+		std::memset(&attributes, 0, sizeof(attributes));
+		attributes.size = sizeof(attributes);
+		attributes.type = type;
+		attributes.config = config;
+		attributes.exclude_kernel = 1;
+		attributes.exclude_hv = 1;
+		return int(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+	}
+
+	void openThreadCounters() {
+		if (counters.opened) {
+			return;
+		}
+		counters.opened = true;
+		counters.cycles = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+		counters.cacheMisses = openCounter(PERF_TYPE_HW_CACHE,
+			PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+	}
+
+	std::int64_t readCounter(int descriptor) {
+		std::int64_t value = -1;
+		if (descriptor < 0 || read(descriptor, &value, sizeof(value)) != sizeof(value)) {
+			return -1;
+		}
+		return value;
+	}
+#endif
+}
+
+const char* profileStageName(profileStage stage) {
+	return stage >= 0 && stage < profileStageCount ? stageNames[stage] : "unknown";
+}
+
+profiler& profiler::instance() {
+	static profiler shared;
+	return shared;
+}
+
+std::uint64_t profiler::now() {
+	static const auto origin = std::chrono::steady_clock::now();
+	return std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count());
+}
+
+profiler::counterValues profiler::readCounters() const {
+	counterValues values;
+#if defined(__linux__)
+	if (!this->countersEnabled.load(std::memory_order_relaxed)) {
+		return values;
+	}
+	openThreadCounters();
+	values.cycles = readCounter(counters.cycles);
+	values.cacheMisses = readCounter(counters.cacheMisses);
+#endif
+	return values;
+}
+
+profiler::counterValues profiler::withWorkerCounters(counterValues values) const {
+	if (values.cycles >= 0) {
+		values.cycles += this->workerCycles.load(std::memory_order_relaxed);
+	}
+	if (values.cacheMisses >= 0) {
+		values.cacheMisses += this->workerCacheMisses.load(std::memory_order_relaxed);
+	}
+	return values;
+}
+
+profiler::counterValues profiler::openScope() {
+	this->openScopes.fetch_add(1, std::memory_order_relaxed);
+	return this->withWorkerCounters(this->readCounters());
+}
+
+profiler::counterValues profiler::closeScope() {
+	// the workers of a job the scope waited on added theirs before the job returned
+	counterValues values = this->withWorkerCounters(this->readCounters());
+	this->openScopes.fetch_sub(1, std::memory_order_relaxed);
+	return values;
+}
+
+bool profiler::countingWorkers() const {
+	return this->countersEnabled.load(std::memory_order_relaxed) && this->openScopes.load(std::memory_order_relaxed) > 0;
+}
+
+void profiler::addWorkerCounters(const counterValues& startCounters, const counterValues& endCounters) {
+	if (startCounters.cycles >= 0 && endCounters.cycles >= 0) {
+		this->workerCycles.fetch_add(endCounters.cycles - startCounters.cycles, std::memory_order_relaxed);
+	}
+	if (startCounters.cacheMisses >= 0 && endCounters.cacheMisses >= 0) {
+		this->workerCacheMisses.fetch_add(endCounters.cacheMisses - startCounters.cacheMisses, std::memory_order_relaxed);
+	}
+}
+
+void profiler::record(profileStage stage, std::uint64_t start, std::uint64_t end, const counterValues& startCounters, const counterValues& endCounters) {
+	sample entry;
+	entry.duration = end - start;
+	if (startCounters.cycles >= 0 && endCounters.cycles >= 0) {
+		entry.cycles = endCounters.cycles - startCounters.cycles;
+	}
+	if (startCounters.cacheMisses >= 0 && endCounters.cacheMisses >= 0) {
+		entry.cacheMisses = endCounters.cacheMisses - startCounters.cacheMisses;
+	}
+	int thread = currentThreadId();
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+	stageSamples& samples = this->stages[stage];
+	// the buffers are only allocated once something is profiled
+	if (samples.window.empty()) {
+		samples.window.resize(sampleWindow);
+	}
+	if (this->events.empty()) {
+		this->events.resize(eventCapacity);
+	}
+
+	samples.window[samples.count % sampleWindow] = entry;
+	++samples.count;
+
+	event& timeline = this->events[this->eventCount % eventCapacity];
+	timeline.start = start;
+	timeline.duration = entry.duration;
+	timeline.stage = std::uint16_t(stage);
+	timeline.thread = std::uint16_t(thread);
+	++this->eventCount;
+}
+
+bool profiler::setCountersEnabled(bool enabled) {
+#if defined(__linux__)
+	if (enabled) {
+		// probe on the calling thread, other threads open theirs on first use
+		openThreadCounters();
+		enabled = counters.cycles >= 0 || counters.cacheMisses >= 0;
+	}
+	this->countersEnabled.store(enabled, std::memory_order_relaxed);
+	return enabled;
+#else
+	(void)enabled;
+	return false;
+#endif
+}
+
+bool profiler::getCountersEnabled() const {
+	return this->countersEnabled.load(std::memory_order_relaxed);
+}
+
+profiler::stageSummary profiler::summary(profileStage stage) const {
+	stageSummary result;
+	std::vector<sample> window;
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		const stageSamples& samples = this->stages[stage];
+		result.count = samples.count;
+		std::uint64_t kept = std::min<std::uint64_t>(samples.count, sampleWindow);
+		window.assign(samples.window.begin(), samples.window.begin() + std::ptrdiff_t(kept));
+	}
+	if (window.empty()) {
+		return result;
+	}
+
+	std::vector<std::uint64_t> durations(window.size());
+	double cycles = 0;
+	double cacheMisses = 0;
+	std::size_t counted = 0;
+	for (std::size_t index = 0; index < window.size(); ++index) {
+		durations[index] = window[index].duration;
+		if (window[index].cycles >= 0 && window[index].cacheMisses >= 0) {
+			cycles += double(window[index].cycles);
+			cacheMisses += double(window[index].cacheMisses);
+			++counted;
+		}
+	}
+
+	auto percentile = [&](double share) {
+		std::size_t rank = std::size_t(std::ceil(share * durations.size())) - 1;
+		std::nth_element(durations.begin(), durations.begin() + std::ptrdiff_t(rank), durations.end());
+		return double(durations[rank]) * 1e-6;
+	};
+	result.p50 = percentile(0.5);
+	result.p99 = percentile(0.99);
+	result.max = double(*std::max_element(durations.begin(), durations.end())) * 1e-6;
+	if (counted > 0) {
+		result.cycles = cycles / double(counted);
+		result.cacheMisses = cacheMisses / double(counted);
+	}
+	return result;
+}
+
+bool profiler::writeCsv(const std::string& path) const {
+	std::ofstream file(path);
+	if (!file) {
+		return false;
+	}
+	file << "stage,count,p50_ms,p99_ms,max_ms,cycles,llc_misses\n";
+	for (int stage = 0; stage < profileStageCount; ++stage) {
+		stageSummary result = this->summary(profileStage(stage));
+		file << stageNames[stage] << ',' << result.count << ',' << result.p50 << ',' << result.p99 << ',' << result.max << ','
+			<< result.cycles << ',' << result.cacheMisses << '\n';
+	}
+	return bool(file);
+}
+
+bool profiler::writeJson(const std::string& path) const {
+	std::ofstream file(path);
+	if (!file) {
+		return false;
+	}
+	file << "{\n";
+	for (int stage = 0; stage < profileStageCount; ++stage) {
+		stageSummary result = this->summary(profileStage(stage));
+		file << "  \"" << stageNames[stage] << "\": {\"count\": " << result.count << ", \"p50_ms\": " << result.p50
+			<< ", \"p99_ms\": " << result.p99 << ", \"max_ms\": " << result.max << ", \"cycles\": " << result.cycles
+			<< ", \"llc_misses\": " << result.cacheMisses << "}" << (stage + 1 < profileStageCount ? ",\n" : "\n");
+	}
+	file << "}\n";
+	return bool(file);
+}
+
+bool profiler::writeChromeTrace(const std::string& path) const {
+	std::vector<event> timeline;
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		// oldest first, once the ring has wrapped the oldest event sits right after the newest
+		std::uint64_t kept = std::min<std::uint64_t>(this->eventCount, eventCapacity);
+		timeline.reserve(std::size_t(kept));
+		for (std::uint64_t index = this->eventCount - kept; index < this->eventCount; ++index) {
+			timeline.push_back(this->events[index % eventCapacity]);
+		}
+	}
+
+	std::ofstream file(path);
+	if (!file) {
+		return false;
+	}
+	// microsecond timestamps of a long session need more than the default six digits
+	file << std::fixed;
+	file.precision(3);
+	file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+	for (std::size_t index = 0; index < timeline.size(); ++index) {
+		const event& scope = timeline[index];
+		// complete events, timestamps in microseconds
+		file << "{\"name\": \"" << stageNames[scope.stage] << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << scope.thread
+			<< ", \"ts\": " << double(scope.start) * 1e-3 << ", \"dur\": " << double(scope.duration) * 1e-3 << "}"
+			<< (index + 1 < timeline.size() ? ",\n" : "\n");
+	}
+	file << "]}\n";
+	return bool(file);
+}
+
+void profiler::reset() {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	for (stageSamples& samples : this->stages) {
+		samples.count = 0;
+	}
+	this->eventCount = 0;
+}
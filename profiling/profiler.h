@@ -0,0 +1,192 @@
+#pragma once
+
+#include "atomic"
+#include "cstdint"
+#include "mutex"
+#include "string"
+#include "vector"
+
+/**
+ * Stages of a frame the profiler tells apart. Density, velocity and scalars are advected in one fused
+ * pass, so advection is a single stage.
+ */
+enum profileStage {
+	inputStage = 0,
+	projectionStage = 1,
+	advectionStage = 2,
+	diffusionStage = 3,
+	colourStage = 4,
+	uploadStage = 5,
+	swapStage = 6,
+	profileStageCount = 7
+};
+
+const char* profileStageName(profileStage stage);
+
+/**
+ * Collects the duration of every profiled scope. Per stage it keeps the last samples for percentiles and,
+ * when enabled and the kernel allows it, the CPU cycles and last level cache misses of the thread that ran
+ * the scope plus those of the threadPool workers over the tiles they ran while it was open (Linux
+ * perf_event_open). Workers count towards every scope open at the time, so overlapping scopes on different
+ * threads share them. Every scope also lands in a ring of events for a timeline export.
+ * Scopes are placed with SNOWLIB_PROFILE_SCOPE, which compiles to nothing unless SNOWLIB_PROFILE is defined
+ * (the SNOWLIB_ENABLE_PROFILER option), so an unprofiled build pays nothing for them.
+ */
+class profiler {
+
+public:
+	// samples per stage the percentiles are taken over
+	static constexpr int sampleWindow = 1024;
+	// scopes kept for the timeline
+	static constexpr int eventCapacity = 1 << 16;
+
+	struct stageSummary {
+		// scopes recorded since the last reset
+		std::uint64_t count = 0;
+		// over the last sampleWindow scopes, in milliseconds
+		double p50 = 0;
+		double p99 = 0;
+		double max = 0;
+		// means over the same scopes, the scope's thread and the pool workers together, -1 where counters were not read
+		double cycles = -1;
+		double cacheMisses = -1;
+	};
+
+	// hardware counter values at the start or end of a scope
+	struct counterValues {
+		std::int64_t cycles = -1;
+		std::int64_t cacheMisses = -1;
+	};
+
+protected:
+	struct sample {
+		std::uint64_t duration = 0;
+		std::int64_t cycles = -1;
+		std::int64_t cacheMisses = -1;
+	};
+
+	struct event {
+		std::uint64_t start = 0;
+		std::uint64_t duration = 0;
+		std::uint16_t stage = 0;
+		std::uint16_t thread = 0;
+	};
+
+	struct stageSamples {
+		std::vector<sample> window;
+		std::uint64_t count = 0;
+	};
+
+	mutable std::mutex mutex;
+	stageSamples stages[profileStageCount];
+	std::vector<event> events;
+	std::uint64_t eventCount = 0;
+	std::atomic<bool> countersEnabled{ false };
+	// scopes open right now and what pool workers counted over their tiles, only ever growing
+	std::atomic<int> openScopes{ 0 };
+	std::atomic<std::int64_t> workerCycles{ 0 };
+	std::atomic<std::int64_t> workerCacheMisses{ 0 };
+
+	profiler() = default;
+
+	// adds what the pool workers counted so far to the counters of a thread
+	counterValues withWorkerCounters(counterValues values) const;
+
+public:
+	profiler(const profiler&) = delete;
+	profiler& operator=(const profiler&) = delete;
+
+	static profiler& instance();
+
+	/**
+	 * Nanoseconds on the profiler's clock.
+	 */
+	static std::uint64_t now();
+
+	/**
+	 * Reads cycles and cache misses of the calling thread, left at -1 while counters are off or unavailable.
+	 */
+	counterValues readCounters() const;
+
+	/**
+	 * Counters at the start and end of a scope: those of the calling thread plus everything the pool workers
+	 * added so far. Every openScope needs a closeScope on the same profiler.
+	 */
+	counterValues openScope();
+	counterValues closeScope();
+
+	/**
+	 * Whether pool workers should read their counters around the tiles of a job, true while counters are
+	 * on and a scope is open.
+	 */
+	bool countingWorkers() const;
+
+	/**
+	 * Adds what a pool worker counted between two readCounters() to the open scopes.
+	 */
+	void addWorkerCounters(const counterValues& startCounters, const counterValues& endCounters);
+
+	/**
+	 * Adds a finished scope.
+	 */
+	void record(profileStage stage, std::uint64_t start, std::uint64_t end, const counterValues& startCounters, const counterValues& endCounters);
+
+	/**
+	 * Turns the perf_event_open counters on or off. Returns whether they are on, they stay off on other
+	 * platforms and where the kernel refuses them (perf_event_paranoid, containers).
+	 */
+	bool setCountersEnabled(bool enabled);
+
+	bool getCountersEnabled() const;
+
+	stageSummary summary(profileStage stage) const;
+
+	/**
+	 * One line per stage with the summary columns.
+	 */
+	bool writeCsv(const std::string& path) const;
+
+	/**
+	 * The summaries as a JSON object keyed by stage name.
+	 */
+	bool writeJson(const std::string& path) const;
+
+	/**
+	 * The recorded scopes in the Chrome trace event format, for chrome://tracing or Perfetto.
+	 */
+	bool writeChromeTrace(const std::string& path) const;
+
+	void reset();
+};
+
+/**
+ * Records the lifetime of the scope as one sample of a stage.
+ */
+class profileScope {
+
+protected:
+	profileStage stage;
+	std::uint64_t start;
+	profiler::counterValues startCounters;
+
+public:
+	profileScope(profileStage stage) : stage(stage) {
+		this->startCounters = profiler::instance().openScope();
+		this->start = profiler::now();
+	}
+
+	~profileScope() {
+		std::uint64_t end = profiler::now();
+		profiler& instance = profiler::instance();
+		instance.record(this->stage, this->start, end, this->startCounters, instance.closeScope());
+	}
+
+	profileScope(const profileScope&) = delete;
+	profileScope& operator=(const profileScope&) = delete;
+};
+
+#ifdef SNOWLIB_PROFILE
+#define SNOWLIB_PROFILE_SCOPE(stage) profileScope snowlibProfileScope(stage)
+#else
+#define SNOWLIB_PROFILE_SCOPE(stage) ((void)0)
+#endif
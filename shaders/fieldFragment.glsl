@@ -0,0 +1,16 @@
+#version 330 core
+
+out vec4 fragColor;
+
+in vec2 texCoord;
+
+// single channel texture holding the mapped quantity of every cell
+uniform sampler2D fieldSampler;
+// every colour channel spikes at its peak and falls off as exp(-|value - peak| / width)
+uniform vec3 rampPeaks;
+uniform vec3 rampWidths;
+
+void main() {
+    float value = texture(fieldSampler, texCoord).r;
+    fragColor = vec4(exp(-abs(value - rampPeaks) / rampWidths), 1.0f);
+}
@@ -0,0 +1,119 @@
+#include "halfConversionKernels.h"
+#include <cstring>
+
+// built with AVX2 and F16C enabled for this file alone, it only runs once simdKernels.cpp found both at runtime
+#if defined(__AVX2__) && (defined(__F16C__) || defined(_MSC_VER))
+#include <immintrin.h>
+
+namespace {
+	inline __m256 loadPacked8(const std::uint16_t* values, fieldPrecision precision) {
+		__m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values));
+		if (precision == bfloat16Precision) {
+			return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(packed), 16));
+		}
+		return _mm256_cvtph_ps(packed);
+	}
+
+	inline void storePacked8(std::uint16_t* out, __m256 values, fieldPrecision precision) {
+		if (precision == bfloat16Precision) {
+			__m256i bits = _mm256_castps_si256(values);
+			__m256i rounded = _mm256_add_epi32(_mm256_add_epi32(bits, _mm256_set1_epi32(0x7fff)), _mm256_and_si256(_mm256_srli_epi32(bits, 16), _mm256_set1_epi32(1)));
+			__m256i nan = _mm256_castps_si256(_mm256_cmp_ps(values, values, _CMP_UNORD_Q));
+			rounded = _mm256_blendv_epi8(rounded, _mm256_or_si256(bits, _mm256_set1_epi32(0x00400000)), nan);
+			// sign-extended, so the signed pack keeps all 16 bits
+			rounded = _mm256_srai_epi32(rounded, 16);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_packs_epi32(_mm256_castsi256_si128(rounded), _mm256_extracti128_si256(rounded, 1)));
+			return;
+		}
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm256_cvtps_ph(values, _MM_FROUND_TO_NEAREST_INT));
+	}
+
+	// a 32 bit gather at a packed index holds the value there in its low half and its right neighbour in the high
+	// half, so one gather gives two corners
+	inline void gatherPairs8(const std::uint16_t* values, __m256i index, fieldPrecision precision, __m256& left, __m256& right) {
+		__m256i words = _mm256_i32gather_epi32(reinterpret_cast<const int*>(values), index, 2);
+		if (precision == bfloat16Precision) {
+			left = _mm256_castsi256_ps(_mm256_slli_epi32(words, 16));
+			right = _mm256_castsi256_ps(_mm256_and_si256(words, _mm256_set1_epi32(int(0xffff0000u))));
+			return;
+		}
+		// lanes 0-3 and 4-7 as interleaved pairs, split into the even and odd values and put back in lane order
+		__m256 low = _mm256_cvtph_ps(_mm256_castsi256_si128(words));
+		__m256 high = _mm256_cvtph_ps(_mm256_extracti128_si256(words, 1));
+		left = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0))), _MM_SHUFFLE(3, 1, 2, 0)));
+		right = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1))), _MM_SHUFFLE(3, 1, 2, 0)));
+	}
+
+	int avx2AdvectPacked(std::uint16_t* const* out, const std::uint16_t* const* source, int channelCount, const std::uint16_t* velocityX, const std::uint16_t* velocityY,
+		int y, int width, int height, int stride, float deltaTime, float energyLost, bool periodic, fieldPrecision precision) {
+		int x = 0;
+		int rowStart = y * stride;
+		const __m256 dt = _mm256_set1_ps(deltaTime);
+		const __m256 energy = _mm256_set1_ps(energyLost);
+		const __m256 minusOne = _mm256_set1_ps(-1.0f);
+		const __m256 sizeX = _mm256_set1_ps(float(width));
+		const __m256 sizeY = _mm256_set1_ps(float(height));
+		const __m256 invSizeX = _mm256_set1_ps(1.0f / width);
+		const __m256 invSizeY = _mm256_set1_ps(1.0f / height);
+		const __m256 rowY = _mm256_set1_ps(float(y));
+		const __m256i strideV = _mm256_set1_epi32(stride);
+		__m256 xs = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+		const __m256 eight = _mm256_set1_ps(8.0f);
+
+		for (; x + 8 <= width; x += 8, xs = _mm256_add_ps(xs, eight)) {
+			__m256 xBacktrace = _mm256_sub_ps(xs, _mm256_mul_ps(loadPacked8(velocityX + x, precision), dt));
+			__m256 yBacktrace = _mm256_sub_ps(rowY, _mm256_mul_ps(loadPacked8(velocityY + x, precision), dt));
+			if (periodic) {
+				xBacktrace = _mm256_sub_ps(xBacktrace, _mm256_mul_ps(sizeX, _mm256_floor_ps(_mm256_mul_ps(xBacktrace, invSizeX))));
+				yBacktrace = _mm256_sub_ps(yBacktrace, _mm256_mul_ps(sizeY, _mm256_floor_ps(_mm256_mul_ps(yBacktrace, invSizeY))));
+			}
+			__m256 xFloor = _mm256_floor_ps(xBacktrace);
+			__m256 yFloor = _mm256_floor_ps(yBacktrace);
+
+			__m256 valid = _mm256_and_ps(
+				_mm256_and_ps(_mm256_cmp_ps(xBacktrace, minusOne, _CMP_GE_OQ), _mm256_cmp_ps(xBacktrace, sizeX, _CMP_LT_OQ)),
+				_mm256_and_ps(_mm256_cmp_ps(yBacktrace, minusOne, _CMP_GE_OQ), _mm256_cmp_ps(yBacktrace, sizeY, _CMP_LT_OQ)));
+
+			if (_mm256_movemask_ps(valid) == 0) {
+				for (int c = 0; c < channelCount; ++c) {
+					std::memcpy(out[c] + rowStart + x, source[c] + rowStart + x, 8 * sizeof(std::uint16_t));
+				}
+				continue;
+			}
+
+			__m256i index = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_cvttps_epi32(yFloor), strideV), _mm256_cvttps_epi32(xFloor));
+			index = _mm256_and_si256(index, _mm256_castps_si256(valid));
+			__m256i indexY = _mm256_add_epi32(index, strideV);
+			__m256 relPosx = _mm256_sub_ps(xBacktrace, xFloor);
+			__m256 relPosy = _mm256_sub_ps(yBacktrace, yFloor);
+
+			for (int c = 0; c < channelCount; ++c) {
+				const std::uint16_t* channel = source[c];
+				__m256 d, dx, dy, dxy;
+				gatherPairs8(channel, index, precision, d, dx);
+				gatherPairs8(channel, indexY, precision, dy, dxy);
+
+				__m256 lerp1Val = _mm256_add_ps(d, _mm256_mul_ps(relPosx, _mm256_sub_ps(dx, d)));
+				__m256 lerp2Val = _mm256_add_ps(dy, _mm256_mul_ps(relPosx, _mm256_sub_ps(dxy, dy)));
+				__m256 lerp3Val = _mm256_add_ps(lerp1Val, _mm256_mul_ps(relPosy, _mm256_sub_ps(lerp2Val, lerp1Val)));
+
+				// converting a packed value to float and back gives the same bits, so kept cells stay unchanged
+				__m256 oldValues = loadPacked8(channel + rowStart + x, precision);
+				storePacked8(out[c] + rowStart + x, _mm256_blendv_ps(oldValues, _mm256_mul_ps(lerp3Val, energy), valid), precision);
+			}
+		}
+		return x;
+	}
+}
+
+advectPackedKernel avx2AdvectPackedKernel() {
+	return avx2AdvectPacked;
+}
+
+#else
+
+advectPackedKernel avx2AdvectPackedKernel() {
+	return nullptr;
+}
+
+#endif
@@ -0,0 +1,69 @@
+#include "boundary.h"
+#include <cstdint>
+#include <cstring>
+
+namespace {
+	float mirrored(float value, bool negate) {
+		return negate ? -value : value;
+	}
+
+	// both 16 bit formats keep the sign in the top bit
+	std::uint16_t mirrored(std::uint16_t value, bool negate) {
+		return negate ? std::uint16_t(value ^ 0x8000u) : value;
+	}
+
+	template <typename Field>
+	void fillGhostRing(Field& values, boundaryCondition condition, ghostKind kind) {
+		int width = values.getWidth();
+		int height = values.getHeight();
+		if (width < 1 || height < 1) {
+			return;
+		}
+
+		// whether the ghost is the negated edge cell, across the left/right edges and across the top/bottom edges
+		bool negateX = false;
+		bool negateY = false;
+		if (condition == noSlipBoundary && kind != scalarGhosts) {
+			negateX = true;
+			negateY = true;
+		}
+		else if (condition == freeSlipBoundary) {
+			negateX = kind == velocityXGhosts;
+			negateY = kind == velocityYGhosts;
+		}
+
+		for (int y = 0; y < height; ++y) {
+			auto* row = values.row(y);
+			if (condition == periodicBoundary) {
+				row[-1] = row[width - 1];
+				row[width] = row[0];
+			}
+			else {
+				row[-1] = mirrored(row[0], negateX);
+				row[width] = mirrored(row[width - 1], negateX);
+			}
+		}
+
+		auto* above = values.row(-1) - 1;
+		auto* below = values.row(height) - 1;
+		const auto* first = values.row(0) - 1;
+		const auto* last = values.row(height - 1) - 1;
+		if (condition == periodicBoundary) {
+			std::memcpy(above, last, (width + 2) * sizeof(*above));
+			std::memcpy(below, first, (width + 2) * sizeof(*below));
+			return;
+		}
+		for (int x = 0; x < width + 2; ++x) {
+			above[x] = mirrored(first[x], negateY);
+			below[x] = mirrored(last[x], negateY);
+		}
+	}
+}
+
+void fillGhostCells(field& values, boundaryCondition condition, ghostKind kind) {
+	fillGhostRing(values, condition, kind);
+}
+
+void fillGhostCells(packedField& values, boundaryCondition condition, ghostKind kind) {
+	fillGhostRing(values, condition, kind);
+}
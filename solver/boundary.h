@@ -0,0 +1,39 @@
+#pragma once
+
+#include "field.h"
+#include "packedField.h"
+
+/**
+ * What lies beyond the edges of the grid, applied by filling the ghost cells of the fields.
+ */
+enum boundaryCondition {
+	// walls the fluid sticks to: the velocity is mirrored to zero at the wall, scalars do not flow through
+	noSlipBoundary = 0,
+	// walls the fluid slides along: only the velocity through the wall is mirrored to zero
+	freeSlipBoundary = 1,
+	// the grid wraps around, the ghost cells are copies of the cells on the opposite side
+	periodicBoundary = 2,
+	// everything continues unchanged past the edge, the ghost cells copy the edge cells
+	openBoundary = 3
+};
+
+// which quantity a field holds, velocity components are mirrored differently than scalars
+enum ghostKind {
+	scalarGhosts = 0,
+	velocityXGhosts = 1,
+	velocityYGhosts = 2
+};
+
+/**
+ * Fills the one cell wide ghost ring of a field for a boundary condition. The left and right columns are
+ * filled first, then the rows above and below across the full width, so the corners are consistent.
+ * @param values Field with a ghost ring of at least one cell.
+ * @param condition Boundary condition of all four edges.
+ * @param kind Quantity held by the field.
+ */
+void fillGhostCells(field& values, boundaryCondition condition, ghostKind kind);
+
+/**
+ * fillGhostCells for a field stored in a 16 bit format, the cells are copied or negated without converting them.
+ */
+void fillGhostCells(packedField& values, boundaryCondition condition, ghostKind kind);
@@ -0,0 +1,116 @@
+#include "colourMap.h"
+#include "simdKernels.h"
+#include <cmath>
+
+namespace {
+	// this spikes at newY1
+	float type2Eq(float x, float mag, float newY1) {
+		return std::exp(-std::abs((1 / mag) * (x - newY1)));
+	}
+}
+
+colourMap::colourMap(float maxDensity, int entries) {
+	this->build(0, maxDensity, entries, [](float density, unsigned char* rgba) {
+		for (int channel = 0; channel < 3; ++channel) {
+			rgba[channel] = (unsigned char)(type2Eq(density, densityRampWidths[channel], densityRampPeaks[channel]) * 255);
+		}
+		rgba[3] = 255;
+	});
+}
+
+void colourMap::mapRow(const float* density, unsigned char* pixels, int count) const {
+	lookupRow(reinterpret_cast<std::uint32_t*>(pixels), density, count, this->table.data(), int(this->table.size()) - 1, this->scale, this->bias);
+}
+
+namespace {
+	// whether row y is written: always without stamps, otherwise when its row of tiles changed since the last write
+	bool rowOutdated(const std::vector<std::uint64_t>* rowStamps, const std::vector<std::uint64_t>& gridStamps, int y) {
+		int tileRow = y / fluidGrid::activeTileSize;
+		return rowStamps == nullptr || (*rowStamps)[tileRow] != gridStamps[tileRow];
+	}
+
+	// rowStamps of another size than the grid's hold nothing, a stamp the grid never hands out makes every row outdated
+	void prepareRowStamps(const fluidGrid& grid, std::vector<std::uint64_t>& rowStamps) {
+		if (rowStamps.size() != grid.getTileRowStamps().size()) {
+			rowStamps.assign(grid.getTileRowStamps().size(), ~std::uint64_t(0));
+		}
+	}
+
+	void mapDensityRows(const fluidGrid& grid, const colourMap& colours, unsigned char* pixels, const std::vector<std::uint64_t>* rowStamps) {
+		const field& density = grid.density();
+		const std::vector<std::uint64_t>& gridStamps = grid.getTileRowStamps();
+		int width = grid.getWidth();
+		int height = grid.getHeight();
+
+		grid.getThreadPool().parallelFor(0, height, [&](int from, int to) {
+			for (int y = from; y < to; ++y) {
+				if (rowOutdated(rowStamps, gridStamps, y)) {
+					colours.mapRow(density.row(y), pixels + (height - 1 - y) * width * 4, width);
+				}
+			}
+		});
+	}
+
+	void writeFieldRows(const fluidGrid& grid, fieldQuantity quantity, bool halfFloat, unsigned char* texels, const std::vector<std::uint64_t>* rowStamps) {
+		int width = grid.getWidth();
+		int height = grid.getHeight();
+		int texelBytes = halfFloat ? 2 : 4;
+		const field& density = grid.density();
+		const field& velocityX = grid.velocityX();
+		const field& velocityY = grid.velocityY();
+		const std::vector<std::uint64_t>& gridStamps = grid.getTileRowStamps();
+
+		grid.getThreadPool().parallelFor(0, height, [&](int from, int to) {
+			// speeds are computed a chunk at a time on the stack before they are converted
+			const int chunk = 256;
+			alignas(32) float speeds[chunk];
+
+			for (int y = from; y < to; ++y) {
+				if (!rowOutdated(rowStamps, gridStamps, y)) {
+					continue;
+				}
+				unsigned char* texelRow = texels + std::size_t(height - 1 - y) * width * texelBytes;
+				for (int x = 0; x < width; x += chunk) {
+					int count = width - x < chunk ? width - x : chunk;
+					const float* values = density.row(y) + x;
+					if (quantity == speedQuantity) {
+						speedRow(speeds, velocityX.row(y) + x, velocityY.row(y) + x, count);
+						values = speeds;
+					}
+
+					if (halfFloat) {
+						floatToHalfRow(reinterpret_cast<std::uint16_t*>(texelRow) + x, values, count);
+					}
+					else {
+						std::memcpy(reinterpret_cast<float*>(texelRow) + x, values, count * sizeof(float));
+					}
+				}
+			}
+		});
+	}
+}
+
+void mapDensityToPx(const fluidGrid& grid, const colourMap& colours, unsigned char* pixels) {
+	mapDensityRows(grid, colours, pixels, nullptr);
+}
+
+void mapDensityToPx(const fluidGrid& grid, const colourMap& colours, std::vector<unsigned char>& pixels) {
+	pixels.resize(grid.getWidth() * grid.getHeight() * 4);
+	mapDensityToPx(grid, colours, pixels.data());
+}
+
+void mapDensityToPx(const fluidGrid& grid, const colourMap& colours, unsigned char* pixels, std::vector<std::uint64_t>& rowStamps) {
+	prepareRowStamps(grid, rowStamps);
+	mapDensityRows(grid, colours, pixels, &rowStamps);
+	rowStamps = grid.getTileRowStamps();
+}
+
+void writeFieldTexels(const fluidGrid& grid, fieldQuantity quantity, bool halfFloat, unsigned char* texels) {
+	writeFieldRows(grid, quantity, halfFloat, texels, nullptr);
+}
+
+void writeFieldTexels(const fluidGrid& grid, fieldQuantity quantity, bool halfFloat, unsigned char* texels, std::vector<std::uint64_t>& rowStamps) {
+	prepareRowStamps(grid, rowStamps);
+	writeFieldRows(grid, quantity, halfFloat, texels, &rowStamps);
+	rowStamps = grid.getTileRowStamps();
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "vector"
+#include "cstdint"
+#include "cstring"
+#include "fluidGrid.h"
+
+/**
+ * The default colour ramp: red, green and blue each spike at their peak density and fall off as
+ * exp(-|density - peak| / width). Shared by the lookup table and the shader that maps densities on the GPU.
+ */
+inline constexpr float densityRampPeaks[3] = { 3, 20, 50 };
+inline constexpr float densityRampWidths[3] = { 5, 20, 20 };
+
+/**
+ * Quantity written by writeFieldTexels().
+ */
+enum fieldQuantity {
+	densityQuantity = 0,
+	// length of the velocity
+	speedQuantity = 1
+};
+
+/**
+ * Density to RGBA8 lookup table. The colour function is evaluated once per entry when the table is built,
+ * mapping a pixel is then a clamped table read. Densities are quantized to the nearest of entries samples
+ * spread evenly over [minDensity, maxDensity], densities outside the range take the colour of its closest end.
+ */
+class colourMap {
+
+protected:
+	float minDensity = 0;
+	float maxDensity = 0;
+	// density to table position: position = density * scale + bias, the 0.5 of the rounding included in bias
+	float scale = 0;
+	float bias = 0;
+	// RGBA bytes of every entry in memory order
+	alignedVector<std::uint32_t> table;
+
+public:
+	/**
+	 * Builds the default map, red peaking at thin density, green at medium and blue at thick density.
+	 * @param maxDensity Density of the last entry.
+	 * @param entries Number of entries, small enough to stay in the L1 cache by default.
+	 */
+	colourMap(float maxDensity = 256, int entries = 8192);
+
+	/**
+	 * Rebuilds the table from colour(density, rgba), which writes the 4 bytes of a density's colour to rgba.
+	 * @param minDensity Density of the first entry.
+	 * @param maxDensity Density of the last entry.
+	 * @param entries Number of entries, at least 2.
+	 */
+	template<typename Colour>
+	void build(float minDensity, float maxDensity, int entries, const Colour& colour) {
+		entries = entries > 2 ? entries : 2;
+		this->minDensity = minDensity;
+		this->maxDensity = maxDensity > minDensity ? maxDensity : minDensity + 1;
+		this->scale = (entries - 1) / (this->maxDensity - this->minDensity);
+		this->bias = 0.5f - this->minDensity * this->scale;
+		this->table.resize(entries);
+
+		for (int index = 0; index < entries; ++index) {
+			unsigned char rgba[4] = { 0, 0, 0, 255 };
+			colour(this->minDensity + index / this->scale, rgba);
+			std::memcpy(&this->table[index], rgba, 4);
+		}
+	}
+
+	/**
+	 * Writes the colours of count densities as RGBA8 pixels.
+	 */
+	void mapRow(const float* density, unsigned char* pixels, int count) const;
+
+	float getMinDensity() const { return this->minDensity; }
+	float getMaxDensity() const { return this->maxDensity; }
+	int getEntries() const { return int(this->table.size()); }
+};
+
+/**
+ * Writes the density of every cell as an RGBA8 pixel, flipped so row 0 of the output is the bottom of the grid.
+ * Each grid row is written straight to its flipped place, rows are mapped on the grid's worker threads.
+ * @param grid Grid to read the density from.
+ * @param colours Colour of every density.
+ * @param pixels Destination of width * height * 4 bytes, only written to, so it may be mapped GPU memory.
+ */
+void mapDensityToPx(const fluidGrid& grid, const colourMap& colours, unsigned char* pixels);
+
+/**
+ * Same as above, resizing pixels to width * height * 4 bytes if needed.
+ */
+void mapDensityToPx(const fluidGrid& grid, const colourMap& colours, std::vector<unsigned char>& pixels);
+
+/**
+ * Same as above, only rewriting the rows of tiles that changed since pixels was last written.
+ * @param rowStamps The grid's getTileRowStamps() as of the last write to pixels, brought up to date. Empty
+ *        (or of another size) for pixels that hold nothing yet, every row is written then.
+ */
+void mapDensityToPx(const fluidGrid& grid, const colourMap& colours, unsigned char* pixels, std::vector<std::uint64_t>& rowStamps);
+
+/**
+ * Writes one quantity of every cell as a single float texel, flipped like mapDensityToPx(), for shaders
+ * that apply the colour ramp themselves.
+ * @param grid Grid to read from.
+ * @param quantity Value written for every cell.
+ * @param halfFloat Whether texels are 16 bit half floats (GL_HALF_FLOAT) instead of 32 bit floats.
+ * @param texels Destination of width * height texels, only written to, so it may be mapped GPU memory.
+ */
+void writeFieldTexels(const fluidGrid& grid, fieldQuantity quantity, bool halfFloat, unsigned char* texels);
+
+/**
+ * Same as above, only rewriting the rows of tiles whose stamp in rowStamps is out of date, see mapDensityToPx().
+ */
+void writeFieldTexels(const fluidGrid& grid, fieldQuantity quantity, bool halfFloat, unsigned char* texels, std::vector<std::uint64_t>& rowStamps);
@@ -0,0 +1,276 @@
+#include "conjugateGradient.h"
+#include "simdKernels.h"
+#include <cmath>
+
+conjugateGradientSolver::conjugateGradientSolver(int width, int height, int offset, bool dirichletBoundary) {
+	this->width = width;
+	this->height = height;
+	this->offset = offset;
+	this->dirichletBoundary = dirichletBoundary;
+
+	// block cell (x, y) is stored at (x + 1, y + 1), the zero ring makes every neighbour readable
+	this->solution = field(width + 2, height + 2, 0.0f);
+	this->residual = field(width + 2, height + 2, 0.0f);
+	this->search = field(width + 2, height + 2, 0.0f);
+	this->preconditioned = field(width + 2, height + 2, 0.0f);
+	this->applied = field(width + 2, height + 2, 0.0f);
+	this->pivots = field(width + 2, height + 2, 0.0f);
+	this->leftCoupling = field(width + 2, height + 2, 0.0f);
+	this->rightCoupling = field(width + 2, height + 2, 0.0f);
+	this->rowScratch.assign(width > 0 ? width : 1, 0.0f);
+}
+
+void conjugateGradientSolver::solve(float centre, float k, field& solution, const field& rhs, const field& initialGuess) {
+	this->iterations = 0;
+	this->residualNorm = 0;
+	if (this->width < 1 || this->height < 1) {
+		return;
+	}
+
+	this->centre = centre;
+	this->k = k;
+	// locals, so the compiler does not reload them after every store through a row pointer
+	int width = this->width;
+	int height = this->height;
+	if (this->preconditioner == incompleteCholesky && (centre != this->pivotsCentre || k != this->pivotsK)) {
+		this->buildPivots();
+	}
+
+	for (int y = 0; y < height; ++y) {
+		const float* guessRow = initialGuess.row(y + this->offset) + this->offset;
+		float* row = this->solution.row(y + 1) + 1;
+		for (int x = 0; x < width; ++x) {
+			row[x] = guessRow[x];
+		}
+	}
+
+	// r = rhs - A x
+	this->applyOperator(this->applied, this->solution);
+	double rhsNorm = 0;
+	for (int y = 0; y < height; ++y) {
+		const float* rhsRow = rhs.row(y + this->offset) + this->offset;
+		const float* appliedRow = this->applied.row(y + 1) + 1;
+		float* residualRow = this->residual.row(y + 1) + 1;
+		for (int x = 0; x < width; ++x) {
+			residualRow[x] = rhsRow[x] - appliedRow[x];
+		}
+		rhsNorm += dotRow(rhsRow, rhsRow, width);
+	}
+	rhsNorm = std::sqrt(rhsNorm);
+
+	double norm = std::sqrt(this->dot(this->residual, this->residual));
+	// a zero right hand side is solved by zero, measure against 1 so the loop still terminates
+	double scale = rhsNorm > 0 ? rhsNorm : 1.0;
+
+	if (norm / scale > this->tolerance) {
+		this->applyPreconditioner(this->preconditioned, this->residual);
+		for (int y = 1; y <= height; ++y) {
+			const float* from = this->preconditioned.row(y) + 1;
+			float* to = this->search.row(y) + 1;
+			for (int x = 0; x < width; ++x) {
+				to[x] = from[x];
+			}
+		}
+		double sigma = this->dot(this->preconditioned, this->residual);
+
+		while (this->iterations < this->maxIterations) {
+			this->applyOperator(this->applied, this->search);
+			double curvature = this->dot(this->search, this->applied);
+			if (curvature <= 0) {
+				break;
+			}
+			float alpha = float(sigma / curvature);
+
+			for (int y = 1; y <= height; ++y) {
+				float* solutionRow = this->solution.row(y) + 1;
+				float* residualRow = this->residual.row(y) + 1;
+				const float* searchRow = this->search.row(y) + 1;
+				const float* appliedRow = this->applied.row(y) + 1;
+				for (int x = 0; x < width; ++x) {
+					solutionRow[x] += alpha * searchRow[x];
+					residualRow[x] -= alpha * appliedRow[x];
+				}
+			}
+			++this->iterations;
+
+			norm = std::sqrt(this->dot(this->residual, this->residual));
+			if (norm / scale <= this->tolerance) {
+				break;
+			}
+
+			this->applyPreconditioner(this->preconditioned, this->residual);
+			double sigmaNew = this->dot(this->preconditioned, this->residual);
+			float beta = float(sigmaNew / sigma);
+			sigma = sigmaNew;
+
+			for (int y = 1; y <= height; ++y) {
+				float* searchRow = this->search.row(y) + 1;
+				const float* preconditionedRow = this->preconditioned.row(y) + 1;
+				for (int x = 0; x < width; ++x) {
+					searchRow[x] = preconditionedRow[x] + beta * searchRow[x];
+				}
+			}
+		}
+	}
+	this->residualNorm = float(norm / scale);
+
+	for (int y = 0; y < height; ++y) {
+		const float* row = this->solution.row(y + 1) + 1;
+		float* out = solution.row(y + this->offset) + this->offset;
+		for (int x = 0; x < width; ++x) {
+			out[x] = row[x];
+		}
+	}
+}
+
+int conjugateGradientSolver::lastIterations() const {
+	return this->iterations;
+}
+
+float conjugateGradientSolver::lastResidual() const {
+	return this->residualNorm;
+}
+
+float conjugateGradientSolver::cellDiag(int x, int y) const {
+	if (this->dirichletBoundary) {
+		return this->centre + 4 * this->k;
+	}
+	int neighbours = (x > 0) + (x < this->width - 1) + (y > 0) + (y < this->height - 1);
+	return this->centre + neighbours * this->k;
+}
+
+void conjugateGradientSolver::applyOperator(field& out, const field& in) {
+	// cells outside the block read zero from the ring, so only the diagonal of the edge cells needs fixing
+	float interiorDiag = this->centre + 4 * this->k;
+	for (int y = 0; y < this->height; ++y) {
+		float* outRow = out.row(y + 1) + 1;
+		const float* row = in.row(y + 1) + 1;
+		stencilRow(outRow, row, in.row(y) + 1, in.row(y + 2) + 1, this->width, interiorDiag, this->k);
+
+		if (this->dirichletBoundary) {
+			continue;
+		}
+		if (y == 0 || y == this->height - 1) {
+			for (int x = 0; x < this->width; ++x) {
+				outRow[x] += (this->cellDiag(x, y) - interiorDiag) * row[x];
+			}
+			continue;
+		}
+		outRow[0] += (this->cellDiag(0, y) - interiorDiag) * row[0];
+		if (this->width > 1) {
+			outRow[this->width - 1] += (this->cellDiag(this->width - 1, y) - interiorDiag) * row[this->width - 1];
+		}
+	}
+}
+
+void conjugateGradientSolver::applyPreconditioner(field& out, const field& in) {
+	int width = this->width;
+	int height = this->height;
+	float k = this->k;
+
+	switch (this->preconditioner) {
+	case noPreconditioner:
+		for (int y = 1; y <= height; ++y) {
+			const float* row = in.row(y) + 1;
+			float* outRow = out.row(y) + 1;
+			for (int x = 0; x < width; ++x) {
+				outRow[x] = row[x];
+			}
+		}
+		break;
+
+	case jacobiPreconditioner:
+		for (int y = 0; y < height; ++y) {
+			const float* row = in.row(y + 1) + 1;
+			float* outRow = out.row(y + 1) + 1;
+			for (int x = 0; x < width; ++x) {
+				outRow[x] = row[x] / this->cellDiag(x, y);
+			}
+		}
+		break;
+
+	case incompleteCholesky:
+		// forward substitution L q = r, then backward L^T z = q, both in place in out. The off-diagonals of
+		// L are -k * pivot of the left / upper cell, the zero ring of pivots and out covers the block edges
+		for (int y = 1; y <= height; ++y) {
+			const float* row = in.row(y) + 1;
+			const float* pivotRow = this->pivots.row(y) + 1;
+			const float* pivotUp = this->pivots.row(y - 1) + 1;
+			const float* outUp = out.row(y - 1) + 1;
+			const float* couplingRow = this->leftCoupling.row(y) + 1;
+			float* outRow = out.row(y) + 1;
+			float* partial = this->rowScratch.data();
+			// the upper neighbour is already final, only the left one is a serial dependency
+			for (int x = 0; x < width; ++x) {
+				partial[x] = (row[x] + k * pivotUp[x] * outUp[x]) * pivotRow[x];
+			}
+			for (int x = 0; x < width; ++x) {
+				outRow[x] = partial[x] + couplingRow[x] * outRow[x - 1];
+			}
+		}
+		for (int y = height; y >= 1; --y) {
+			const float* pivotRow = this->pivots.row(y) + 1;
+			const float* couplingRow = this->rightCoupling.row(y) + 1;
+			const float* outDown = out.row(y + 1) + 1;
+			float* outRow = out.row(y) + 1;
+			float* partial = this->rowScratch.data();
+			for (int x = 0; x < width; ++x) {
+				partial[x] = (outRow[x] + k * pivotRow[x] * outDown[x]) * pivotRow[x];
+			}
+			float right = 0;
+			for (int x = width - 1; x >= 0; --x) {
+				right = partial[x] + couplingRow[x] * right;
+				outRow[x] = right;
+			}
+		}
+		break;
+	}
+}
+
+void conjugateGradientSolver::buildPivots() {
+	// modified incomplete Cholesky, level 0. Pivots that come out too small fall back to the plain diagonal
+	const float safety = 0.25f;
+	float kk = this->k * this->k;
+
+	for (int y = 0; y < this->height; ++y) {
+		float* pivotRow = this->pivots.row(y + 1) + 1;
+		const float* pivotUp = this->pivots.row(y) + 1;
+		for (int x = 0; x < this->width; ++x) {
+			float diag = this->cellDiag(x, y);
+			float left = pivotRow[x - 1];
+			float up = pivotUp[x];
+			// the left cell's coupling to its lower neighbour and the upper cell's coupling to its right one
+			// exist unless they would leave the block
+			float leftFill = (y < this->height - 1) ? left * left : 0;
+			float upFill = (x < this->width - 1) ? up * up : 0;
+
+			float e = diag - kk * (left * left + up * up) - this->modification * kk * (leftFill + upFill);
+			if (e < safety * diag) {
+				e = diag;
+			}
+			pivotRow[x] = 1 / std::sqrt(e);
+		}
+	}
+
+	for (int y = 1; y <= this->height; ++y) {
+		const float* pivotRow = this->pivots.row(y) + 1;
+		float* leftRow = this->leftCoupling.row(y) + 1;
+		float* rightRow = this->rightCoupling.row(y) + 1;
+		for (int x = 0; x < this->width; ++x) {
+			leftRow[x] = this->k * pivotRow[x - 1] * pivotRow[x];
+			rightRow[x] = this->k * pivotRow[x] * pivotRow[x];
+		}
+	}
+
+	this->pivotsCentre = this->centre;
+	this->pivotsK = this->k;
+}
+
+double conjugateGradientSolver::dot(const field& a, const field& b) const {
+	// rows are added up in order, so the result does not depend on how the rows were computed
+	double sum = 0;
+	for (int y = 1; y <= this->height; ++y) {
+		sum += dotRow(a.row(y) + 1, b.row(y) + 1, this->width);
+	}
+	return sum;
+}
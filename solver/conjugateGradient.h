@@ -0,0 +1,96 @@
+#pragma once
+
+#include "field.h"
+
+/**
+ * Matrix-free preconditioned conjugate gradient for the symmetric 5-point systems of the solver,
+ * (centre + k * n) x - k * (sum of the n neighbours) = rhs, on a width x height block of cells.
+ * With dirichletBoundary every cell counts four neighbours and the ones outside the block are zero (the
+ * pressure equation), otherwise cells outside the block are left out of the stencil (implicit diffusion).
+ * Iterates until the relative residual drops below tolerance instead of a fixed number of sweeps.
+ */
+class conjugateGradientSolver {
+
+public:
+
+	enum preconditionerType {
+		noPreconditioner = 0,
+		jacobiPreconditioner = 1,
+		// modified incomplete Cholesky, IC(0) with the dropped fill partly moved onto the diagonal
+		incompleteCholesky = 2
+	};
+
+	preconditionerType preconditioner = incompleteCholesky;
+	// stop once |rhs - A x| / |rhs| is below this
+	float tolerance = 1e-4f;
+	int maxIterations = 200;
+	// share of the dropped fill the modified incomplete Cholesky adds back to the diagonal
+	float modification = 0.97f;
+
+protected:
+	int width = 0;
+	int height = 0;
+	int offset = 0;
+	float centre = 0;
+	float k = 0;
+	bool dirichletBoundary = true;
+
+	// working vectors with a zero border ring around the block
+	field solution;
+	field residual;
+	field search;
+	field preconditioned;
+	field applied;
+
+	// 1 / sqrt of the incomplete Cholesky pivots, rebuilt when the operator changes
+	field pivots;
+	// k * pivot * left pivot and k * pivot^2, the factors of the serial terms of the two substitutions
+	field leftCoupling;
+	field rightCoupling;
+	float pivotsCentre = -1;
+	float pivotsK = -1;
+
+	alignedVector<float> rowScratch;
+
+	int iterations = 0;
+	float residualNorm = 0;
+
+public:
+	conjugateGradientSolver() = default;
+
+	/**
+	 * @param width Cells per row of the block.
+	 * @param height Rows of the block.
+	 * @param offset Column and row of the block's first cell in the fields passed to solve().
+	 * @param dirichletBoundary Whether cells outside the block are zero (true) or left out of the stencil (false).
+	 */
+	conjugateGradientSolver(int width, int height, int offset, bool dirichletBoundary);
+
+	/**
+	 * @param centre Diagonal term that does not depend on the neighbours.
+	 * @param k Weight of every neighbour.
+	 * @param solution Receives the result.
+	 * @param rhs Right hand side.
+	 * @param initialGuess Where the iteration starts, may be the same field as solution.
+	 */
+	void solve(float centre, float k, field& solution, const field& rhs, const field& initialGuess);
+
+	/**
+	 * Iterations and relative residual of the last solve().
+	 */
+	int lastIterations() const;
+	float lastResidual() const;
+
+private:
+
+	float cellDiag(int x, int y) const;
+
+	void applyOperator(field& out, const field& in);
+
+	void applyPreconditioner(field& out, const field& in);
+
+	void buildPivots();
+
+	double dot(const field& a, const field& b) const;
+
+};
@@ -0,0 +1,304 @@
+#include "fft.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+namespace {
+	// columns of the spectrum gathered and transformed together, 8 complex values fill a cache line
+	constexpr int columnBatch = 8;
+	// rows transformed together
+	constexpr int rowBatch = 8;
+
+	// scratch of the transforms, one per thread, grown on first use
+	thread_local alignedVector<complexFloat> fftScratch;
+
+	complexFloat* threadScratch(int length) {
+		if (fftScratch.size() < std::size_t(length)) {
+			fftScratch.assign(std::size_t(length), complexFloat());
+		}
+		return fftScratch.data();
+	}
+
+	// plain products, std::complex's operator* checks for infinities and NaNs through a library call
+	inline complexFloat multiply(complexFloat a, complexFloat b) {
+		return { a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real() };
+	}
+
+	inline complexFloat multiplyConjugate(complexFloat a, complexFloat b) {
+		return { a.real() * b.real() + a.imag() * b.imag(), a.imag() * b.real() - a.real() * b.imag() };
+	}
+
+	complexFloat unitRoot(double angle) {
+		return { float(std::cos(angle)), float(std::sin(angle)) };
+	}
+
+	bool isPowerOfTwo(int value) {
+		return value > 0 && (value & (value - 1)) == 0;
+	}
+}
+
+fftPlan::fftPlan(int length) {
+	assert(length > 0);
+	this->length = length;
+	this->radixLength = length;
+	if (!isPowerOfTwo(length)) {
+		this->radixLength = 1;
+		while (this->radixLength < 2 * length - 1) {
+			this->radixLength *= 2;
+		}
+	}
+
+	const double pi = 3.14159265358979323846;
+	int n = this->radixLength;
+	for (int i = 1, j = 0; i < n; ++i) {
+		int bit = n >> 1;
+		for (; j & bit; bit >>= 1) {
+			j ^= bit;
+		}
+		j ^= bit;
+		if (i < j) {
+			this->swaps.push_back(i);
+			this->swaps.push_back(j);
+		}
+	}
+	this->twiddles.reserve(std::size_t(n));
+	for (int span = 2; span <= n; span *= 2) {
+		for (int j = 0; j < span / 2; ++j) {
+			this->twiddles.push_back(unitRoot(-2 * pi * j / span));
+		}
+	}
+
+	if (this->radixLength == length) {
+		return;
+	}
+	// 2 j k = j^2 + k^2 - (k - j)^2 turns the transform into a convolution with the chirp
+	this->chirp.resize(std::size_t(length));
+	for (int k = 0; k < length; ++k) {
+		long long square = (long long)k * k % (2LL * length);
+		this->chirp[k] = unitRoot(-pi * double(square) / length);
+	}
+	this->chirpSpectrum.assign(std::size_t(n), complexFloat());
+	for (int k = 0; k < length; ++k) {
+		complexFloat value = std::conj(this->chirp[k]) / float(n);
+		this->chirpSpectrum[k] = value;
+		if (k > 0) {
+			this->chirpSpectrum[std::size_t(n - k)] = value;
+		}
+	}
+	this->transformRadix2(this->chirpSpectrum.data(), 1, false);
+}
+
+void fftPlan::transformRadix2(complexFloat* data, int lanes, bool inverse) const {
+	int n = this->radixLength;
+	for (std::size_t index = 0; index < this->swaps.size(); index += 2) {
+		std::swap_ranges(data + std::size_t(this->swaps[index]) * lanes, data + std::size_t(this->swaps[index] + 1) * lanes,
+			data + std::size_t(this->swaps[index + 1]) * lanes);
+	}
+
+	// as floats: a butterfly applies one twiddle to 2 * lanes consecutive floats, which vectorizes
+	float* values = reinterpret_cast<float*>(data);
+	int floats = 2 * lanes;
+	float direction = inverse ? -1.0f : 1.0f;
+	for (int span = 2; span <= n; span *= 2) {
+		int half = span / 2;
+		const complexFloat* w = this->twiddles.data() + half - 1;
+		for (int start = 0; start < n; start += span) {
+			for (int j = 0; j < half; ++j) {
+				float wr = w[j].real();
+				float wi = direction * w[j].imag();
+				float* a = values + std::size_t(start + j) * floats;
+				float* b = a + std::size_t(half) * floats;
+				for (int lane = 0; lane < floats; lane += 2) {
+					float br = b[lane] * wr - b[lane + 1] * wi;
+					float bi = b[lane] * wi + b[lane + 1] * wr;
+					float ar = a[lane];
+					float ai = a[lane + 1];
+					a[lane] = ar + br;
+					a[lane + 1] = ai + bi;
+					b[lane] = ar - br;
+					b[lane + 1] = ai - bi;
+				}
+			}
+		}
+	}
+}
+
+void fftPlan::transform(complexFloat* data, int lanes, bool inverse, complexFloat* scratch) const {
+	if (this->radixLength == this->length) {
+		this->transformRadix2(data, lanes, inverse);
+		return;
+	}
+
+	// the inverse is the conjugate of the forward transform of the conjugate
+	for (int k = 0; k < this->length; ++k) {
+		for (int lane = 0; lane < lanes; ++lane) {
+			complexFloat value = data[std::size_t(k) * lanes + lane];
+			scratch[std::size_t(k) * lanes + lane] = multiply(inverse ? std::conj(value) : value, this->chirp[k]);
+		}
+	}
+	std::fill(scratch + std::size_t(this->length) * lanes, scratch + std::size_t(this->radixLength) * lanes, complexFloat());
+	this->transformRadix2(scratch, lanes, false);
+	for (int k = 0; k < this->radixLength; ++k) {
+		for (int lane = 0; lane < lanes; ++lane) {
+			scratch[std::size_t(k) * lanes + lane] = multiply(scratch[std::size_t(k) * lanes + lane], this->chirpSpectrum[k]);
+		}
+	}
+	this->transformRadix2(scratch, lanes, true);
+	for (int k = 0; k < this->length; ++k) {
+		for (int lane = 0; lane < lanes; ++lane) {
+			complexFloat value = multiply(scratch[std::size_t(k) * lanes + lane], this->chirp[k]);
+			data[std::size_t(k) * lanes + lane] = inverse ? std::conj(value) : value;
+		}
+	}
+}
+
+realFft2d::realFft2d(int width, int height) {
+	this->width = width;
+	this->height = height;
+	this->spectrumWidth = width / 2 + 1;
+	this->rowPlan = fftPlan(width % 2 == 0 ? width / 2 : width);
+	this->columnPlan = fftPlan(height);
+
+	const double pi = 3.14159265358979323846;
+	this->rowTwiddles.resize(std::size_t(this->spectrumWidth));
+	for (int k = 0; k < this->spectrumWidth; ++k) {
+		this->rowTwiddles[k] = unitRoot(-2 * pi * k / width);
+	}
+}
+
+int realFft2d::bufferLength() const {
+	// a batch of rows or of columns
+	return std::max(rowBatch * this->width, columnBatch * this->height);
+}
+
+int realFft2d::scratchLength() const {
+	return this->bufferLength() + std::max(rowBatch * this->rowPlan.getScratchLength(), columnBatch * this->columnPlan.getScratchLength());
+}
+
+void realFft2d::forwardRows(const float* values, int stride, int count, complexFloat* spectrum, complexFloat* buffer, complexFloat* scratch) const {
+	// the rows of a batch are transformed together, interleaved, so the butterflies run across the rows
+	if (this->width % 2 != 0) {
+		for (int r = 0; r < count; ++r) {
+			const float* row = values + std::size_t(r) * stride;
+			for (int x = 0; x < this->width; ++x) {
+				buffer[std::size_t(x) * count + r] = complexFloat(row[x], 0.0f);
+			}
+		}
+		this->rowPlan.transform(buffer, count, false, scratch);
+		for (int r = 0; r < count; ++r) {
+			complexFloat* spectrumRow = spectrum + std::size_t(r) * this->spectrumWidth;
+			for (int k = 0; k < this->spectrumWidth; ++k) {
+				spectrumRow[k] = buffer[std::size_t(k) * count + r];
+			}
+		}
+		return;
+	}
+
+	// the even values as real and the odd ones as imaginary parts, one transform of half the width gives both
+	int half = this->width / 2;
+	for (int r = 0; r < count; ++r) {
+		const float* row = values + std::size_t(r) * stride;
+		for (int j = 0; j < half; ++j) {
+			buffer[std::size_t(j) * count + r] = complexFloat(row[2 * j], row[2 * j + 1]);
+		}
+	}
+	this->rowPlan.transform(buffer, count, false, scratch);
+	for (int r = 0; r < count; ++r) {
+		complexFloat* spectrumRow = spectrum + std::size_t(r) * this->spectrumWidth;
+		for (int k = 0; k <= half; ++k) {
+			complexFloat z = buffer[std::size_t(k % half) * count + r];
+			complexFloat mirrored = std::conj(buffer[std::size_t((half - k) % half) * count + r]);
+			complexFloat even = 0.5f * (z + mirrored);
+			complexFloat difference = 0.5f * (z - mirrored);
+			// (z - conj(z mirrored)) / 2i
+			complexFloat odd(difference.imag(), -difference.real());
+			spectrumRow[k] = even + multiply(this->rowTwiddles[k], odd);
+		}
+	}
+}
+
+void realFft2d::inverseRows(const complexFloat* spectrum, float* values, int stride, int count, complexFloat* buffer, complexFloat* scratch) const {
+	if (this->width % 2 != 0) {
+		for (int r = 0; r < count; ++r) {
+			const complexFloat* spectrumRow = spectrum + std::size_t(r) * this->spectrumWidth;
+			buffer[r] = spectrumRow[0];
+			for (int k = 1; k < this->spectrumWidth; ++k) {
+				buffer[std::size_t(k) * count + r] = spectrumRow[k];
+				buffer[std::size_t(this->width - k) * count + r] = std::conj(spectrumRow[k]);
+			}
+		}
+		this->rowPlan.transform(buffer, count, true, scratch);
+		for (int r = 0; r < count; ++r) {
+			float* row = values + std::size_t(r) * stride;
+			for (int x = 0; x < this->width; ++x) {
+				row[x] = buffer[std::size_t(x) * count + r].real();
+			}
+		}
+		return;
+	}
+
+	// rebuilds the transform of the pairs of values, the even part plus i times the odd part
+	int half = this->width / 2;
+	for (int r = 0; r < count; ++r) {
+		const complexFloat* spectrumRow = spectrum + std::size_t(r) * this->spectrumWidth;
+		for (int k = 0; k < half; ++k) {
+			complexFloat value = spectrumRow[k];
+			complexFloat mirrored = std::conj(spectrumRow[half - k]);
+			complexFloat odd = multiplyConjugate(value - mirrored, this->rowTwiddles[k]);
+			buffer[std::size_t(k) * count + r] = (value + mirrored) + complexFloat(-odd.imag(), odd.real());
+		}
+	}
+	this->rowPlan.transform(buffer, count, true, scratch);
+	for (int r = 0; r < count; ++r) {
+		float* row = values + std::size_t(r) * stride;
+		for (int j = 0; j < half; ++j) {
+			complexFloat pair = buffer[std::size_t(j) * count + r];
+			row[2 * j] = pair.real();
+			row[2 * j + 1] = pair.imag();
+		}
+	}
+}
+
+void realFft2d::transformColumns(complexFloat* spectrum, bool inverse, threadPool& pool) const {
+	int batches = (this->spectrumWidth + columnBatch - 1) / columnBatch;
+	pool.parallelFor(0, batches, [this, spectrum, inverse](int from, int to) {
+		complexFloat* columns = threadScratch(this->scratchLength());
+		complexFloat* scratch = columns + this->bufferLength();
+		for (int batch = from; batch < to; ++batch) {
+			int first = batch * columnBatch;
+			int count = std::min(columnBatch, this->spectrumWidth - first);
+			// the columns of a batch are transformed together, interleaved as they lie in the rows, so a batch
+			// copies whole cache lines of every row and the butterflies run across the columns
+			for (int y = 0; y < this->height; ++y) {
+				std::copy_n(spectrum + std::size_t(y) * this->spectrumWidth + first, count, columns + std::size_t(y) * count);
+			}
+			this->columnPlan.transform(columns, count, inverse, scratch);
+			for (int y = 0; y < this->height; ++y) {
+				std::copy_n(columns + std::size_t(y) * count, count, spectrum + std::size_t(y) * this->spectrumWidth + first);
+			}
+		}
+	});
+}
+
+void realFft2d::forward(const float* values, int stride, complexFloat* spectrum, threadPool& pool) const {
+	pool.parallelFor(0, this->height, [this, values, stride, spectrum](int from, int to) {
+		complexFloat* buffer = threadScratch(this->scratchLength());
+		complexFloat* scratch = buffer + this->bufferLength();
+		for (int y = from; y < to; y += rowBatch) {
+			this->forwardRows(values + std::size_t(y) * stride, stride, std::min(rowBatch, to - y), spectrum + std::size_t(y) * this->spectrumWidth, buffer, scratch);
+		}
+	});
+	this->transformColumns(spectrum, false, pool);
+}
+
+void realFft2d::inverse(complexFloat* spectrum, float* values, int stride, threadPool& pool) const {
+	this->transformColumns(spectrum, true, pool);
+	pool.parallelFor(0, this->height, [this, values, stride, spectrum](int from, int to) {
+		complexFloat* buffer = threadScratch(this->scratchLength());
+		complexFloat* scratch = buffer + this->bufferLength();
+		for (int y = from; y < to; y += rowBatch) {
+			this->inverseRows(spectrum + std::size_t(y) * this->spectrumWidth, values + std::size_t(y) * stride, stride, std::min(rowBatch, to - y), buffer, scratch);
+		}
+	});
+}
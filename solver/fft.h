@@ -0,0 +1,104 @@
+#pragma once
+
+#include "complex"
+#include "memory/alignedAllocator.h"
+#include "threading/threadPool.h"
+
+using complexFloat = std::complex<float>;
+
+/**
+ * Plan of the complex discrete Fourier transform of one length, X[k] = sum of x[j] e^(-2 pi i j k / n), and
+ * of its inverse without the 1 / n. Powers of two run an iterative radix-2 transform, other lengths Bluestein's
+ * algorithm on a power of two at least 2n - 1 long, so every length costs O(n log n). The twiddle factors are
+ * computed in double when the plan is made, the transforms only read the plan and may run on several threads.
+ */
+class fftPlan {
+
+protected:
+	int length = 0;
+	// length of the radix-2 transform that is run, length itself or the Bluestein length
+	int radixLength = 0;
+	// index pairs the bit reversal permutation exchanges, one after another
+	alignedVector<int> swaps;
+	// the twiddles of every radix-2 stage one after another: the stage of span s holds e^(-2 pi i j / s), j < s / 2
+	alignedVector<complexFloat> twiddles;
+	// Bluestein: the chirp e^(-pi i k^2 / n), and the transform of its conjugate wrapped around radixLength,
+	// divided by radixLength so the convolution comes out scaled
+	alignedVector<complexFloat> chirp;
+	alignedVector<complexFloat> chirpSpectrum;
+
+	void transformRadix2(complexFloat* data, int lanes, bool inverse) const;
+
+public:
+	fftPlan() = default;
+
+	explicit fftPlan(int length);
+
+	int getLength() const { return this->length; }
+
+	/**
+	 * Values the scratch of transform() holds per lane, 0 for powers of two.
+	 */
+	int getScratchLength() const { return this->radixLength == this->length ? 0 : this->radixLength; }
+
+	/**
+	 * Transforms lanes interleaved sequences of length values in place, value j of lane l being
+	 * data[j * lanes + l]. Several lanes run the butterflies across them, e.g. on neighbouring columns of a matrix.
+	 * @param inverse Runs the inverse transform, unnormalized: forward then inverse multiplies by length.
+	 * @param scratch lanes * getScratchLength() values only this call uses.
+	 */
+	void transform(complexFloat* data, int lanes, bool inverse, complexFloat* scratch) const;
+};
+
+/**
+ * Two-dimensional discrete Fourier transform of a width x height array of floats. The spectrum of real values
+ * is conjugate symmetric, so only its height x (width / 2 + 1) half is computed and stored, row ky holding the
+ * wavenumbers kx = 0 .. width / 2. Even widths transform every row as a complex row of half the width. Batches
+ * of rows and then of columns of the spectrum are transformed together and split among the threads of a pool. Any size works, powers of
+ * two are fastest.
+ */
+class realFft2d {
+
+protected:
+	int width = 0;
+	int height = 0;
+	int spectrumWidth = 0;
+	// width / 2 for even widths, whose rows are transformed as pairs of values, width otherwise
+	fftPlan rowPlan;
+	fftPlan columnPlan;
+	// e^(-2 pi i k / width), k <= width / 2, separates the even and odd values of a row transformed in pairs
+	alignedVector<complexFloat> rowTwiddles;
+
+	// count consecutive rows, the spectrum rows and the rows of values one after another
+	void forwardRows(const float* values, int stride, int count, complexFloat* spectrum, complexFloat* buffer, complexFloat* scratch) const;
+	void inverseRows(const complexFloat* spectrum, float* values, int stride, int count, complexFloat* buffer, complexFloat* scratch) const;
+	void transformColumns(complexFloat* spectrum, bool inverse, threadPool& pool) const;
+
+	// complex values of per-thread scratch a transform needs, the batch buffer and then the plans' scratch
+	int bufferLength() const;
+	int scratchLength() const;
+
+public:
+	realFft2d() = default;
+
+	realFft2d(int width, int height);
+
+	int getWidth() const { return this->width; }
+	int getHeight() const { return this->height; }
+	int getSpectrumWidth() const { return this->spectrumWidth; }
+
+	/**
+	 * Transforms rows of floats into the half spectrum.
+	 * @param values Value (0, 0), value (x, y) is at values[y * stride + x].
+	 * @param stride Floats between the starts of two rows.
+	 * @param spectrum height x getSpectrumWidth() values, row after row.
+	 * @param pool Threads the rows and columns are split among.
+	 */
+	void forward(const float* values, int stride, complexFloat* spectrum, threadPool& pool) const;
+
+	/**
+	 * Transforms a half spectrum back into rows of floats, unnormalized: forward then inverse multiplies by
+	 * width * height. The columns are transformed in place, so spectrum is overwritten.
+	 */
+	void inverse(complexFloat* spectrum, float* values, int stride, threadPool& pool) const;
+};
@@ -0,0 +1,19 @@
+#include "field.h"
+#include <algorithm>
+
+field::field(int width, int height, float initialValue, int border, std::pmr::memory_resource* resource) : values(alignedAllocator<float>(resource)) {
+	this->width = width;
+	this->height = height;
+	this->border = border;
+	this->stride = paddedStride(width, border);
+	this->origin = border * this->stride + border;
+	this->values.assign(static_cast<size_t>(this->stride) * (height + 2 * border), initialValue);
+}
+
+void field::fill(float value) {
+	std::fill(this->values.begin(), this->values.end(), value);
+}
+
+std::size_t field::storageBytes(int width, int height, int border) {
+	return static_cast<size_t>(paddedStride(width, border)) * (height + 2 * border) * sizeof(float);
+}
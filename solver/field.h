@@ -0,0 +1,65 @@
+#pragma once
+
+#include "memory/alignedAllocator.h"
+
+/**
+ * One channel of grid data (density, one velocity component, pressure, ...) stored in its own contiguous
+ * aligned array. Rows are padded to a multiple of 16 floats so every row starts on a cache line.
+ * A field can carry a ring of ghost cells around its cells: row(-1), row(height), at(-1, y) and at(width, y)
+ * are then valid, so stencils read their neighbours without checking for the edge. The ghost cells are
+ * filled by a boundary condition pass (see boundary.h), the cells themselves are 0 .. width-1, 0 .. height-1.
+ */
+class field {
+
+protected:
+	int width = 0;
+	int height = 0;
+	int stride = 0;
+	int border = 0;
+	// offset of cell (0, 0) in values
+	int origin = 0;
+	alignedVector<float> values;
+
+	// rows rounded up to a whole number of cache lines, the ghost cells of both sides included
+	static int paddedStride(int width, int border) { return (width + 2 * border + 15) & ~15; }
+
+public:
+	field() = default;
+
+	/**
+	 * @param width Number of cells per row.
+	 * @param height Number of rows.
+	 * @param initialValue Value every cell, ghost cells included, starts with.
+	 * @param border Width of the ghost cell ring, 0 for none.
+	 * @param resource Where the cells are allocated, nullptr for the heap. A field from a frameArena must not
+	 *        outlive the frame.
+	 */
+	field(int width, int height, float initialValue = 0, int border = 0, std::pmr::memory_resource* resource = nullptr);
+
+	/**
+	 * Bytes the cells of a field of this size take, e.g. to reserve an arena for it.
+	 */
+	static std::size_t storageBytes(int width, int height, int border = 0);
+
+	int getWidth() const { return this->width; }
+	int getHeight() const { return this->height; }
+	int getStride() const { return this->stride; }
+	int getBorder() const { return this->border; }
+
+	/**
+	 * Cell (0, 0), cell (x, y) is at data()[y * getStride() + x].
+	 */
+	float* data() { return this->values.data() + this->origin; }
+	const float* data() const { return this->values.data() + this->origin; }
+
+	float* row(int y) { return this->values.data() + this->origin + y * this->stride; }
+	const float* row(int y) const { return this->values.data() + this->origin + y * this->stride; }
+
+	float& at(int x, int y) { return this->values[this->origin + y * this->stride + x]; }
+	float at(int x, int y) const { return this->values[this->origin + y * this->stride + x]; }
+
+	/**
+	 * Sets every cell, ghost cells included.
+	 */
+	void fill(float value);
+};
@@ -0,0 +1,33 @@
+#include "fixedTimestep.h"
+#include <cmath>
+
+fixedTimestep::fixedTimestep(double stepRate, int maxSubsteps) {
+	this->setStepRate(stepRate);
+	this->setMaxSubsteps(maxSubsteps);
+}
+
+int fixedTimestep::advance(double elapsedSeconds) {
+	if (elapsedSeconds > 0) {
+		this->accumulator += elapsedSeconds;
+	}
+
+	double due = std::floor(this->accumulator / this->stepLength);
+	int steps = due < this->maxSubsteps ? int(due) : this->maxSubsteps;
+	if (due > steps) {
+		this->dropped += (long long)(due - steps);
+	}
+	// the run steps and the dropped ones both leave the accumulator, only the partial step carries over
+	this->accumulator -= due * this->stepLength;
+	if (this->accumulator < 0) {
+		this->accumulator = 0;
+	}
+	return steps;
+}
+
+void fixedTimestep::setStepRate(double stepRate) {
+	this->stepLength = stepRate > 0 ? 1.0 / stepRate : 1.0 / 60;
+}
+
+void fixedTimestep::setMaxSubsteps(int maxSubsteps) {
+	this->maxSubsteps = maxSubsteps > 1 ? maxSubsteps : 1;
+}
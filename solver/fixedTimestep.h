@@ -0,0 +1,51 @@
+#pragma once
+
+/**
+ * Turns the real time between frames into a whole number of fixed-length simulation steps. Elapsed time is
+ * collected in an accumulator and every full step length in it becomes one step, the remainder carries over
+ * to the next frame, so the simulated time follows real time without the step length jittering with the
+ * frame time. A frame runs at most maxSubsteps steps: when the solver cannot keep up, the steps beyond that
+ * are dropped instead of piling up (the simulation then runs slower than real time rather than stalling).
+ */
+class fixedTimestep {
+
+protected:
+	double stepLength = 1.0 / 60;
+	int maxSubsteps = 4;
+	double accumulator = 0;
+	long long dropped = 0;
+
+public:
+	/**
+	 * @param stepRate Simulation steps per simulated second.
+	 * @param maxSubsteps Most steps run for a single frame.
+	 */
+	fixedTimestep(double stepRate = 60, int maxSubsteps = 4);
+
+	/**
+	 * Adds the real time since the last call and returns how many steps to run now.
+	 * @param elapsedSeconds Real time since the last call.
+	 */
+	int advance(double elapsedSeconds);
+
+	void setStepRate(double stepRate);
+	double getStepLength() const { return this->stepLength; }
+
+	void setMaxSubsteps(int maxSubsteps);
+	int getMaxSubsteps() const { return this->maxSubsteps; }
+
+	/**
+	 * Share of a step already accumulated towards the next one, 0 to 1, for interpolating between steps.
+	 */
+	double getAlpha() const { return this->accumulator / this->stepLength; }
+
+	/**
+	 * Steps dropped so far because a frame would have needed more than maxSubsteps.
+	 */
+	long long droppedSteps() const { return this->dropped; }
+
+	/**
+	 * Forgets the accumulated time, e.g. after a pause.
+	 */
+	void reset() { this->accumulator = 0; }
+};
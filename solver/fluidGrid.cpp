@@ -0,0 +1,950 @@
+#include "fluidGrid.h"
+#include "simdKernels.h"
+#include "boundary.h"
+#include "memory/allocationCounter.h"
+#include "profiling/profiler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+	// ghost kinds of density, velocity x and velocity y, in diffusedChannel() order
+	const ghostKind diffusedGhostKinds[3] = { scalarGhosts, velocityXGhosts, velocityYGhosts };
+}
+
+fluidGrid::fluidGrid(int width, int height, float constantOfViscosity, float energyLost) {
+	this->width = width;
+	this->height = height;
+	this->totalPixelAmount = width * height;
+	this->constantOfViscosity = constantOfViscosity;
+	this->energyLost = energyLost;
+
+	// the advected and diffused channels carry a ghost ring for the boundary condition
+	this->densityField = pingPongField(width, height, 1.0f, 1);
+	this->velocityXField = pingPongField(width, height, 0.0f, 1);
+	this->velocityYField = pingPongField(width, height, 0.0f, 1);
+
+	this->frameScratch.reserve(2 * field::storageBytes(width, height));
+	this->multigrid = multigridSolver(width, height);
+	this->pressureConjugateGradient = conjugateGradientSolver(std::max(width - 2, 0), std::max(height - 2, 0), 1, true);
+	this->diffusionConjugateGradient = conjugateGradientSolver(width, height, 0, false);
+
+	this->advectTargets.assign(3, nullptr);
+	this->advectSources.assign(3, nullptr);
+	this->packedAdvectTargets.assign(3, nullptr);
+	this->packedAdvectSources.assign(3, nullptr);
+
+	this->rowScratch.assign(width, 0.0f);
+
+	this->tileColumns = (width + activeTileSize - 1) / activeTileSize;
+	this->tileRows = (height + activeTileSize - 1) / activeTileSize;
+	// runs of active tiles are separated by at least one tile that is not
+	this->runsPerTileRow = (this->tileColumns + 1) / 2;
+	std::size_t tileCount = std::size_t(this->tileColumns) * this->tileRows;
+	this->liveTiles.assign(tileCount, 1);
+	this->activeTiles.assign(tileCount, 1);
+	this->dilationScratch.assign(tileCount, 0);
+	this->activeRuns.assign(std::size_t(this->tileRows) * this->runsPerTileRow * 2, 0);
+	this->activeRunCounts.assign(this->tileRows, 0);
+	this->tileRowSpeeds.assign(this->tileRows, 0.0f);
+	this->tileRowStamps.assign(this->tileRows, 0);
+	this->prepareActiveTiles();
+}
+
+void fluidGrid::step(float deltaTime) {
+	std::uint64_t allocationsBefore = alignedAllocationCount.load(std::memory_order_relaxed);
+	this->deltaTime = deltaTime;
+	this->frameScratch.reset();
+	this->prepareActiveTiles();
+
+	this->projectVel();
+	this->addVection();
+	this->diffusion();
+	if (this->tiledStep) {
+		this->settleActiveTiles();
+	}
+
+	this->stepAllocations = alignedAllocationCount.load(std::memory_order_relaxed) - allocationsBefore;
+}
+
+void fluidGrid::addSource(int centerX, int centerY, float velocityX, float velocityY, float densityAmount, int halfSize) {
+	for (int y = -halfSize; y <= halfSize; ++y) {
+		for (int x = -halfSize; x <= halfSize; ++x) {
+			int px = centerX + x;
+			int py = centerY + y;
+
+			if ((px < 0) || (px >= this->width) || (py < 0) || (py >= this->height))
+				continue;
+
+			if (this->storagePrecision != float32Precision) {
+				packedField& packedVelocityX = this->packedVelocityXField.front();
+				packedField& packedVelocityY = this->packedVelocityYField.front();
+				packedField& packedDensity = this->packedDensityField.front();
+				packedVelocityX.set(px, py, packedVelocityX.get(px, py) + velocityX);
+				packedVelocityY.set(px, py, packedVelocityY.get(px, py) + velocityY);
+				packedDensity.set(px, py, packedDensity.get(px, py) + densityAmount);
+				continue;
+			}
+
+			this->velocityXField.front().at(px, py) += velocityX;
+			this->velocityYField.front().at(px, py) += velocityY;
+			this->densityField.front().at(px, py) += densityAmount;
+		}
+	}
+	++this->stateVersion;
+	this->markLiveTiles(centerX - halfSize, centerY - halfSize, centerX + halfSize + 1, centerY + halfSize + 1);
+	this->liveSpeed += std::max(std::fabs(velocityX), std::fabs(velocityY));
+}
+
+int fluidGrid::addScalarChannel(float initialValue) {
+	if (this->storagePrecision != float32Precision) {
+		this->scalarFields.emplace_back();
+		this->packedScalarFields.emplace_back(this->width, this->height, this->storagePrecision, initialValue, 1);
+		this->channelMirrors.emplace_back();
+		this->mirrorVersions.push_back(0);
+	}
+	else {
+		this->scalarFields.emplace_back(this->width, this->height, initialValue, 1);
+	}
+	this->advectTargets.push_back(nullptr);
+	this->advectSources.push_back(nullptr);
+	this->packedAdvectTargets.push_back(nullptr);
+	this->packedAdvectSources.push_back(nullptr);
+	return int(this->scalarFields.size()) - 1;
+}
+
+int fluidGrid::scalarChannelCount() const {
+	return int(this->scalarFields.size());
+}
+
+void fluidGrid::addScalarSource(int channel, int centerX, int centerY, float amount, int halfSize) {
+	++this->stateVersion;
+	this->markLiveTiles(centerX - halfSize, centerY - halfSize, centerX + halfSize + 1, centerY + halfSize + 1);
+	if (this->storagePrecision != float32Precision) {
+		packedField& target = this->packedScalarFields[channel].front();
+		for (int y = std::max(centerY - halfSize, 0); y <= std::min(centerY + halfSize, this->height - 1); ++y) {
+			for (int x = std::max(centerX - halfSize, 0); x <= std::min(centerX + halfSize, this->width - 1); ++x) {
+				target.set(x, y, target.get(x, y) + amount);
+			}
+		}
+		return;
+	}
+
+	field& target = this->scalarFields[channel].front();
+	for (int y = std::max(centerY - halfSize, 0); y <= std::min(centerY + halfSize, this->height - 1); ++y) {
+		for (int x = std::max(centerX - halfSize, 0); x <= std::min(centerX + halfSize, this->width - 1); ++x) {
+			target.at(x, y) += amount;
+		}
+	}
+}
+
+const field& fluidGrid::scalar(int channel) const {
+	if (this->storagePrecision != float32Precision) {
+		return this->channelMirror(3 + channel);
+	}
+	return this->scalarFields[channel].front();
+}
+
+void fluidGrid::setBoundaryCondition(boundaryCondition boundary) {
+	this->boundary = boundary;
+	this->prepareActiveTiles();
+}
+
+boundaryCondition fluidGrid::getBoundaryCondition() const {
+	return this->boundary;
+}
+
+int fluidGrid::getWidth() const {
+	return this->width;
+}
+
+int fluidGrid::getHeight() const {
+	return this->height;
+}
+
+float fluidGrid::densityAt(int x, int y) const {
+	if (this->storagePrecision != float32Precision) {
+		return this->packedDensityField.front().get(x, y);
+	}
+	return this->densityField.front().at(x, y);
+}
+
+vec2 fluidGrid::velocityAt(int x, int y) const {
+	if (this->storagePrecision != float32Precision) {
+		return vec2{ this->packedVelocityXField.front().get(x, y), this->packedVelocityYField.front().get(x, y) };
+	}
+	return vec2{ this->velocityXField.front().at(x, y), this->velocityYField.front().at(x, y) };
+}
+
+const field& fluidGrid::density() const {
+	if (this->storagePrecision != float32Precision) {
+		return this->channelMirror(0);
+	}
+	return this->densityField.front();
+}
+
+const field& fluidGrid::velocityX() const {
+	if (this->storagePrecision != float32Precision) {
+		return this->channelMirror(1);
+	}
+	return this->velocityXField.front();
+}
+
+const field& fluidGrid::velocityY() const {
+	if (this->storagePrecision != float32Precision) {
+		return this->channelMirror(2);
+	}
+	return this->velocityYField.front();
+}
+
+void fluidGrid::setPressureSolver(pressureSolverType pressureSolver) {
+	this->pressureSolver = pressureSolver;
+	if (pressureSolver == spectralPressure) {
+		this->prepareSpectral();
+	}
+	this->prepareActiveTiles();
+}
+
+fluidGrid::pressureSolverType fluidGrid::getPressureSolver() const {
+	return this->pressureSolver;
+}
+
+void fluidGrid::setPressureIterations(int pressureIterations) {
+	this->pressureIterations = pressureIterations;
+}
+
+multigridSolver& fluidGrid::getMultigrid() {
+	return this->multigrid;
+}
+
+conjugateGradientSolver& fluidGrid::getPressureConjugateGradient() {
+	return this->pressureConjugateGradient;
+}
+
+void fluidGrid::setDiffusionSolver(diffusionSolverType diffusionSolver) {
+	this->diffusionSolver = diffusionSolver;
+	if (diffusionSolver == spectralDiffusion) {
+		this->prepareSpectral();
+	}
+	this->prepareActiveTiles();
+}
+
+void fluidGrid::prepareSpectral() {
+	if (this->spectral.getWidth() != this->width || this->spectral.getHeight() != this->height) {
+		this->spectral = spectralSolver(this->width, this->height);
+	}
+}
+
+fluidGrid::diffusionSolverType fluidGrid::getDiffusionSolver() const {
+	return this->diffusionSolver;
+}
+
+void fluidGrid::setDiffusionIterations(int diffusionIterations) {
+	this->diffusionIterations = diffusionIterations;
+}
+
+conjugateGradientSolver& fluidGrid::getDiffusionConjugateGradient() {
+	return this->diffusionConjugateGradient;
+}
+
+void fluidGrid::setRelaxationOrdering(relaxationOrdering ordering) {
+	this->ordering = ordering;
+}
+
+fluidGrid::relaxationOrdering fluidGrid::getRelaxationOrdering() const {
+	return this->ordering;
+}
+
+void fluidGrid::setThreadCount(int threadCount) {
+	this->workers.setThreadCount(threadCount);
+}
+
+int fluidGrid::getThreadCount() const {
+	return this->workers.getThreadCount();
+}
+
+threadPool& fluidGrid::getThreadPool() const {
+	return this->workers;
+}
+
+fluidGrid::solveReport fluidGrid::lastPressureSolve() const {
+	return this->pressureReport;
+}
+
+fluidGrid::solveReport fluidGrid::lastDiffusionSolve() const {
+	return this->diffusionReport;
+}
+
+std::uint64_t fluidGrid::lastStepAllocations() const {
+	return this->stepAllocations;
+}
+
+const frameArena& fluidGrid::getFrameArena() const {
+	return this->frameScratch;
+}
+
+void fluidGrid::setStoragePrecision(fieldPrecision precision) {
+	if (precision == this->storagePrecision) {
+		return;
+	}
+	int channelCount = 3 + int(this->scalarFields.size());
+	auto floatChannel = [this](int c) -> pingPongField& { return c < 3 ? this->diffusedChannel(c) : this->scalarFields[c - 3]; };
+
+	// through float, so converting between the two 16 bit formats rounds once more
+	std::vector<field> fronts(channelCount);
+	for (int c = 0; c < channelCount; ++c) {
+		if (this->storagePrecision == float32Precision) {
+			fronts[c] = std::move(floatChannel(c).front());
+		}
+		else {
+			fronts[c] = field(this->width, this->height, 0.0f, 1);
+			this->packedChannel(c).front().unpack(fronts[c]);
+		}
+	}
+
+	this->storagePrecision = precision;
+	this->packedScalarFields.resize(this->scalarFields.size());
+	for (int c = 0; c < channelCount; ++c) {
+		if (precision == float32Precision) {
+			floatChannel(c) = pingPongField(this->width, this->height, 0.0f, 1);
+			floatChannel(c).front() = std::move(fronts[c]);
+			this->packedChannel(c) = packedPingPongField();
+		}
+		else {
+			this->packedChannel(c) = packedPingPongField(this->width, this->height, precision, 0.0f, 1);
+			this->packedChannel(c).front().pack(fronts[c]);
+			floatChannel(c) = pingPongField();
+		}
+	}
+	if (precision == float32Precision) {
+		this->packedScalarFields.clear();
+	}
+
+	this->channelMirrors.assign(precision == float32Precision ? 0 : channelCount, field());
+	this->mirrorVersions.assign(this->channelMirrors.size(), 0);
+	++this->stateVersion;
+	this->stampTileRows(0, this->height);
+	this->prepareActiveTiles();
+	// the conjugate gradient diffusion converts the packed channels into float fields from the arena
+	this->frameScratch.reserve(2 * field::storageBytes(this->width, this->height, 1));
+}
+
+fieldPrecision fluidGrid::getStoragePrecision() const {
+	return this->storagePrecision;
+}
+
+std::size_t fluidGrid::getStateBytes() const {
+	int channelCount = 3 + int(this->scalarFields.size());
+	if (this->storagePrecision != float32Precision) {
+		return 2 * channelCount * this->packedDensityField.front().storageBytes();
+	}
+	return 2 * channelCount * field::storageBytes(this->width, this->height, 1);
+}
+
+void fluidGrid::setActiveTileTracking(bool enabled, float threshold) {
+	this->activeTileTracking = enabled;
+	this->activityThreshold = threshold;
+	if (enabled && this->tilePressure.getWidth() != this->width) {
+		this->tilePressure = field(this->width, this->height, 0.0f, 0);
+		this->tileDivergence = field(this->width, this->height, 0.0f, 0);
+	}
+	else if (!enabled) {
+		this->tilePressure = field();
+		this->tileDivergence = field();
+	}
+	// nothing is known about the tiles yet, the first step measures them all
+	std::fill(this->liveTiles.begin(), this->liveTiles.end(), 1);
+	this->prepareActiveTiles();
+}
+
+bool fluidGrid::getActiveTileTracking() const {
+	return this->activeTileTracking;
+}
+
+float fluidGrid::getActivityThreshold() const {
+	return this->activityThreshold;
+}
+
+int fluidGrid::lastActiveTiles() const {
+	return this->activeTileCount;
+}
+
+int fluidGrid::getTileCount() const {
+	return this->tileColumns * this->tileRows;
+}
+
+const std::vector<std::uint64_t>& fluidGrid::getTileRowStamps() const {
+	return this->tileRowStamps;
+}
+
+void fluidGrid::prepareActiveTiles() {
+	this->tiledStep = this->activeTileTracking && this->storagePrecision == float32Precision && this->width >= 3 && this->height >= 3 &&
+		this->activePressureSolver() == gaussSeidelPressure && this->activeDiffusionSolver() == gaussSeidelDiffusion;
+	int columns = this->tileColumns;
+	int rows = this->tileRows;
+
+	if (!this->tiledStep) {
+		// an untracked step may change any tile, so all of them are live when tracking resumes
+		std::fill(this->liveTiles.begin(), this->liveTiles.end(), 1);
+		std::fill(this->activeTiles.begin(), this->activeTiles.end(), 1);
+	}
+	else {
+		// the next advection carries nothing further than liveSpeed * deltaTime cells, a halo of half a tile more
+		// covers the spreading of the diffusion and the pressure around the moving fluid
+		int largest = std::max(columns, rows);
+		float reach = this->liveSpeed * this->deltaTime;
+		int radius = reach < float(largest * activeTileSize) ? int(std::ceil(reach)) : largest * activeTileSize;
+		radius = std::min((radius + activeTileSize / 2 + activeTileSize - 1) / activeTileSize, largest);
+		bool wrap = this->boundary == periodicBoundary;
+
+		// a square around every live tile, grown along the rows and then along the columns
+		for (int ty = 0; ty < rows; ++ty) {
+			for (int tx = 0; tx < columns; ++tx) {
+				std::uint8_t grown = 0;
+				for (int offset = -radius; offset <= radius && !grown; ++offset) {
+					int column = tx + offset;
+					column = wrap ? ((column % columns) + columns) % columns : column;
+					grown = column >= 0 && column < columns ? this->liveTiles[std::size_t(ty) * columns + column] : 0;
+				}
+				this->dilationScratch[std::size_t(ty) * columns + tx] = grown;
+			}
+		}
+		for (int ty = 0; ty < rows; ++ty) {
+			for (int tx = 0; tx < columns; ++tx) {
+				std::uint8_t grown = 0;
+				for (int offset = -radius; offset <= radius && !grown; ++offset) {
+					int row = ty + offset;
+					row = wrap ? ((row % rows) + rows) % rows : row;
+					grown = row >= 0 && row < rows ? this->dilationScratch[std::size_t(row) * columns + tx] : 0;
+				}
+				this->activeTiles[std::size_t(ty) * columns + tx] = grown;
+			}
+		}
+	}
+
+	this->activeTileCount = 0;
+	for (int ty = 0; ty < rows; ++ty) {
+		const std::uint8_t* active = this->activeTiles.data() + std::size_t(ty) * columns;
+		int* runs = this->activeRuns.data() + std::size_t(ty) * this->runsPerTileRow * 2;
+		int count = 0;
+		for (int tx = 0; tx < columns;) {
+			if (!active[tx]) {
+				++tx;
+				continue;
+			}
+			int first = tx;
+			while (tx < columns && active[tx]) {
+				++tx;
+			}
+			runs[2 * count] = first * activeTileSize;
+			runs[2 * count + 1] = std::min(tx * activeTileSize, this->width);
+			++count;
+			this->activeTileCount += tx - first;
+		}
+		this->activeRunCounts[ty] = count;
+	}
+}
+
+void fluidGrid::settleActiveTiles() {
+	int channelCount = 3 + int(this->scalarFields.size());
+	float threshold = this->activityThreshold;
+
+	this->workers.parallelFor(0, this->tileRows, [this, channelCount, threshold](int from, int to) {
+		for (int ty = from; ty < to; ++ty) {
+			int firstRow = ty * activeTileSize;
+			int endRow = std::min(firstRow + activeTileSize, this->height);
+			float rowSpeed = 0;
+			for (int tx = 0; tx < this->tileColumns; ++tx) {
+				std::size_t tile = std::size_t(ty) * this->tileColumns + tx;
+				if (!this->activeTiles[tile]) {
+					continue;
+				}
+				int firstColumn = tx * activeTileSize;
+				int count = std::min(firstColumn + activeTileSize, this->width) - firstColumn;
+
+				float largest = 0;
+				float speed = 0;
+				for (int c = 0; c < channelCount; ++c) {
+					const field& values = this->advectedChannel(c).front();
+					for (int y = firstRow; y < endRow; ++y) {
+						float magnitude = maxAbsRow(values.row(y) + firstColumn, count);
+						largest = std::max(largest, magnitude);
+						speed = c == 1 || c == 2 ? std::max(speed, magnitude) : speed;
+					}
+				}
+
+				// a NaN fails the comparison too, so a tile that blew up is cleared rather than kept alive
+				this->liveTiles[tile] = largest > threshold;
+				if (this->liveTiles[tile]) {
+					rowSpeed = std::max(rowSpeed, speed);
+					continue;
+				}
+				for (int c = 0; c < channelCount; ++c) {
+					pingPongField& channel = this->advectedChannel(c);
+					for (int y = firstRow; y < endRow; ++y) {
+						std::memset(channel.front().row(y) + firstColumn, 0, count * sizeof(float));
+						std::memset(channel.back().row(y) + firstColumn, 0, count * sizeof(float));
+					}
+				}
+			}
+			this->tileRowSpeeds[ty] = rowSpeed;
+		}
+	});
+
+	this->liveSpeed = 0;
+	for (float rowSpeed : this->tileRowSpeeds) {
+		this->liveSpeed = std::max(this->liveSpeed, rowSpeed);
+	}
+}
+
+void fluidGrid::markLiveTiles(int firstColumn, int firstRow, int endColumn, int endRow) {
+	firstColumn = std::max(firstColumn, 0);
+	firstRow = std::max(firstRow, 0);
+	endColumn = std::min(endColumn, this->width);
+	endRow = std::min(endRow, this->height);
+	if (firstColumn >= endColumn || firstRow >= endRow) {
+		return;
+	}
+	for (int ty = firstRow / activeTileSize; ty <= (endRow - 1) / activeTileSize; ++ty) {
+		for (int tx = firstColumn / activeTileSize; tx <= (endColumn - 1) / activeTileSize; ++tx) {
+			this->liveTiles[std::size_t(ty) * this->tileColumns + tx] = 1;
+		}
+	}
+	this->stampTileRows(firstRow, endRow);
+}
+
+void fluidGrid::stampTileRows(int firstRow, int endRow) {
+	for (int ty = firstRow / activeTileSize; ty < this->tileRows && ty * activeTileSize < endRow; ++ty) {
+		this->tileRowStamps[ty] = this->stateVersion;
+	}
+}
+
+void fluidGrid::stampActiveTileRows() {
+	for (int ty = 0; ty < this->tileRows; ++ty) {
+		if (this->activeRunCounts[ty] > 0) {
+			this->tileRowStamps[ty] = this->stateVersion;
+		}
+	}
+}
+
+pingPongField& fluidGrid::advectedChannel(int index) {
+	return index < 3 ? this->diffusedChannel(index) : this->scalarFields[index - 3];
+}
+
+packedPingPongField& fluidGrid::packedChannel(int index) {
+	packedPingPongField* channels[3] = { &this->packedDensityField, &this->packedVelocityXField, &this->packedVelocityYField };
+	return index < 3 ? *channels[index] : this->packedScalarFields[index - 3];
+}
+
+const packedPingPongField& fluidGrid::packedChannel(int index) const {
+	const packedPingPongField* channels[3] = { &this->packedDensityField, &this->packedVelocityXField, &this->packedVelocityYField };
+	return index < 3 ? *channels[index] : this->packedScalarFields[index - 3];
+}
+
+const field& fluidGrid::channelMirror(int index) const {
+	field& mirror = this->channelMirrors[index];
+	if (mirror.getWidth() == 0) {
+		mirror = field(this->width, this->height, 0.0f, 1);
+	}
+	else if (this->mirrorVersions[index] == this->stateVersion) {
+		return mirror;
+	}
+	this->packedChannel(index).front().unpack(mirror);
+	this->mirrorVersions[index] = this->stateVersion;
+	return mirror;
+}
+
+void fluidGrid::relaxDiffusion(field* const* targets, const field* const* rhs, const ghostKind* ghosts, int channelCount, float k) {
+	// lexicographic sweeps, the ghost cells are refilled after every sweep of a channel
+	float invDiag = 1 / (1 + 4 * k);
+	for (int a = 0; a < this->diffusionIterations; ++a) {
+		for (int c = 0; c < channelCount; ++c) {
+			field& target = *targets[c];
+			const field& old = *rhs[c];
+			for (int y = 0; y < this->height; ++y) {
+				this->forEachActiveRun(y, 0, this->width, [&](int left, int right) {
+					float* cur = target.row(y) + left;
+					gaussSeidelRow(cur, cur + 1, old.row(y) + left, target.row(y - 1) + left, target.row(y + 1) + left, this->rowScratch.data(), right - left, k, invDiag);
+				});
+			}
+			fillGhostCells(target, this->boundary, ghosts[c]);
+		}
+	}
+}
+
+void fluidGrid::relaxDiffusionRedBlack(field* const* targets, const field* const* rhs, const ghostKind* ghosts, int channelCount, float k) {
+	float invDiag = 1 / (1 + 4 * k);
+	for (int a = 0; a < this->diffusionIterations; ++a) {
+		for (int colour = 0; colour < 2; ++colour) {
+			// the cells of the colour are those with (x + y) % 2 == colour. The first and last row of a tile
+			// border rows another thread may be relaxing
+			this->workers.parallelFor(0, this->height, [&](int from, int to) {
+				for (int c = 0; c < channelCount; ++c) {
+					field& target = *targets[c];
+					const field& old = *rhs[c];
+					for (int y = from; y < to; ++y) {
+						this->forEachActiveRun(y, 0, this->width, [&](int left, int right) {
+							redBlackRow(target.row(y) + left, old.row(y) + left, target.row(y - 1) + left, target.row(y + 1) + left, right - left,
+								(colour + y + left) % 2, k, invDiag, y == from || y == to - 1);
+						});
+					}
+				}
+			});
+			for (int c = 0; c < channelCount; ++c) {
+				fillGhostCells(*targets[c], this->boundary, ghosts[c]);
+			}
+		}
+	}
+}
+
+fluidGrid::solveReport fluidGrid::solveDiffusion(field* const* targets, const field* const* rhs, const ghostKind* ghosts, int channelCount, float k) {
+	switch (this->activeDiffusionSolver()) {
+	case gaussSeidelDiffusion:
+		if (this->ordering == redBlackOrdering) {
+			this->relaxDiffusionRedBlack(targets, rhs, ghosts, channelCount, k);
+		}
+		else {
+			this->relaxDiffusion(targets, rhs, ghosts, channelCount, k);
+		}
+		return { this->diffusionIterations, -1 };
+
+	case conjugateGradientDiffusion: {
+		conjugateGradientSolver& solver = this->diffusionConjugateGradient;
+		solveReport report = { 0, 0 };
+		for (int c = 0; c < channelCount; ++c) {
+			solver.solve(1.0f, k, *targets[c], *rhs[c], *targets[c]);
+			fillGhostCells(*targets[c], this->boundary, ghosts[c]);
+			report.iterations = std::max(report.iterations, solver.lastIterations());
+			report.residual = std::max(report.residual, solver.lastResidual());
+		}
+		return report;
+	}
+
+	case spectralDiffusion:
+		for (int c = 0; c < channelCount; ++c) {
+			this->spectral.diffuse(*targets[c], *rhs[c], k, this->workers);
+			fillGhostCells(*targets[c], this->boundary, ghosts[c]);
+		}
+		return { 1, -1 };
+	}
+	return { 0, -1 };
+}
+
+void fluidGrid::diffusion() {
+	SNOWLIB_PROFILE_SCOPE(diffusionStage);
+	float k = this->constantOfViscosity * this->deltaTime;
+	++this->stateVersion;
+	if (this->storagePrecision != float32Precision) {
+		this->diffusionPacked(k);
+		return;
+	}
+
+	// the front buffers are the right hand side, the back buffers are relaxed in place. Density starts from
+	// zero, the velocities start from a copy of their current value. A tracked step only touches the active
+	// tiles, the others are zero in both buffers already
+	if (!this->tiledStep) {
+		this->densityField.back().fill(0);
+	}
+	this->workers.parallelFor(0, this->height, [this](int from, int to) {
+		for (int y = from; y < to; ++y) {
+			this->forEachActiveRun(y, 0, this->width, [this, y](int left, int right) {
+				if (this->tiledStep) {
+					std::memset(this->densityField.back().row(y) + left, 0, (right - left) * sizeof(float));
+				}
+				std::memcpy(this->velocityXField.back().row(y) + left, this->velocityXField.front().row(y) + left, (right - left) * sizeof(float));
+				std::memcpy(this->velocityYField.back().row(y) + left, this->velocityYField.front().row(y) + left, (right - left) * sizeof(float));
+			});
+		}
+	});
+	if (this->tiledStep) {
+		// the edge cells are all zero now, so this zeroes the ghost ring like the fill
+		fillGhostCells(this->densityField.back(), this->boundary, scalarGhosts);
+	}
+	fillGhostCells(this->velocityXField.back(), this->boundary, velocityXGhosts);
+	fillGhostCells(this->velocityYField.back(), this->boundary, velocityYGhosts);
+
+	field* targets[3];
+	const field* rhs[3];
+	for (int c = 0; c < 3; ++c) {
+		targets[c] = &this->diffusedChannel(c).back();
+		rhs[c] = &this->diffusedChannel(c).front();
+	}
+	this->diffusionReport = this->solveDiffusion(targets, rhs, diffusedGhostKinds, 3, k);
+
+	this->densityField.swap();
+	this->velocityXField.swap();
+	this->velocityYField.swap();
+	this->stampActiveTileRows();
+}
+
+void fluidGrid::diffusionPacked(float k) {
+	// as diffusion(), a channel at a time: it is converted into a float pair from the arena once, solved there
+	// by all the sweeps and converted back once, so the 16 bit cells are only read and written once per step.
+	// Rows are converted ghost cells included, the ranges are shifted by one as they start at row -1
+	int rowLength = this->width + 2;
+	solveReport report = { 0, -1 };
+	for (int c = 0; c < 3; ++c) {
+		packedPingPongField& channel = this->packedChannel(c);
+		frameArenaScope scratch(this->frameScratch);
+		field solution(this->width, this->height, 0.0f, 1, &this->frameScratch);
+		field rhs(this->width, this->height, 0.0f, 1, &this->frameScratch);
+		const packedField& front = channel.front();
+		this->workers.parallelFor(0, this->height + 2, [&](int from, int to) {
+			for (int y = from - 1; y < to - 1; ++y) {
+				unpackRow(rhs.row(y) - 1, front.row(y) - 1, rowLength, this->storagePrecision);
+				// density starts from zero, the velocities from their current value
+				if (c > 0) {
+					std::memcpy(solution.row(y) - 1, rhs.row(y) - 1, rowLength * sizeof(float));
+				}
+			}
+		});
+
+		field* target = &solution;
+		const field* source = &rhs;
+		solveReport channelReport = this->solveDiffusion(&target, &source, diffusedGhostKinds + c, 1, k);
+		report.iterations = std::max(report.iterations, channelReport.iterations);
+		report.residual = std::max(report.residual, channelReport.residual);
+
+		packedField& back = channel.back();
+		this->workers.parallelFor(0, this->height + 2, [&](int from, int to) {
+			for (int y = from - 1; y < to - 1; ++y) {
+				packRow(back.row(y) - 1, solution.row(y) - 1, rowLength, this->storagePrecision);
+			}
+		});
+	}
+	this->diffusionReport = report;
+
+	this->packedDensityField.swap();
+	this->packedVelocityXField.swap();
+	this->packedVelocityYField.swap();
+	this->stampActiveTileRows();
+}
+
+pingPongField& fluidGrid::diffusedChannel(int index) {
+	pingPongField* channels[3] = { &this->densityField, &this->velocityXField, &this->velocityYField };
+	return *channels[index];
+}
+
+void fluidGrid::addVection() {
+	SNOWLIB_PROFILE_SCOPE(advectionStage);
+	++this->stateVersion;
+	if (this->storagePrecision != float32Precision) {
+		this->addVectionPacked();
+		return;
+	}
+	// every channel is sampled from its front buffer along the front velocity and written to its back buffer,
+	// the backtrace of a cell is computed once for all of them
+	int channelCount = int(this->advectTargets.size());
+	for (int c = 0; c < channelCount; ++c) {
+		pingPongField& channel = this->advectedChannel(c);
+		// sources and projection changed the fronts since their ghost cells were last filled
+		fillGhostCells(channel.front(), this->boundary, c < 3 ? diffusedGhostKinds[c] : scalarGhosts);
+		this->advectTargets[c] = channel.back().data();
+		this->advectSources[c] = channel.front().data();
+	}
+
+	const field& velocityX = this->velocityXField.front();
+	const field& velocityY = this->velocityYField.front();
+	this->workers.parallelFor(0, this->height, [&](int from, int to) {
+		for (int y = from; y < to; ++y) {
+			this->forEachActiveRun(y, 0, this->width, [&](int left, int right) {
+				advectRow(this->advectTargets.data(), this->advectSources.data(), channelCount, velocityX.row(y), velocityY.row(y),
+					y, left, right, this->width, this->height, velocityX.getStride(), this->deltaTime, this->energyLost, this->boundary == periodicBoundary);
+			});
+		}
+	});
+
+	this->densityField.swap();
+	this->velocityXField.swap();
+	this->velocityYField.swap();
+	for (pingPongField& scalar : this->scalarFields) {
+		scalar.swap();
+	}
+	this->stampActiveTileRows();
+}
+
+void fluidGrid::addVectionPacked() {
+	// as addVection(), on the packed channels
+	int channelCount = int(this->packedAdvectTargets.size());
+	for (int c = 0; c < channelCount; ++c) {
+		packedPingPongField& channel = this->packedChannel(c);
+		fillGhostCells(channel.front(), this->boundary, c < 3 ? diffusedGhostKinds[c] : scalarGhosts);
+		this->packedAdvectTargets[c] = channel.back().data();
+		this->packedAdvectSources[c] = channel.front().data();
+	}
+
+	const packedField& velocityX = this->packedVelocityXField.front();
+	const packedField& velocityY = this->packedVelocityYField.front();
+	this->workers.parallelFor(0, this->height, [&](int from, int to) {
+		for (int y = from; y < to; ++y) {
+			advectPackedRow(this->packedAdvectTargets.data(), this->packedAdvectSources.data(), channelCount, velocityX.row(y), velocityY.row(y),
+				y, this->width, this->height, velocityX.getStride(), this->deltaTime, this->energyLost, this->boundary == periodicBoundary, this->storagePrecision);
+		}
+	});
+
+	for (int c = 0; c < channelCount; ++c) {
+		this->packedChannel(c).swap();
+	}
+	this->stampActiveTileRows();
+}
+
+void fluidGrid::projectVel() {
+	SNOWLIB_PROFILE_SCOPE(projectionStage);
+	if (this->width < 3 || this->height < 3) {
+		return;
+	}
+
+	++this->stateVersion;
+	if (this->activePressureSolver() == spectralPressure) {
+		this->projectSpectral();
+		this->stampActiveTileRows();
+		return;
+	}
+
+	if (this->tiledStep) {
+		// a pair of its own that is zero outside the active tiles, so only they are cleared again afterwards
+		// instead of a whole pair from the arena
+		this->projectWith(this->tileDivergence, this->tilePressure);
+		this->workers.parallelFor(1, this->height - 1, [this](int from, int to) {
+			for (int y = from; y < to; ++y) {
+				this->forEachActiveRun(y, 1, this->width - 1, [this, y](int left, int right) {
+					std::memset(this->tileDivergence.row(y) + left, 0, (right - left) * sizeof(float));
+					std::memset(this->tilePressure.row(y) + left, 0, (right - left) * sizeof(float));
+				});
+			}
+		});
+	}
+	else {
+		// both live until the velocity is projected, the space goes to the stages after
+		frameArenaScope scratch(this->frameScratch);
+		field divergence(this->width, this->height, 0.0f, 0, &this->frameScratch);
+		field pressure(this->width, this->height, 0.0f, 0, &this->frameScratch);
+		this->projectWith(divergence, pressure);
+	}
+	this->stampActiveTileRows();
+}
+
+void fluidGrid::projectWith(field& divergence, field& pressure) {
+	bool packed = this->storagePrecision != float32Precision;
+
+	float N = float(this->width);
+	float h = 1.0f / N;
+	// the border ring keeps zero pressure and its velocity, only the interior is projected in place
+	int count = this->width - 2;
+
+	// with packed channels only the velocity is converted, pressure and divergence stay in float
+	this->workers.parallelFor(1, this->height - 1, [&](int from, int to) {
+		for (int y = from; y < to; ++y) {
+			if (packed) {
+				const packedField& velocityX = this->packedVelocityXField.front();
+				const packedField& velocityY = this->packedVelocityYField.front();
+				divergencePackedRow(divergence.row(y) + 1, velocityX.row(y) + 1,
+					velocityY.row(y - 1) + 1, velocityY.row(y + 1) + 1, count, -0.5f * h, this->storagePrecision);
+				continue;
+			}
+			const field& velocityX = this->velocityXField.front();
+			const field& velocityY = this->velocityYField.front();
+			this->forEachActiveRun(y, 1, this->width - 1, [&](int left, int right) {
+				divergenceRow(divergence.row(y) + left, velocityX.row(y) + left,
+					velocityY.row(y - 1) + left, velocityY.row(y + 1) + left, right - left, -0.5f * h);
+			});
+		}
+	});
+
+	switch (this->activePressureSolver()) {
+	case gaussSeidelPressure:
+		if (this->ordering == redBlackOrdering) {
+			this->relaxPressureRedBlack(pressure, divergence);
+		}
+		else {
+			this->relaxPressure(pressure, divergence);
+		}
+		this->pressureReport = { this->pressureIterations, -1 };
+		break;
+	case multigridPressure:
+		this->multigrid.solve(pressure, divergence);
+		this->pressureReport = { this->multigrid.cycles, this->multigrid.lastResidual() };
+		break;
+	case conjugateGradientPressure:
+		this->pressureConjugateGradient.solve(0.0f, 1.0f, pressure, divergence, pressure);
+		this->pressureReport = { this->pressureConjugateGradient.lastIterations(), this->pressureConjugateGradient.lastResidual() };
+		break;
+	case spectralPressure:
+		break;
+	}
+
+	this->workers.parallelFor(1, this->height - 1, [&](int from, int to) {
+		for (int y = from; y < to; ++y) {
+			if (packed) {
+				subtractGradientPackedRow(this->packedVelocityXField.front().row(y) + 1, this->packedVelocityYField.front().row(y) + 1,
+					pressure.row(y) + 1, pressure.row(y - 1) + 1, pressure.row(y + 1) + 1, count, 0.5f * N, this->storagePrecision);
+				continue;
+			}
+			this->forEachActiveRun(y, 1, this->width - 1, [&](int left, int right) {
+				subtractGradientRow(this->velocityXField.front().row(y) + left, this->velocityYField.front().row(y) + left,
+					pressure.row(y) + left, pressure.row(y - 1) + left, pressure.row(y + 1) + left, right - left, 0.5f * N);
+			});
+		}
+	});
+}
+
+void fluidGrid::projectSpectral() {
+	this->pressureReport = { 1, -1 };
+	if (this->storagePrecision == float32Precision) {
+		this->spectral.project(this->velocityXField.front(), this->velocityYField.front(), this->workers);
+		return;
+	}
+
+	frameArenaScope scratch(this->frameScratch);
+	field velocityX(this->width, this->height, 0.0f, 1, &this->frameScratch);
+	field velocityY(this->width, this->height, 0.0f, 1, &this->frameScratch);
+	this->packedVelocityXField.front().unpack(velocityX);
+	this->packedVelocityYField.front().unpack(velocityY);
+	this->spectral.project(velocityX, velocityY, this->workers);
+	this->packedVelocityXField.front().pack(velocityX);
+	this->packedVelocityYField.front().pack(velocityY);
+}
+
+fluidGrid::pressureSolverType fluidGrid::activePressureSolver() const {
+	if (this->pressureSolver == spectralPressure && this->boundary != periodicBoundary) {
+		return conjugateGradientPressure;
+	}
+	return this->pressureSolver;
+}
+
+fluidGrid::diffusionSolverType fluidGrid::activeDiffusionSolver() const {
+	if (this->diffusionSolver == spectralDiffusion && this->boundary != periodicBoundary) {
+		return conjugateGradientDiffusion;
+	}
+	return this->diffusionSolver;
+}
+
+void fluidGrid::relaxPressure(field& pressure, const field& divergence) {
+	for (int iter = 0; iter < this->pressureIterations; ++iter) {
+		for (int y = 1; y < this->height - 1; ++y) {
+			this->forEachActiveRun(y, 1, this->width - 1, [&](int left, int right) {
+				float* pressureRow = pressure.row(y) + left;
+				gaussSeidelRow(pressureRow, pressureRow + 1, divergence.row(y) + left, pressure.row(y - 1) + left, pressure.row(y + 1) + left,
+					this->rowScratch.data(), right - left, 1.0f, 0.25f);
+			});
+		}
+	}
+}
+
+void fluidGrid::relaxPressureRedBlack(field& pressure, const field& divergence) {
+	for (int iter = 0; iter < this->pressureIterations; ++iter) {
+		for (int colour = 0; colour < 2; ++colour) {
+			// the first and last row of a tile border rows another thread may be relaxing
+			this->workers.parallelFor(1, this->height - 1, [this, &pressure, &divergence, colour](int from, int to) {
+				for (int y = from; y < to; ++y) {
+					this->forEachActiveRun(y, 1, this->width - 1, [&](int left, int right) {
+						redBlackRow(pressure.row(y) + left, divergence.row(y) + left, pressure.row(y - 1) + left, pressure.row(y + 1) + left,
+							right - left, (colour + y + left) % 2, 1.0f, 0.25f, y == from || y == to - 1);
+					});
+				}
+			});
+		}
+	}
+}
@@ -0,0 +1,427 @@
+#pragma once
+
+#include "vector"
+#include "cstdint"
+#include "algorithm"
+#include "field.h"
+#include "pingPongField.h"
+#include "packedField.h"
+#include "boundary.h"
+#include "multigrid.h"
+#include "conjugateGradient.h"
+#include "spectralSolver.h"
+#include "threading/threadPool.h"
+#include "memory/frameArena.h"
+#include "matrixOperations/fixedMatrix.h"
+
+/**
+ * Headless stable-fluids grid. Holds the density and velocity fields and advances them with step(),
+ * without needing a window or a GL context.
+ */
+class fluidGrid {
+
+public:
+
+	enum pressureSolverType {
+		// fixed number of lexicographic Gauss-Seidel sweeps
+		gaussSeidelPressure = 0,
+		// multigrid cycles, see getMultigrid() for the cycle and smoother settings
+		multigridPressure = 1,
+		// preconditioned conjugate gradient until the residual drops below its tolerance, see getPressureConjugateGradient()
+		conjugateGradientPressure = 2,
+		// exact projection in frequency space, periodicBoundary only, see spectralSolver::project()
+		spectralPressure = 3
+	};
+
+	enum diffusionSolverType {
+		// fixed number of lexicographic Gauss-Seidel sweeps
+		gaussSeidelDiffusion = 0,
+		// preconditioned conjugate gradient per channel, see getDiffusionConjugateGradient()
+		conjugateGradientDiffusion = 1,
+		// exact solve in frequency space per channel, periodicBoundary only
+		spectralDiffusion = 2
+	};
+
+	// cell order of the Gauss-Seidel sweeps of the pressure and diffusion stages
+	enum relaxationOrdering {
+		// row by row, every cell reads its already relaxed left and upper neighbour, runs on one thread
+		lexicographicOrdering = 0,
+		// checkerboard, all cells of one colour only read the other colour and are relaxed in parallel
+		redBlackOrdering = 1
+	};
+
+	/**
+	 * Work done by the last solve of a stage. residual is the relative residual |rhs - A x| / |rhs|, or -1 for
+	 * the Gauss-Seidel solvers, which do not measure it.
+	 */
+	struct solveReport {
+		int iterations;
+		float residual;
+	};
+
+protected:
+	int width;
+	int height;
+	int totalPixelAmount;
+	float constantOfViscosity = 0.5;
+	float energyLost = 0.99;
+	float deltaTime = 0;
+
+	// every channel lives in its own array so a pass only streams the channels it reads, stages read the
+	// front buffer, write the back one and swap
+	pingPongField densityField;
+	pingPongField velocityXField;
+	pingPongField velocityYField;
+
+	// passive scalars added with addScalarChannel(), advected along with density but not diffused
+	std::vector<pingPongField> scalarFields;
+	// whole-field pointers of every advected channel: density, velocity x, velocity y, then the scalars
+	std::vector<float*> advectTargets;
+	std::vector<const float*> advectSources;
+
+	// the channels stored in a 16 bit precision when storagePrecision is not float32Precision, the float
+	// channels above are then empty. Same layout and order as the float ones
+	fieldPrecision storagePrecision = float32Precision;
+	packedPingPongField packedDensityField;
+	packedPingPongField packedVelocityXField;
+	packedPingPongField packedVelocityYField;
+	std::vector<packedPingPongField> packedScalarFields;
+	std::vector<std::uint16_t*> packedAdvectTargets;
+	std::vector<const std::uint16_t*> packedAdvectSources;
+
+	// float copies of the packed channels handed out by the accessors, in advected channel order, each
+	// converted again when the state changed since (stateVersion differs from its version)
+	mutable std::vector<field> channelMirrors;
+	mutable std::vector<std::uint64_t> mirrorVersions;
+	std::uint64_t stateVersion = 0;
+
+	// temporaries of the stages (the projection's divergence and pressure), reset at the start of every step
+	frameArena frameScratch;
+
+	pressureSolverType pressureSolver = gaussSeidelPressure;
+	int pressureIterations = 20;
+	multigridSolver multigrid;
+	conjugateGradientSolver pressureConjugateGradient;
+
+	diffusionSolverType diffusionSolver = gaussSeidelDiffusion;
+	int diffusionIterations = 20;
+	conjugateGradientSolver diffusionConjugateGradient;
+
+	// shared by the spectral pressure and diffusion, made when one of them is first selected
+	spectralSolver spectral;
+
+	relaxationOrdering ordering = redBlackOrdering;
+	boundaryCondition boundary = openBoundary;
+	// shared by every parallel pass, mutable so passes over a const grid (the colour mapping) can use it too
+	mutable threadPool workers;
+
+	solveReport pressureReport = { 0, -1 };
+	solveReport diffusionReport = { 0, -1 };
+
+	alignedVector<float> rowScratch;
+
+	std::uint64_t stepAllocations = 0;
+
+	// activity tracking, see setActiveTileTracking(). The grid is cut into tiles of activeTileSize x activeTileSize
+	// cells, row of tiles after row of tiles
+	bool activeTileTracking = false;
+	float activityThreshold = 1e-3f;
+	int tileColumns = 0;
+	int tileRows = 0;
+	// whether the stages of the current step only run over the active tiles
+	bool tiledStep = false;
+	// tiles holding a value above the threshold after the last step, or touched by a source since
+	std::vector<std::uint8_t> liveTiles;
+	// live tiles grown by the advection reach and a halo, the tiles the stages run over
+	std::vector<std::uint8_t> activeTiles;
+	std::vector<std::uint8_t> dilationScratch;
+	// runs of neighbouring active tiles as cell columns [from, to), runsPerTileRow pairs reserved per row of tiles
+	std::vector<int> activeRuns;
+	std::vector<int> activeRunCounts;
+	int runsPerTileRow = 0;
+	int activeTileCount = 0;
+	// largest velocity component of the live tiles, how far the next advection can carry anything
+	float liveSpeed = 0;
+	std::vector<float> tileRowSpeeds;
+	// pressure and divergence of tracked steps, zero outside the active tiles from one step to the next
+	field tilePressure;
+	field tileDivergence;
+	// stateVersion at which a cell of every row of tiles last changed
+	std::vector<std::uint64_t> tileRowStamps;
+
+public:
+	// side length of the tiles activity is tracked by and texture rows are uploaded by
+	static constexpr int activeTileSize = 32;
+
+	/**
+	 * @param width Width of the grid in cells.
+	 * @param height Height of the grid in cells.
+	 * @param constantOfViscosity Diffusion rate used by the implicit diffusion stage.
+	 * @param energyLost Factor every advected value is multiplied by, per step.
+	 */
+	fluidGrid(int width, int height, float constantOfViscosity = 0.5, float energyLost = 0.99);
+
+	/**
+	 * Advances the simulation by one step: projection, advection of every channel, diffusion.
+	 * @param deltaTime Step length in seconds.
+	 */
+	void step(float deltaTime);
+
+	/**
+	 * Adds velocity and density in a square brush around a cell, cells outside the grid are skipped.
+	 * @param centerX Column of the brush center.
+	 * @param centerY Row of the brush center.
+	 * @param velocityX Velocity added to every cell of the brush along x.
+	 * @param velocityY Velocity added to every cell of the brush along y.
+	 * @param densityAmount Density added to every cell of the brush.
+	 * @param halfSize Half the side length of the brush.
+	 */
+	void addSource(int centerX, int centerY, float velocityX, float velocityY, float densityAmount, int halfSize);
+
+	/**
+	 * Adds a passive scalar channel, carried along the velocity with the same backtrace as density.
+	 * Allocates, call it before stepping.
+	 * @param initialValue Value every cell starts with.
+	 * @return Index of the channel for scalar() and addScalarSource().
+	 */
+	int addScalarChannel(float initialValue = 0);
+	int scalarChannelCount() const;
+
+	/**
+	 * Adds an amount to a scalar channel in a square brush around a cell, cells outside the grid are skipped.
+	 */
+	void addScalarSource(int channel, int centerX, int centerY, float amount, int halfSize);
+
+	/**
+	 * Scalar channel accessor, row 0 is the top of the grid.
+	 */
+	const field& scalar(int channel) const;
+
+	/**
+	 * Chooses what lies beyond the edges for advection and diffusion. The pressure solve keeps the outermost
+	 * ring of cells at zero pressure whatever the condition, and the conjugate gradient diffusion treats
+	 * every edge as closed.
+	 */
+	void setBoundaryCondition(boundaryCondition boundary);
+	boundaryCondition getBoundaryCondition() const;
+
+	int getWidth() const;
+	int getHeight() const;
+
+	float densityAt(int x, int y) const;
+	vec2 velocityAt(int x, int y) const;
+
+	/**
+	 * Channel accessors, row 0 is the top of the grid.
+	 */
+	const field& density() const;
+	const field& velocityX() const;
+	const field& velocityY() const;
+
+	/**
+	 * Chooses how the pressure equation of the projection is solved, can be changed between steps. The spectral
+	 * solver needs periodicBoundary, with any other condition conjugateGradientPressure runs in its place.
+	 * Unlike the other solvers it projects every cell, the border ring included.
+	 */
+	void setPressureSolver(pressureSolverType pressureSolver);
+	pressureSolverType getPressureSolver() const;
+
+	/**
+	 * @param pressureIterations Gauss-Seidel sweeps per step when gaussSeidelPressure is selected.
+	 */
+	void setPressureIterations(int pressureIterations);
+
+	/**
+	 * The multigrid pressure solver, its public members hold the cycle type, smoother and cycle count.
+	 */
+	multigridSolver& getMultigrid();
+
+	/**
+	 * The conjugate gradient pressure solver, its public members hold the preconditioner, tolerance and iteration cap.
+	 */
+	conjugateGradientSolver& getPressureConjugateGradient();
+
+	/**
+	 * Chooses how the implicit diffusion of the three channels is solved, can be changed between steps. The
+	 * spectral solver needs periodicBoundary, with any other condition conjugateGradientDiffusion runs in its place.
+	 */
+	void setDiffusionSolver(diffusionSolverType diffusionSolver);
+	diffusionSolverType getDiffusionSolver() const;
+
+	/**
+	 * @param diffusionIterations Gauss-Seidel sweeps per step when gaussSeidelDiffusion is selected.
+	 */
+	void setDiffusionIterations(int diffusionIterations);
+
+	/**
+	 * The conjugate gradient diffusion solver, shared by the three channels.
+	 */
+	conjugateGradientSolver& getDiffusionConjugateGradient();
+
+	/**
+	 * Chooses the cell order of the Gauss-Seidel pressure and diffusion sweeps. Red-black results do not
+	 * depend on the thread count.
+	 */
+	void setRelaxationOrdering(relaxationOrdering ordering);
+	relaxationOrdering getRelaxationOrdering() const;
+
+	/**
+	 * @param threadCount Threads the parallel passes run on, the calling one included. 0 picks the hardware concurrency.
+	 */
+	void setThreadCount(int threadCount);
+	int getThreadCount() const;
+
+	/**
+	 * The worker threads of the grid's passes, its tile size can be tuned there.
+	 */
+	threadPool& getThreadPool() const;
+
+	/**
+	 * Iterations (sweeps, cycles or conjugate gradient iterations) and residual of the last step's pressure solve.
+	 */
+	solveReport lastPressureSolve() const;
+
+	/**
+	 * Same for the last step's diffusion, the largest iteration count and residual of the three channels.
+	 */
+	solveReport lastDiffusionSolve() const;
+
+	/**
+	 * Heap allocations made through alignedAllocator during the last step(). Only counted in builds with
+	 * SNOWLIB_COUNT_ALLOCATIONS (Debug), expected to be 0 once the grid is constructed.
+	 */
+	std::uint64_t lastStepAllocations() const;
+
+	/**
+	 * The arena the stages take their temporaries from. Its frame peaks show how much a step needs at this grid
+	 * size, it is reserved for the projection when the grid is made and grows if a step needs more.
+	 */
+	const frameArena& getFrameArena() const;
+
+	/**
+	 * Chooses how the channels (density, velocity, scalars) are stored. float16Precision and bfloat16Precision
+	 * halve the memory the state takes; all arithmetic stays in float. Projection and advection convert the cells
+	 * they touch on load, diffusion converts a channel at a time into a float pair from the frame arena once
+	 * per step and sweeps that, and the pressure solve and other temporaries stay in float. Advection gathers
+	 * 16 bit corners with AVX2 and converts them with F16C, picked at runtime in builds without AVX2 (see
+	 * halfConversionInstructionSet()), and costs about what float32 advection does: 6.5 against 5.6 ns per cell
+	 * at 256x256 in an AVX2 build, 7.8 against 14.8 in an SSE2 build on the same processor. Processors without
+	 * AVX2 convert every corner in software, float16 several times slower than float32, bfloat16 less so.
+	 * float16 keeps more significant bits, bfloat16 the full float range.
+	 * The current state is converted, which allocates, call it between steps. With a 16 bit precision the
+	 * channel accessors return float copies that are converted when first read after the state changed.
+	 */
+	void setStoragePrecision(fieldPrecision precision);
+	fieldPrecision getStoragePrecision() const;
+
+	/**
+	 * Bytes the front and back buffers of every channel take.
+	 */
+	std::size_t getStateBytes() const;
+
+	/**
+	 * Tracks which tiles of the grid hold anything, so the stages only run where there is fluid. After every step a
+	 * tile whose density, velocity and scalars all stay within the threshold goes quiescent: it is set to zero and
+	 * the next steps skip it, until a source touches it or fluid may reach it. The tiles a step runs over are the
+	 * live ones grown by the advection reach of their fastest velocity plus a halo of half a tile, so a step costs
+	 * in proportion to the area in motion rather than the grid. The pressure is taken as zero outside that area.
+	 * Tracking needs float32Precision and the Gauss-Seidel pressure and diffusion, with anything else the steps
+	 * run over the whole grid.
+	 * @param threshold Largest magnitude a quiescent tile may hold, the error made by zeroing it.
+	 */
+	void setActiveTileTracking(bool enabled, float threshold = 1e-3f);
+	bool getActiveTileTracking() const;
+	float getActivityThreshold() const;
+
+	/**
+	 * Tiles the last step ran over, out of getTileCount().
+	 */
+	int lastActiveTiles() const;
+	int getTileCount() const;
+
+	/**
+	 * Stamp of every row of tiles (rows y / activeTileSize), changing whenever a cell of the row may have changed.
+	 * Copies of the grid such as texture frames keep the stamps they were made from and only redo the rows
+	 * whose stamp moved on.
+	 */
+	const std::vector<std::uint64_t>& getTileRowStamps() const;
+
+	/**
+	 * The stages step() runs, in this order. Public so they can be timed one at a time, they use the step
+	 * length of the last step().
+	 */
+	void projectVel();
+
+	void addVection();
+
+	void diffusion();
+
+private:
+
+	void relaxPressure(field& pressure, const field& divergence);
+
+	// the projection through a divergence and pressure field that start at zero
+	void projectWith(field& divergence, field& pressure);
+
+	void projectSpectral();
+
+	// the selected solvers, or the conjugate gradient ones in place of spectral ones without periodicBoundary
+	pressureSolverType activePressureSolver() const;
+
+	diffusionSolverType activeDiffusionSolver() const;
+
+	void prepareSpectral();
+
+	void relaxPressureRedBlack(field& pressure, const field& divergence);
+
+	// the channels' targets relaxed towards their right hand sides, ghost cells refilled after every sweep
+	void relaxDiffusion(field* const* targets, const field* const* rhs, const ghostKind* ghosts, int channelCount, float k);
+
+	void relaxDiffusionRedBlack(field* const* targets, const field* const* rhs, const ghostKind* ghosts, int channelCount, float k);
+
+	// diffuses the channels with the selected solver, starting from what their targets hold
+	solveReport solveDiffusion(field* const* targets, const field* const* rhs, const ghostKind* ghosts, int channelCount, float k);
+
+	void diffusionPacked(float k);
+
+	void addVectionPacked();
+
+	pingPongField& diffusedChannel(int index);
+
+	// channel index in advected order: density, velocity x, velocity y, then the scalars
+	packedPingPongField& packedChannel(int index);
+	const packedPingPongField& packedChannel(int index) const;
+
+	const field& channelMirror(int index) const;
+
+	// picks the tiles the step runs over and their runs of cells, all of them when the step is not tracked
+	void prepareActiveTiles();
+
+	// measures the active tiles after a tracked step and zeroes those that went quiescent
+	void settleActiveTiles();
+
+	void markLiveTiles(int firstColumn, int firstRow, int endColumn, int endRow);
+
+	// stamps the rows of tiles holding the cells [firstRow, endRow), or those with an active tile
+	void stampTileRows(int firstRow, int endRow);
+
+	void stampActiveTileRows();
+
+	// the channel in advected order: density, velocity x, velocity y, then the scalars
+	pingPongField& advectedChannel(int index);
+
+	// calls run(from, to) for every run of active cells of row y, clipped to the columns [firstColumn, endColumn)
+	template<typename Run>
+	void forEachActiveRun(int y, int firstColumn, int endColumn, const Run& run) const {
+		int tileRow = y / activeTileSize;
+		const int* runs = this->activeRuns.data() + std::size_t(tileRow) * this->runsPerTileRow * 2;
+		for (int index = 0; index < this->activeRunCounts[tileRow]; ++index) {
+			int from = std::max(runs[2 * index], firstColumn);
+			int to = std::min(runs[2 * index + 1], endColumn);
+			if (from < to) {
+				run(from, to);
+			}
+		}
+	}
+
+};
@@ -0,0 +1,38 @@
+#include "halfConversionKernels.h"
+
+// built with F16C enabled for this file alone, it only runs once simdKernels.cpp found it at runtime
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX__))
+#include <immintrin.h>
+
+namespace {
+	int f16cFloatToHalf(std::uint16_t* out, const float* values, int count) {
+		int x = 0;
+		for (; x + 8 <= count; x += 8) {
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm256_cvtps_ph(_mm256_loadu_ps(values + x), _MM_FROUND_TO_NEAREST_INT));
+		}
+		return x;
+	}
+
+	int f16cHalfToFloat(float* out, const std::uint16_t* values, int count) {
+		int x = 0;
+		for (; x + 8 <= count; x += 8) {
+			_mm256_storeu_ps(out + x, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(values + x))));
+		}
+		return x;
+	}
+}
+
+halfConversionKernels f16cHalfConversionKernels() {
+	halfConversionKernels kernels;
+	kernels.toHalf = f16cFloatToHalf;
+	kernels.toFloat = f16cHalfToFloat;
+	return kernels;
+}
+
+#else
+
+halfConversionKernels f16cHalfConversionKernels() {
+	return {};
+}
+
+#endif
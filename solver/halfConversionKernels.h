@@ -0,0 +1,33 @@
+#pragma once
+
+#include "cstdint"
+#include "packedField.h"
+
+// internal to simdKernels.cpp and the 16 bit kernels built for other instruction sets
+
+/**
+ * Converts the leading whole groups of eight values of a row, returns how many values it converted.
+ */
+typedef int (*floatToHalfKernel)(std::uint16_t* out, const float* values, int count);
+typedef int (*halfToFloatKernel)(float* out, const std::uint16_t* values, int count);
+
+struct halfConversionKernels {
+	floatToHalfKernel toHalf = nullptr;
+	halfToFloatKernel toFloat = nullptr;
+};
+
+/**
+ * The F16C conversions, null when this build has none (not an x86 target).
+ */
+halfConversionKernels f16cHalfConversionKernels();
+
+/**
+ * advectPackedRow over the leading whole groups of eight cells of a row, returns how many cells it advected.
+ */
+typedef int (*advectPackedKernel)(std::uint16_t* const* out, const std::uint16_t* const* source, int channelCount, const std::uint16_t* velocityX, const std::uint16_t* velocityY,
+	int y, int width, int height, int stride, float deltaTime, float energyLost, bool periodic, fieldPrecision precision);
+
+/**
+ * The AVX2 advection of packed channels, converting with F16C, null when this build has none (not an x86 target).
+ */
+advectPackedKernel avx2AdvectPackedKernel();
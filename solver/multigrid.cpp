@@ -0,0 +1,371 @@
+#include "multigrid.h"
+#include "simdKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+multigridSolver::multigridSolver(int width, int height) {
+	level finest;
+	finest.width = width - 2;
+	finest.height = height - 2;
+	// on the finest level the zero boundary is the border ring itself, one cell away from the edge cells
+	finest.edgeDiagX = 0;
+	finest.edgeDiagY = 0;
+	finest.residual = field(width, height, 0.0f);
+	this->levels.push_back(std::move(finest));
+
+	float distanceX = 1;
+	float distanceY = 1;
+	while (this->levels.back().width > 3 && this->levels.back().height > 3) {
+		level& fine = this->levels.back();
+		level coarse;
+		coarse.width = buildAxis(fine.axisX, fine.width, distanceX, distanceX);
+		coarse.height = buildAxis(fine.axisY, fine.height, distanceY, distanceY);
+		fine.transfer = field(coarse.width, fine.height, 0.0f);
+
+		// a zero boundary at distance d (in cells) seen through a mirrored ghost cell adds 1 / d - 1 to the diagonal
+		coarse.edgeDiagX = 1 / distanceX - 1;
+		coarse.edgeDiagY = 1 / distanceY - 1;
+		coarse.solution = field(coarse.width + 2, coarse.height + 2, 0.0f);
+		coarse.rhs = field(coarse.width + 2, coarse.height + 2, 0.0f);
+		coarse.residual = field(coarse.width + 2, coarse.height + 2, 0.0f);
+		this->levels.push_back(std::move(coarse));
+	}
+
+	int widest = std::max(width, 1);
+	this->rowScratch.assign(widest, 0.0f);
+	this->jacobiRows[0].assign(widest, 0.0f);
+	this->jacobiRows[1].assign(widest, 0.0f);
+}
+
+int multigridSolver::buildAxis(axisTransfer& transfer, int fineCount, float fineDistance, float& coarseDistance) {
+	int coarseCount;
+	for (int a = 0; a < 2; ++a) {
+		transfer.prolongFrom[a].assign(fineCount, -1);
+		transfer.prolongWeight[a].assign(fineCount, 0.0f);
+	}
+
+	if (fineCount % 2 == 0) {
+		// pairs of cells merge into one coarse cell centered between them
+		coarseCount = fineCount / 2;
+		coarseDistance = (fineDistance + 0.5f) / 2;
+		// a coarse neighbour beyond the boundary is the edge cell mirrored through the zero boundary
+		float ghostWeight = -(1 - coarseDistance) / coarseDistance;
+
+		for (int i = 0; i < fineCount; ++i) {
+			int nearCell = i / 2;
+			int farCell = (i % 2 == 0) ? nearCell - 1 : nearCell + 1;
+			transfer.prolongFrom[0][i] = nearCell;
+			transfer.prolongWeight[0][i] = 0.75f;
+			if (farCell < 0 || farCell >= coarseCount) {
+				transfer.prolongWeight[0][i] += 0.25f * ghostWeight;
+			}
+			else {
+				transfer.prolongFrom[1][i] = farCell;
+				transfer.prolongWeight[1][i] = 0.25f;
+			}
+		}
+	}
+	else {
+		// every other cell is kept, the ones between interpolate linearly, next to the boundary towards zero
+		coarseCount = (fineCount - 1) / 2;
+		coarseDistance = (1 + fineDistance) / 2;
+		float edgeWeight = fineDistance / (1 + fineDistance);
+
+		for (int i = 0; i < fineCount; ++i) {
+			if (i % 2 == 1) {
+				transfer.prolongFrom[0][i] = i / 2;
+				transfer.prolongWeight[0][i] = 1.0f;
+				continue;
+			}
+			int rightCell = i / 2;
+			int leftCell = rightCell - 1;
+			if (leftCell < 0) {
+				transfer.prolongFrom[0][i] = rightCell;
+				transfer.prolongWeight[0][i] = edgeWeight;
+			}
+			else if (rightCell >= coarseCount) {
+				transfer.prolongFrom[0][i] = leftCell;
+				transfer.prolongWeight[0][i] = edgeWeight;
+			}
+			else {
+				transfer.prolongFrom[0][i] = leftCell;
+				transfer.prolongWeight[0][i] = 0.5f;
+				transfer.prolongFrom[1][i] = rightCell;
+				transfer.prolongWeight[1][i] = 0.5f;
+			}
+		}
+	}
+
+	// restriction is the transposed prolongation, normalized so every coarse cell is a weighted average
+	std::vector<float> weightSum(coarseCount, 0.0f);
+	std::vector<int> count(coarseCount, 0);
+	for (int i = 0; i < fineCount; ++i) {
+		for (int a = 0; a < 2; ++a) {
+			if (transfer.prolongFrom[a][i] >= 0) {
+				weightSum[transfer.prolongFrom[a][i]] += transfer.prolongWeight[a][i];
+				++count[transfer.prolongFrom[a][i]];
+			}
+		}
+	}
+
+	transfer.restrictStart.assign(coarseCount + 1, 0);
+	for (int c = 0; c < coarseCount; ++c) {
+		transfer.restrictStart[c + 1] = transfer.restrictStart[c] + count[c];
+	}
+	transfer.restrictFrom.assign(transfer.restrictStart[coarseCount], 0);
+	transfer.restrictWeight.assign(transfer.restrictStart[coarseCount], 0.0f);
+
+	std::vector<int> fillPosition(transfer.restrictStart.begin(), transfer.restrictStart.end() - 1);
+	for (int i = 0; i < fineCount; ++i) {
+		for (int a = 0; a < 2; ++a) {
+			int c = transfer.prolongFrom[a][i];
+			if (c >= 0) {
+				transfer.restrictFrom[fillPosition[c]] = i;
+				transfer.restrictWeight[fillPosition[c]] = transfer.prolongWeight[a][i] / weightSum[c];
+				++fillPosition[c];
+			}
+		}
+	}
+
+	return coarseCount;
+}
+
+void multigridSolver::solve(field& solution, const field& rhs) {
+	if (this->levels.empty() || this->levels[0].width < 1 || this->levels[0].height < 1) {
+		return;
+	}
+
+	for (int a = 0; a < this->cycles; ++a) {
+		this->cycleLevel(0, solution, rhs);
+	}
+
+	this->computeResidual(0, solution, rhs, this->levels[0].residual);
+	double rhsNorm = this->interiorNorm(0, rhs);
+	double residual = this->interiorNorm(0, this->levels[0].residual);
+	this->residualNorm = rhsNorm > 0 ? float(residual / rhsNorm) : float(residual);
+}
+
+float multigridSolver::lastResidual() const {
+	return this->residualNorm;
+}
+
+int multigridSolver::levelCount() const {
+	return int(this->levels.size());
+}
+
+void multigridSolver::cycleLevel(int levelIndex, field& solution, const field& rhs) {
+	level& current = this->levels[levelIndex];
+
+	// the coarsest level is only a few cells wide, relaxing it to convergence is cheap
+	if (levelIndex == int(this->levels.size()) - 1) {
+		this->smooth(levelIndex, solution, rhs, 4 * (current.width + current.height));
+		return;
+	}
+
+	this->smooth(levelIndex, solution, rhs, this->preSmoothing);
+	this->computeResidual(levelIndex, solution, rhs, current.residual);
+	this->restrictResidual(levelIndex);
+
+	level& coarse = this->levels[levelIndex + 1];
+	coarse.solution.fill(0.0f);
+	for (int a = 0; a < int(this->cycle); ++a) {
+		this->cycleLevel(levelIndex + 1, coarse.solution, coarse.rhs);
+	}
+
+	this->prolongAndCorrect(levelIndex, solution);
+	this->smooth(levelIndex, solution, rhs, this->postSmoothing);
+}
+
+float multigridSolver::cellDiag(const level& current, int x, int y) const {
+	return 4.0f + current.edgeDiagX * ((x == 0) + (x == current.width - 1)) + current.edgeDiagY * ((y == 0) + (y == current.height - 1));
+}
+
+float multigridSolver::relaxCell(const level& current, const field& solution, const field& rhs, int x, int y) const {
+	// x and y are interior coordinates, the zero border ring makes every neighbour readable
+	float sum = solution.at(x, y + 1) + solution.at(x + 2, y + 1) + solution.at(x + 1, y) + solution.at(x + 1, y + 2);
+	return (rhs.at(x + 1, y + 1) + sum) / this->cellDiag(current, x, y);
+}
+
+float multigridSolver::jacobiCell(const level& current, const field& solution, const field& rhs, int x, int y) const {
+	return (1 - this->jacobiWeight) * solution.at(x + 1, y + 1) + this->jacobiWeight * this->relaxCell(current, solution, rhs, x, y);
+}
+
+void multigridSolver::smooth(int levelIndex, field& solution, const field& rhs, int sweeps) {
+	const level& current = this->levels[levelIndex];
+	int width = current.width;
+	int height = current.height;
+
+	// the row kernels take one diagonal per row, so the first and last cell of a row are relaxed on their own
+	for (int sweep = 0; sweep < sweeps; ++sweep) {
+		switch (this->smoother) {
+		case gaussSeidel:
+			for (int y = 0; y < height; ++y) {
+				float* row = solution.row(y + 1) + 1;
+				if (width < 3) {
+					for (int x = 0; x < width; ++x) {
+						row[x] = this->relaxCell(current, solution, rhs, x, y);
+					}
+					continue;
+				}
+				row[0] = this->relaxCell(current, solution, rhs, 0, y);
+				gaussSeidelRow(row + 1, row + 2, rhs.row(y + 1) + 2, solution.row(y) + 2, solution.row(y + 2) + 2,
+					this->rowScratch.data(), width - 2, 1.0f, 1 / this->cellDiag(current, 1, y));
+				row[width - 1] = this->relaxCell(current, solution, rhs, width - 1, y);
+			}
+			break;
+
+		case redBlack:
+			for (int colour = 0; colour < 2; ++colour) {
+				for (int y = 0; y < height; ++y) {
+					float* row = solution.row(y + 1) + 1;
+					if (width < 3) {
+						for (int x = (colour + y) % 2; x < width; x += 2) {
+							row[x] = this->relaxCell(current, solution, rhs, x, y);
+						}
+						continue;
+					}
+					if ((colour + y) % 2 == 0) {
+						row[0] = this->relaxCell(current, solution, rhs, 0, y);
+					}
+					redBlackRow(row + 1, rhs.row(y + 1) + 2, solution.row(y) + 2, solution.row(y + 2) + 2,
+						width - 2, (colour + y + 1) % 2, 1.0f, 1 / this->cellDiag(current, 1, y), false);
+					if ((colour + y + width - 1) % 2 == 0) {
+						row[width - 1] = this->relaxCell(current, solution, rhs, width - 1, y);
+					}
+				}
+			}
+			break;
+
+		case jacobi:
+			// two rolling row buffers: row y - 1 is written back once row y no longer needs its old values
+			for (int y = 0; y < height; ++y) {
+				float* out = this->jacobiRows[y % 2].data();
+				const float* row = solution.row(y + 1) + 1;
+				if (width < 3) {
+					for (int x = 0; x < width; ++x) {
+						out[x] = this->jacobiCell(current, solution, rhs, x, y);
+					}
+				}
+				else {
+					out[0] = this->jacobiCell(current, solution, rhs, 0, y);
+					jacobiRow(out + 1, row + 1, rhs.row(y + 1) + 2, solution.row(y) + 2, solution.row(y + 2) + 2,
+						width - 2, 1.0f, 1 / this->cellDiag(current, 1, y), this->jacobiWeight);
+					out[width - 1] = this->jacobiCell(current, solution, rhs, width - 1, y);
+				}
+				if (y > 0) {
+					std::memcpy(solution.row(y) + 1, this->jacobiRows[(y - 1) % 2].data(), width * sizeof(float));
+				}
+			}
+			std::memcpy(solution.row(height) + 1, this->jacobiRows[(height - 1) % 2].data(), width * sizeof(float));
+			break;
+		}
+	}
+}
+
+void multigridSolver::computeResidual(int levelIndex, const field& solution, const field& rhs, field& residual) {
+	const level& current = this->levels[levelIndex];
+	int width = current.width;
+
+	for (int y = 0; y < current.height; ++y) {
+		float* out = residual.row(y + 1) + 1;
+		const float* rhsRow = rhs.row(y + 1) + 1;
+		const float* row = solution.row(y + 1) + 1;
+
+		out[0] = rhsRow[0] - (this->cellDiag(current, 0, y) * row[0] - (row[-1] + row[1] + solution.at(1, y) + solution.at(1, y + 2)));
+		if (width > 1) {
+			int x = width - 1;
+			out[x] = rhsRow[x] - (this->cellDiag(current, x, y) * row[x] - (row[x - 1] + row[x + 1] + solution.at(x + 1, y) + solution.at(x + 1, y + 2)));
+		}
+		if (width > 2) {
+			residualRow(out + 1, row + 1, rhsRow + 1, solution.row(y) + 2, solution.row(y + 2) + 2,
+				width - 2, this->cellDiag(current, 1, y), 1.0f);
+		}
+	}
+}
+
+void multigridSolver::restrictResidual(int levelIndex) {
+	level& fine = this->levels[levelIndex];
+	level& coarse = this->levels[levelIndex + 1];
+	const axisTransfer& axisX = fine.axisX;
+	const axisTransfer& axisY = fine.axisY;
+
+	// separable: average along x into the transfer field, then along y into the coarse right hand side,
+	// which is 4 times the average since the coarse spacing is twice the fine one
+	for (int fy = 0; fy < fine.height; ++fy) {
+		const float* fineRow = fine.residual.row(fy + 1) + 1;
+		float* transferRow = fine.transfer.row(fy);
+		for (int cx = 0; cx < coarse.width; ++cx) {
+			float sum = 0;
+			for (int e = axisX.restrictStart[cx]; e < axisX.restrictStart[cx + 1]; ++e) {
+				sum += axisX.restrictWeight[e] * fineRow[axisX.restrictFrom[e]];
+			}
+			transferRow[cx] = sum;
+		}
+	}
+
+	for (int cy = 0; cy < coarse.height; ++cy) {
+		float* coarseRow = coarse.rhs.row(cy + 1) + 1;
+		for (int cx = 0; cx < coarse.width; ++cx) {
+			coarseRow[cx] = 0;
+		}
+		for (int e = axisY.restrictStart[cy]; e < axisY.restrictStart[cy + 1]; ++e) {
+			const float* transferRow = fine.transfer.row(axisY.restrictFrom[e]);
+			float weight = 4.0f * axisY.restrictWeight[e];
+			for (int cx = 0; cx < coarse.width; ++cx) {
+				coarseRow[cx] += weight * transferRow[cx];
+			}
+		}
+	}
+}
+
+void multigridSolver::prolongAndCorrect(int levelIndex, field& solution) {
+	level& fine = this->levels[levelIndex];
+	const level& coarse = this->levels[levelIndex + 1];
+	const axisTransfer& axisX = fine.axisX;
+	const axisTransfer& axisY = fine.axisY;
+
+	// separable: interpolate along y into the transfer field, then along x onto the fine solution
+	for (int fy = 0; fy < fine.height; ++fy) {
+		float* transferRow = fine.transfer.row(fy);
+		const float* row0 = coarse.solution.row(axisY.prolongFrom[0][fy] + 1) + 1;
+		float weight0 = axisY.prolongWeight[0][fy];
+		if (axisY.prolongFrom[1][fy] < 0) {
+			for (int cx = 0; cx < coarse.width; ++cx) {
+				transferRow[cx] = weight0 * row0[cx];
+			}
+			continue;
+		}
+		const float* row1 = coarse.solution.row(axisY.prolongFrom[1][fy] + 1) + 1;
+		float weight1 = axisY.prolongWeight[1][fy];
+		for (int cx = 0; cx < coarse.width; ++cx) {
+			transferRow[cx] = weight0 * row0[cx] + weight1 * row1[cx];
+		}
+	}
+
+	for (int fy = 0; fy < fine.height; ++fy) {
+		const float* transferRow = fine.transfer.row(fy);
+		float* fineRow = solution.row(fy + 1) + 1;
+		for (int fx = 0; fx < fine.width; ++fx) {
+			float value = axisX.prolongWeight[0][fx] * transferRow[axisX.prolongFrom[0][fx]];
+			if (axisX.prolongFrom[1][fx] >= 0) {
+				value += axisX.prolongWeight[1][fx] * transferRow[axisX.prolongFrom[1][fx]];
+			}
+			fineRow[fx] += value;
+		}
+	}
+}
+
+double multigridSolver::interiorNorm(int levelIndex, const field& values) const {
+	int width = this->levels[levelIndex].width;
+	int height = this->levels[levelIndex].height;
+	double sum = 0;
+
+	for (int y = 1; y <= height; ++y) {
+		const float* row = values.row(y) + 1;
+		for (int x = 0; x < width; ++x) {
+			sum += double(row[x]) * row[x];
+		}
+	}
+	return std::sqrt(sum);
+}
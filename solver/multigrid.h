@@ -0,0 +1,123 @@
+#pragma once
+
+#include "vector"
+#include "field.h"
+
+/**
+ * Geometric multigrid solver for the pressure equation of the projection,
+ * 4 p - (p left + p right + p up + p down) = rhs, on the interior of a field whose border ring is held at zero.
+ * Each coarser level halves both sides until the grid is a few cells wide, so one cycle costs O(N) and
+ * reduces the error by a factor that does not depend on the grid size.
+ */
+class multigridSolver {
+
+public:
+
+	enum smootherType {
+		gaussSeidel = 0,
+		redBlack = 1,
+		jacobi = 2
+	};
+
+	// the value is how many times a level recurses into the next coarser one
+	enum cycleType {
+		vCycle = 1,
+		wCycle = 2
+	};
+
+	cycleType cycle = vCycle;
+	smootherType smoother = gaussSeidel;
+	int preSmoothing = 2;
+	int postSmoothing = 2;
+	// cycles run per solve()
+	int cycles = 2;
+	// damping of the Jacobi smoother
+	float jacobiWeight = 0.8f;
+
+protected:
+
+	/**
+	 * Transfer between one axis of a level and the next coarser one. Even sizes merge pairs of cells, odd
+	 * sizes keep every other cell, so the zero boundary lands at the same place on both levels.
+	 */
+	struct axisTransfer {
+		// per fine cell up to two coarse cells it interpolates from, -1 when unused
+		std::vector<int> prolongFrom[2];
+		std::vector<float> prolongWeight[2];
+		// per coarse cell the fine cells it averages, as a range into restrictFrom / restrictWeight
+		std::vector<int> restrictStart;
+		std::vector<int> restrictFrom;
+		std::vector<float> restrictWeight;
+	};
+
+	struct level {
+		// interior size, the fields are two cells larger for the zero border ring
+		int width;
+		int height;
+		// added to the diagonal of cells next to the left/right and top/bottom boundary, the zero
+		// boundary sits closer than one cell to the edge cells of every level but the finest
+		float edgeDiagX;
+		float edgeDiagY;
+		field solution;
+		field rhs;
+		field residual;
+		// fine height x coarse width, holds the half-way result of the separable transfers
+		field transfer;
+		axisTransfer axisX;
+		axisTransfer axisY;
+	};
+
+	std::vector<level> levels;
+	alignedVector<float> rowScratch;
+	alignedVector<float> jacobiRows[2];
+	float residualNorm = 0;
+
+public:
+	multigridSolver() = default;
+
+	/**
+	 * @param width Width of the fields passed to solve(), border ring included.
+	 * @param height Height of the fields passed to solve(), border ring included.
+	 */
+	multigridSolver(int width, int height);
+
+	/**
+	 * Runs the configured number of cycles, improving solution in place. The border ring of both fields must be zero.
+	 * @param solution Initial guess and result.
+	 * @param rhs Right hand side.
+	 */
+	void solve(field& solution, const field& rhs);
+
+	/**
+	 * Relative residual |rhs - A p| / |rhs| after the last solve().
+	 */
+	float lastResidual() const;
+
+	/**
+	 * Number of levels, the finest included.
+	 */
+	int levelCount() const;
+
+private:
+
+	static int buildAxis(axisTransfer& transfer, int fineCount, float fineDistance, float& coarseDistance);
+
+	void cycleLevel(int levelIndex, field& solution, const field& rhs);
+
+	void smooth(int levelIndex, field& solution, const field& rhs, int sweeps);
+
+	float cellDiag(const level& current, int x, int y) const;
+
+	float relaxCell(const level& current, const field& solution, const field& rhs, int x, int y) const;
+
+	float jacobiCell(const level& current, const field& solution, const field& rhs, int x, int y) const;
+
+	void computeResidual(int levelIndex, const field& solution, const field& rhs, field& residual);
+
+	void restrictResidual(int levelIndex);
+
+	void prolongAndCorrect(int levelIndex, field& solution);
+
+	double interiorNorm(int levelIndex, const field& values) const;
+
+};
@@ -0,0 +1,42 @@
+#include "packedField.h"
+#include "simdKernels.h"
+#include <algorithm>
+#include <cassert>
+
+packedField::packedField(int width, int height, fieldPrecision precision, float initialValue, int border) {
+	assert(precision != float32Precision);
+	this->width = width;
+	this->height = height;
+	this->border = border;
+	this->precision = precision;
+	this->stride = (width + 2 * border + 31) & ~31;
+	this->origin = border * this->stride + border;
+	std::size_t count = static_cast<size_t>(this->stride) * (height + 2 * border);
+	this->values.assign(count + 1, packValue(initialValue, precision));
+}
+
+float packedField::get(int x, int y) const {
+	return unpackValue(this->row(y)[x], this->precision);
+}
+
+void packedField::set(int x, int y, float value) {
+	this->row(y)[x] = packValue(value, this->precision);
+}
+
+void packedField::fill(float value) {
+	std::fill(this->values.begin(), this->values.end(), packValue(value, this->precision));
+}
+
+void packedField::pack(const field& source) {
+	assert(source.getWidth() == this->width && source.getHeight() == this->height && source.getBorder() == this->border);
+	for (int y = -this->border; y < this->height + this->border; ++y) {
+		packRow(this->row(y) - this->border, source.row(y) - this->border, this->width + 2 * this->border, this->precision);
+	}
+}
+
+void packedField::unpack(field& target) const {
+	assert(target.getWidth() == this->width && target.getHeight() == this->height && target.getBorder() == this->border);
+	for (int y = -this->border; y < this->height + this->border; ++y) {
+		unpackRow(target.row(y) - this->border, this->row(y) - this->border, this->width + 2 * this->border, this->precision);
+	}
+}
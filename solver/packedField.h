@@ -0,0 +1,109 @@
+#pragma once
+
+#include "cstdint"
+#include "field.h"
+
+/**
+ * How a channel of the grid is stored. The 16 bit formats halve the memory a channel takes and the bytes every
+ * pass moves, the kernels convert to float on load and compute in float.
+ */
+enum fieldPrecision {
+	float32Precision = 0,
+	// IEEE half: 11 significant bits, values up to 65504
+	float16Precision = 1,
+	// bfloat16: the upper half of a float, 8 significant bits with the full float range
+	bfloat16Precision = 2
+};
+
+/**
+ * A field stored in one of the 16 bit formats, laid out like field: rows padded to whole cache lines
+ * (32 values) and an optional ghost ring. One value past the end is allocated, so kernels may load
+ * 32 bits at any value's position.
+ */
+class packedField {
+
+protected:
+	int width = 0;
+	int height = 0;
+	int stride = 0;
+	int border = 0;
+	int origin = 0;
+	fieldPrecision precision = float16Precision;
+	alignedVector<std::uint16_t> values;
+
+public:
+	packedField() = default;
+
+	/**
+	 * @param width Number of cells per row.
+	 * @param height Number of rows.
+	 * @param precision float16Precision or bfloat16Precision.
+	 * @param initialValue Value every cell, ghost cells included, starts with.
+	 * @param border Width of the ghost cell ring, 0 for none.
+	 */
+	packedField(int width, int height, fieldPrecision precision, float initialValue = 0, int border = 0);
+
+	int getWidth() const { return this->width; }
+	int getHeight() const { return this->height; }
+	int getStride() const { return this->stride; }
+	int getBorder() const { return this->border; }
+	fieldPrecision getPrecision() const { return this->precision; }
+
+	std::uint16_t* data() { return this->values.data() + this->origin; }
+	const std::uint16_t* data() const { return this->values.data() + this->origin; }
+
+	std::uint16_t* row(int y) { return this->values.data() + this->origin + y * this->stride; }
+	const std::uint16_t* row(int y) const { return this->values.data() + this->origin + y * this->stride; }
+
+	/**
+	 * Cell (x, y) converted to float, and set to the format's nearest value.
+	 */
+	float get(int x, int y) const;
+	void set(int x, int y, float value);
+
+	/**
+	 * Sets every cell, ghost cells included.
+	 */
+	void fill(float value);
+
+	/**
+	 * Converts every cell of source, ghost cells included, into this field. Both have the same size and border.
+	 */
+	void pack(const field& source);
+
+	/**
+	 * Converts every cell, ghost cells included, into target, which has the same size and border.
+	 */
+	void unpack(field& target) const;
+
+	/**
+	 * Bytes the cells take.
+	 */
+	std::size_t storageBytes() const { return this->values.size() * sizeof(std::uint16_t); }
+};
+
+/**
+ * Front and back buffer of a packed channel, see pingPongField.
+ */
+class packedPingPongField {
+
+protected:
+	packedField buffers[2];
+	int frontIndex = 0;
+
+public:
+	packedPingPongField() = default;
+
+	packedPingPongField(int width, int height, fieldPrecision precision, float initialValue = 0, int border = 0) {
+		this->buffers[0] = packedField(width, height, precision, initialValue, border);
+		this->buffers[1] = packedField(width, height, precision, initialValue, border);
+	}
+
+	packedField& front() { return this->buffers[this->frontIndex]; }
+	const packedField& front() const { return this->buffers[this->frontIndex]; }
+
+	packedField& back() { return this->buffers[1 - this->frontIndex]; }
+	const packedField& back() const { return this->buffers[1 - this->frontIndex]; }
+
+	void swap() { this->frontIndex = 1 - this->frontIndex; }
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "field.h"
+
+/**
+ * Front and back buffer of one channel. A stage reads the front, writes the back and then calls swap(),
+ * which only flips which buffer is the front, nothing is copied or allocated.
+ */
+class pingPongField {
+
+protected:
+	field buffers[2];
+	int frontIndex = 0;
+
+public:
+	pingPongField() = default;
+
+	/**
+	 * @param width Number of cells per row.
+	 * @param height Number of rows.
+	 * @param initialValue Value every cell of both buffers starts with.
+	 * @param border Width of the ghost cell ring of both buffers.
+	 */
+	pingPongField(int width, int height, float initialValue = 0, int border = 0) {
+		this->buffers[0] = field(width, height, initialValue, border);
+		this->buffers[1] = field(width, height, initialValue, border);
+	}
+
+	field& front() { return this->buffers[this->frontIndex]; }
+	const field& front() const { return this->buffers[this->frontIndex]; }
+
+	field& back() { return this->buffers[1 - this->frontIndex]; }
+	const field& back() const { return this->buffers[1 - this->frontIndex]; }
+
+	void swap() { this->frontIndex = 1 - this->frontIndex; }
+};
@@ -0,0 +1,836 @@
+#include "simdKernels.h"
+#include "halfConversionKernels.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SNOWLIB_SIMD_AVX2 1
+// every AVX2 processor converts halves, MSVC's /arch:AVX2 implies it, GCC and Clang need -mf16c
+#if defined(__F16C__) || defined(_MSC_VER)
+#define SNOWLIB_SIMD_F16C 1
+#endif
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SNOWLIB_SIMD_SSE2 1
+#endif
+
+const char* simdInstructionSet() {
+#if defined(SNOWLIB_SIMD_AVX2)
+	return "avx2";
+#elif defined(SNOWLIB_SIMD_SSE2)
+	return "sse2";
+#else
+	return "scalar";
+#endif
+}
+
+// builds that assume F16C convert inline and never pick the conversions at runtime
+#if !defined(SNOWLIB_SIMD_F16C)
+namespace {
+	bool processorHasF16c() {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+		int registers[4];
+		__cpuid(registers, 0);
+		if (registers[0] < 1) {
+			return false;
+		}
+		__cpuid(registers, 1);
+		bool f16c = (registers[2] & (1 << 29)) != 0;
+		bool avx = (registers[2] & (1 << 28)) != 0;
+		bool osSavesRegisters = (registers[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+		return f16c && avx && osSavesRegisters;
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+		return __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+#else
+		return false;
+#endif
+	}
+
+	bool processorHasAvx2() {
+		if (!processorHasF16c()) {
+			return false;
+		}
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+		int registers[4];
+		__cpuid(registers, 0);
+		if (registers[0] < 7) {
+			return false;
+		}
+		__cpuidex(registers, 7, 0);
+		return (registers[1] & (1 << 5)) != 0;
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+		return __builtin_cpu_supports("avx2");
+#else
+		return false;
+#endif
+	}
+
+	// the F16C conversions and the AVX2 packed advection for builds that do not assume them, picked once on first use
+	struct halfConversionChoice {
+		halfConversionKernels kernels;
+		advectPackedKernel advect = nullptr;
+		const char* name = nullptr;
+
+		halfConversionChoice() {
+			const char* forced = std::getenv("SNOWLIB_HALF");
+			if (forced != nullptr && std::strcmp(forced, "generic") == 0) {
+				return;
+			}
+			halfConversionKernels f16c = f16cHalfConversionKernels();
+			if (f16c.toHalf != nullptr && processorHasF16c()) {
+				this->kernels = f16c;
+				this->name = "f16c";
+				if (processorHasAvx2()) {
+					this->advect = avx2AdvectPackedKernel();
+				}
+			}
+		}
+	};
+
+	const halfConversionChoice& chosenHalfConversion() {
+		static const halfConversionChoice choice;
+		return choice;
+	}
+}
+#endif
+
+const char* halfConversionInstructionSet() {
+#if defined(SNOWLIB_SIMD_F16C)
+	return "f16c";
+#else
+	const char* chosen = chosenHalfConversion().name;
+	return chosen != nullptr ? chosen : simdInstructionSet();
+#endif
+}
+
+void gaussSeidelRow(float* cur, const float* next, const float* base, const float* up, const float* down, float* partial, int count, float k, float invDiag) {
+	int x = 0;
+
+	// everything but the left neighbour is already known, so gather it for the whole row at once and
+	// leave a single multiply-add per cell for the serial part
+#if defined(SNOWLIB_SIMD_AVX2)
+	__m256 kv = _mm256_set1_ps(k);
+	__m256 invV = _mm256_set1_ps(invDiag);
+	for (; x + 8 <= count; x += 8) {
+		__m256 sum = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(up + x), _mm256_loadu_ps(down + x)), _mm256_loadu_ps(next + x));
+		_mm256_storeu_ps(partial + x, _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(base + x), _mm256_mul_ps(kv, sum)), invV));
+	}
+#elif defined(SNOWLIB_SIMD_SSE2)
+	__m128 kv = _mm_set1_ps(k);
+	__m128 invV = _mm_set1_ps(invDiag);
+	for (; x + 4 <= count; x += 4) {
+		__m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(up + x), _mm_loadu_ps(down + x)), _mm_loadu_ps(next + x));
+		_mm_storeu_ps(partial + x, _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(base + x), _mm_mul_ps(kv, sum)), invV));
+	}
+#endif
+	for (; x < count; ++x) {
+		partial[x] = (base[x] + k * (up[x] + down[x] + next[x])) * invDiag;
+	}
+
+	float leftWeight = k * invDiag;
+	float left = cur[-1];
+	for (x = 0; x < count; ++x) {
+		left = partial[x] + leftWeight * left;
+		cur[x] = left;
+	}
+}
+
+void divergenceRow(float* div, const float* u, const float* vUp, const float* vDown, int count, float scale) {
+	int x = 0;
+#if defined(SNOWLIB_SIMD_AVX2)
+	__m256 sv = _mm256_set1_ps(scale);
+	for (; x + 8 <= count; x += 8) {
+		__m256 dx = _mm256_sub_ps(_mm256_loadu_ps(u + x + 1), _mm256_loadu_ps(u + x - 1));
+		__m256 dy = _mm256_sub_ps(_mm256_loadu_ps(vDown + x), _mm256_loadu_ps(vUp + x));
+		_mm256_storeu_ps(div + x, _mm256_mul_ps(sv, _mm256_add_ps(dx, dy)));
+	}
+#elif defined(SNOWLIB_SIMD_SSE2)
+	__m128 sv = _mm_set1_ps(scale);
+	for (; x + 4 <= count; x += 4) {
+		__m128 dx = _mm_sub_ps(_mm_loadu_ps(u + x + 1), _mm_loadu_ps(u + x - 1));
+		__m128 dy = _mm_sub_ps(_mm_loadu_ps(vDown + x), _mm_loadu_ps(vUp + x));
+		_mm_storeu_ps(div + x, _mm_mul_ps(sv, _mm_add_ps(dx, dy)));
+	}
+#endif
+	for (; x < count; ++x) {
+		div[x] = scale * (u[x + 1] - u[x - 1] + vDown[x] - vUp[x]);
+	}
+}
+
+void subtractGradientRow(float* u, float* v, const float* p, const float* pUp, const float* pDown, int count, float scale) {
+	int x = 0;
+#if defined(SNOWLIB_SIMD_AVX2)
+	__m256 sv = _mm256_set1_ps(scale);
+	for (; x + 8 <= count; x += 8) {
+		__m256 gx = _mm256_sub_ps(_mm256_loadu_ps(p + x + 1), _mm256_loadu_ps(p + x - 1));
+		__m256 gy = _mm256_sub_ps(_mm256_loadu_ps(pDown + x), _mm256_loadu_ps(pUp + x));
+		_mm256_storeu_ps(u + x, _mm256_sub_ps(_mm256_loadu_ps(u + x), _mm256_mul_ps(sv, gx)));
+		_mm256_storeu_ps(v + x, _mm256_sub_ps(_mm256_loadu_ps(v + x), _mm256_mul_ps(sv, gy)));
+	}
+#elif defined(SNOWLIB_SIMD_SSE2)
+	__m128 sv = _mm_set1_ps(scale);
+	for (; x + 4 <= count; x += 4) {
+		__m128 gx = _mm_sub_ps(_mm_loadu_ps(p + x + 1), _mm_loadu_ps(p + x - 1));
+		__m128 gy = _mm_sub_ps(_mm_loadu_ps(pDown + x), _mm_loadu_ps(pUp + x));
+		_mm_storeu_ps(u + x, _mm_sub_ps(_mm_loadu_ps(u + x), _mm_mul_ps(sv, gx)));
+		_mm_storeu_ps(v + x, _mm_sub_ps(_mm_loadu_ps(v + x), _mm_mul_ps(sv, gy)));
+	}
+#endif
+	for (; x < count; ++x) {
+		u[x] -= scale * (p[x + 1] - p[x - 1]);
+		v[x] -= scale * (pDown[x] - pUp[x]);
+	}
+}
+
+void advectRow(float* const* out, const float* const* source, int channelCount, const float* velocityX, const float* velocityY, int y, int from, int to,
+	int width, int height, int stride, float deltaTime, float energyLost, bool periodic) {
+	int x = from;
+	int rowStart = y * stride;
+#if defined(SNOWLIB_SIMD_AVX2)
+	const __m256 dt = _mm256_set1_ps(deltaTime);
+	const __m256 energy = _mm256_set1_ps(energyLost);
+	const __m256 minusOne = _mm256_set1_ps(-1.0f);
+	const __m256 sizeX = _mm256_set1_ps(float(width));
+	const __m256 sizeY = _mm256_set1_ps(float(height));
+	const __m256 invSizeX = _mm256_set1_ps(1.0f / width);
+	const __m256 invSizeY = _mm256_set1_ps(1.0f / height);
+	const __m256 rowY = _mm256_set1_ps(float(y));
+	const __m256i strideV = _mm256_set1_epi32(stride);
+	const __m256i oneI = _mm256_set1_epi32(1);
+	__m256 xs = _mm256_add_ps(_mm256_set1_ps(float(from)), _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7));
+	const __m256 eight = _mm256_set1_ps(8.0f);
+
+	for (; x + 8 <= to; x += 8, xs = _mm256_add_ps(xs, eight)) {
+		__m256 xBacktrace = _mm256_sub_ps(xs, _mm256_mul_ps(_mm256_loadu_ps(velocityX + x), dt));
+		__m256 yBacktrace = _mm256_sub_ps(rowY, _mm256_mul_ps(_mm256_loadu_ps(velocityY + x), dt));
+		if (periodic) {
+			xBacktrace = _mm256_sub_ps(xBacktrace, _mm256_mul_ps(sizeX, _mm256_floor_ps(_mm256_mul_ps(xBacktrace, invSizeX))));
+			yBacktrace = _mm256_sub_ps(yBacktrace, _mm256_mul_ps(sizeY, _mm256_floor_ps(_mm256_mul_ps(yBacktrace, invSizeY))));
+		}
+		__m256 xFloor = _mm256_floor_ps(xBacktrace);
+		__m256 yFloor = _mm256_floor_ps(yBacktrace);
+
+		// same window as the scalar path
+		__m256 valid = _mm256_and_ps(
+			_mm256_and_ps(_mm256_cmp_ps(xBacktrace, minusOne, _CMP_GE_OQ), _mm256_cmp_ps(xBacktrace, sizeX, _CMP_LT_OQ)),
+			_mm256_and_ps(_mm256_cmp_ps(yBacktrace, minusOne, _CMP_GE_OQ), _mm256_cmp_ps(yBacktrace, sizeY, _CMP_LT_OQ)));
+
+		if (_mm256_movemask_ps(valid) == 0) {
+			for (int c = 0; c < channelCount; ++c) {
+				_mm256_storeu_ps(out[c] + rowStart + x, _mm256_loadu_ps(source[c] + rowStart + x));
+			}
+			continue;
+		}
+
+		// the backtrace, corner indices and weights are shared by every channel
+		__m256i index = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_cvttps_epi32(yFloor), strideV), _mm256_cvttps_epi32(xFloor));
+		index = _mm256_and_si256(index, _mm256_castps_si256(valid));
+		__m256i indexX = _mm256_add_epi32(index, oneI);
+		__m256i indexY = _mm256_add_epi32(index, strideV);
+		__m256i indexXY = _mm256_add_epi32(indexY, oneI);
+		__m256 relPosx = _mm256_sub_ps(xBacktrace, xFloor);
+		__m256 relPosy = _mm256_sub_ps(yBacktrace, yFloor);
+
+		for (int c = 0; c < channelCount; ++c) {
+			const float* channel = source[c];
+			__m256 d = _mm256_i32gather_ps(channel, index, 4);
+			__m256 dx = _mm256_i32gather_ps(channel, indexX, 4);
+			__m256 dy = _mm256_i32gather_ps(channel, indexY, 4);
+			__m256 dxy = _mm256_i32gather_ps(channel, indexXY, 4);
+
+			__m256 lerp1Val = _mm256_add_ps(d, _mm256_mul_ps(relPosx, _mm256_sub_ps(dx, d)));
+			__m256 lerp2Val = _mm256_add_ps(dy, _mm256_mul_ps(relPosx, _mm256_sub_ps(dxy, dy)));
+			__m256 lerp3Val = _mm256_add_ps(lerp1Val, _mm256_mul_ps(relPosy, _mm256_sub_ps(lerp2Val, lerp1Val)));
+
+			__m256 oldValues = _mm256_loadu_ps(channel + rowStart + x);
+			_mm256_storeu_ps(out[c] + rowStart + x, _mm256_blendv_ps(oldValues, _mm256_mul_ps(lerp3Val, energy), valid));
+		}
+	}
+#endif
+	for (; x < to; ++x) {
+		float xBacktrace = x - velocityX[x] * deltaTime;
+		float yBacktrace = y - velocityY[x] * deltaTime;
+		if (periodic) {
+			xBacktrace -= width * std::floor(xBacktrace * (1.0f / width));
+			yBacktrace -= height * std::floor(yBacktrace * (1.0f / height));
+		}
+
+		// the four corners must lie within the cells and their ghost ring, checked on the float so huge or NaN
+		// backtraces never reach the int cast
+		if (!(xBacktrace >= -1 && xBacktrace < width && yBacktrace >= -1 && yBacktrace < height)) {
+			for (int c = 0; c < channelCount; ++c) {
+				out[c][rowStart + x] = source[c][rowStart + x];
+			}
+			continue;
+		}
+
+		// the cast truncates towards zero, step back for the backtraces between -1 and 0
+		int xNewPosfloor = int(xBacktrace);
+		int yNewPosfloor = int(yBacktrace);
+		xNewPosfloor -= xNewPosfloor > xBacktrace;
+		yNewPosfloor -= yNewPosfloor > yBacktrace;
+		int corner = yNewPosfloor * stride + xNewPosfloor;
+
+		float relPosx = xBacktrace - xNewPosfloor;
+		float relPosy = yBacktrace - yNewPosfloor;
+
+		for (int c = 0; c < channelCount; ++c) {
+			const float* channel = source[c] + corner;
+			float lerp1Val = channel[0] + relPosx * (channel[1] - channel[0]);
+			float lerp2Val = channel[stride] + relPosx * (channel[stride + 1] - channel[stride]);
+			out[c][rowStart + x] = (lerp1Val + relPosy * (lerp2Val - lerp1Val)) * energyLost;
+		}
+	}
+}
+
+void residualRow(float* r, const float* cur, const float* base, const float* up, const float* down, int count, float diag, float k) {
+	int x = 0;
+#if defined(SNOWLIB_SIMD_AVX2)
+	__m256 diagV = _mm256_set1_ps(diag);
+	__m256 kv = _mm256_set1_ps(k);
+	for (; x + 8 <= count; x += 8) {
+		__m256 sum = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(cur + x - 1), _mm256_loadu_ps(cur + x + 1)),
+			_mm256_add_ps(_mm256_loadu_ps(up + x), _mm256_loadu_ps(down + x)));
+		__m256 applied = _mm256_sub_ps(_mm256_mul_ps(diagV, _mm256_loadu_ps(cur + x)), _mm256_mul_ps(kv, sum));
+		_mm256_storeu_ps(r + x, _mm256_sub_ps(_mm256_loadu_ps(base + x), applied));
+	}
+#elif defined(SNOWLIB_SIMD_SSE2)
+	__m128 diagV = _mm_set1_ps(diag);
+	__m128 kv = _mm_set1_ps(k);
+	for (; x + 4 <= count; x += 4) {
+		__m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(cur + x - 1), _mm_loadu_ps(cur + x + 1)),
+			_mm_add_ps(_mm_loadu_ps(up + x), _mm_loadu_ps(down + x)));
+		__m128 applied = _mm_sub_ps(_mm_mul_ps(diagV, _mm_loadu_ps(cur + x)), _mm_mul_ps(kv, sum));
+		_mm_storeu_ps(r + x, _mm_sub_ps(_mm_loadu_ps(base + x), applied));
+	}
+#endif
+	for (; x < count; ++x) {
+		r[x] = base[x] - (diag * cur[x] - k * (cur[x - 1] + cur[x + 1] + up[x] + down[x]));
+	}
+}
+
+void jacobiRow(float* out, const float* cur, const float* base, const float* up, const float* down, int count, float k, float invDiag, float weight) {
+	int x = 0;
+	float keep = 1 - weight;
+	float scale = weight * invDiag;
+#if defined(SNOWLIB_SIMD_AVX2)
+	__m256 kv = _mm256_set1_ps(k);
+	__m256 keepV = _mm256_set1_ps(keep);
+	__m256 scaleV = _mm256_set1_ps(scale);
+	for (; x + 8 <= count; x += 8) {
+		__m256 sum = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(cur + x - 1), _mm256_loadu_ps(cur + x + 1)),
+			_mm256_add_ps(_mm256_loadu_ps(up + x), _mm256_loadu_ps(down + x)));
+		__m256 relaxed = _mm256_mul_ps(scaleV, _mm256_add_ps(_mm256_loadu_ps(base + x), _mm256_mul_ps(kv, sum)));
+		_mm256_storeu_ps(out + x, _mm256_add_ps(_mm256_mul_ps(keepV, _mm256_loadu_ps(cur + x)), relaxed));
+	}
+#elif defined(SNOWLIB_SIMD_SSE2)
+	__m128 kv = _mm_set1_ps(k);
+	__m128 keepV = _mm_set1_ps(keep);
+	__m128 scaleV = _mm_set1_ps(scale);
+	for (; x + 4 <= count; x += 4) {
+		__m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(cur + x - 1), _mm_loadu_ps(cur + x + 1)),
+			_mm_add_ps(_mm_loadu_ps(up + x), _mm_loadu_ps(down + x)));
+		__m128 relaxed = _mm_mul_ps(scaleV, _mm_add_ps(_mm_loadu_ps(base + x), _mm_mul_ps(kv, sum)));
+		_mm_storeu_ps(out + x, _mm_add_ps(_mm_mul_ps(keepV, _mm_loadu_ps(cur + x)), relaxed));
+	}
+#endif
+	for (; x < count; ++x) {
+		out[x] = keep * cur[x] + scale * (base[x] + k * (cur[x - 1] + cur[x + 1] + up[x] + down[x]));
+	}
+}
+
+void redBlackRow(float* cur, const float* base, const float* up, const float* down, int count, int parity, float k, float invDiag, bool neighboursShared) {
+	// a chunk of cells is relaxed into a local buffer from the unchanged row, then only the cells of the colour
+	// are stored, so the vector loads never overlap stores just made
+	const int chunk = 256;
+	alignas(32) float relaxed[chunk];
+	alignas(32) float upCells[chunk];
+	alignas(32) float downCells[chunk];
+
+	for (int start = 0; start < count; start += chunk) {
+		int cells = count - start < chunk ? count - start : chunk;
+		const float* upChunk = up + start;
+		const float* downChunk = down + start;
+
+		// only the other colour of shared rows is copied out, the lanes that would read their colour cells are
+		// thrown away anyway. Going through the same arithmetic keeps the result independent of the sharing
+		if (neighboursShared) {
+			for (int x = 0; x < cells; ++x) {
+				upCells[x] = 0;
+				downCells[x] = 0;
+			}
+			for (int x = parity; x < cells; x += 2) {
+				upCells[x] = upChunk[x];
+				downCells[x] = downChunk[x];
+			}
+			upChunk = upCells;
+			downChunk = downCells;
+		}
+
+		jacobiRow(relaxed, cur + start, base + start, upChunk, downChunk, cells, k, invDiag, 1.0f);
+		for (int x = parity; x < cells; x += 2) {
+			cur[start + x] = relaxed[x];
+		}
+	}
+}
+
+void stencilRow(float* out, const float* cur, const float* up, const float* down, int count, float diag, float k) {
+	int x = 0;
+#if defined(SNOWLIB_SIMD_AVX2)
+	__m256 diagV = _mm256_set1_ps(diag);
+	__m256 kv = _mm256_set1_ps(k);
+	for (; x + 8 <= count; x += 8) {
+		__m256 sum = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(cur + x - 1), _mm256_loadu_ps(cur + x + 1)),
+			_mm256_add_ps(_mm256_loadu_ps(up + x), _mm256_loadu_ps(down + x)));
+		_mm256_storeu_ps(out + x, _mm256_sub_ps(_mm256_mul_ps(diagV, _mm256_loadu_ps(cur + x)), _mm256_mul_ps(kv, sum)));
+	}
+#elif defined(SNOWLIB_SIMD_SSE2)
+	__m128 diagV = _mm_set1_ps(diag);
+	__m128 kv = _mm_set1_ps(k);
+	for (; x + 4 <= count; x += 4) {
+		__m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(cur + x - 1), _mm_loadu_ps(cur + x + 1)),
+			_mm_add_ps(_mm_loadu_ps(up + x), _mm_loadu_ps(down + x)));
+		_mm_storeu_ps(out + x, _mm_sub_ps(_mm_mul_ps(diagV, _mm_loadu_ps(cur + x)), _mm_mul_ps(kv, sum)));
+	}
+#endif
+	for (; x < count; ++x) {
+		out[x] = diag * cur[x] - k * (cur[x - 1] + cur[x + 1] + up[x] + down[x]);
+	}
+}
+
+double dotRow(const float* a, const float* b, int count) {
+	int x = 0;
+	double sum = 0;
+#if defined(SNOWLIB_SIMD_AVX2)
+	__m256 lanes = _mm256_setzero_ps();
+	for (; x + 8 <= count; x += 8) {
+		lanes = _mm256_add_ps(lanes, _mm256_mul_ps(_mm256_loadu_ps(a + x), _mm256_loadu_ps(b + x)));
+	}
+	float laneValues[8];
+	_mm256_storeu_ps(laneValues, lanes);
+	for (int lane = 0; lane < 8; ++lane) {
+		sum += laneValues[lane];
+	}
+#elif defined(SNOWLIB_SIMD_SSE2)
+	__m128 lanes = _mm_setzero_ps();
+	for (; x + 4 <= count; x += 4) {
+		lanes = _mm_add_ps(lanes, _mm_mul_ps(_mm_loadu_ps(a + x), _mm_loadu_ps(b + x)));
+	}
+	float laneValues[4];
+	_mm_storeu_ps(laneValues, lanes);
+	for (int lane = 0; lane < 4; ++lane) {
+		sum += laneValues[lane];
+	}
+#endif
+	for (; x < count; ++x) {
+		sum += double(a[x]) * b[x];
+	}
+	return sum;
+}
+
+void lookupRow(std::uint32_t* out, const float* values, int count, const std::uint32_t* table, int last, float scale, float bias) {
+	int x = 0;
+#if defined(SNOWLIB_SIMD_AVX2)
+	__m256 scaleV = _mm256_set1_ps(scale);
+	__m256 biasV = _mm256_set1_ps(bias);
+	__m256 zero = _mm256_setzero_ps();
+	__m256 lastV = _mm256_set1_ps(float(last));
+	for (; x + 8 <= count; x += 8) {
+		__m256 position = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(values + x), scaleV), biasV);
+		// max returns its second operand for NaN, so NaN lands on entry 0 like in the scalar loop
+		position = _mm256_min_ps(_mm256_max_ps(position, zero), lastV);
+		__m256i index = _mm256_cvttps_epi32(position);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x), _mm256_i32gather_epi32(reinterpret_cast<const int*>(table), index, 4));
+	}
+#endif
+	for (; x < count; ++x) {
+		float position = values[x] * scale + bias;
+		int index = position > 0 ? (position < last ? int(position) : last) : 0;
+		out[x] = table[index];
+	}
+}
+
+namespace {
+	std::uint16_t floatToHalf(float value) {
+		std::uint32_t bits;
+		std::memcpy(&bits, &value, 4);
+		std::uint32_t sign = (bits >> 16) & 0x8000u;
+		bits &= 0x7fffffffu;
+
+		// infinity and NaN, or finite values that round past the largest half
+		if (bits >= 0x47800000u) {
+			return std::uint16_t(sign | (bits > 0x7f800000u ? 0x7e00u : 0x7c00u));
+		}
+		// below the smallest normal half the float addition shifts the mantissa into place and rounds it
+		if (bits < 0x38800000u) {
+			const std::uint32_t magicBits = 0x3f000000u;
+			float magic;
+			std::memcpy(&magic, &magicBits, 4);
+			float shifted;
+			std::memcpy(&shifted, &bits, 4);
+			shifted += magic;
+			std::uint32_t rounded;
+			std::memcpy(&rounded, &shifted, 4);
+			return std::uint16_t(sign | (rounded - magicBits));
+		}
+		// rebias the exponent and round the 13 dropped mantissa bits to nearest even
+		std::uint32_t odd = (bits >> 13) & 1u;
+		bits += 0xc8000fffu + odd;
+		return std::uint16_t(sign | (bits >> 13));
+	}
+
+#if defined(SNOWLIB_SIMD_SSE2)
+	// floatToHalf of four lanes, the half in the low 16 bits sign-extended so a signed pack keeps it
+	inline __m128i floatToHalfBits4(__m128 values) {
+		__m128i bits = _mm_castps_si128(values);
+		__m128i sign = _mm_and_si128(_mm_srli_epi32(bits, 16), _mm_set1_epi32(0x8000));
+		bits = _mm_and_si128(bits, _mm_set1_epi32(0x7fffffff));
+
+		__m128i odd = _mm_and_si128(_mm_srli_epi32(bits, 13), _mm_set1_epi32(1));
+		__m128i normal = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(bits, _mm_set1_epi32(int(0xc8000fffu))), odd), 13);
+		const __m128i magicBits = _mm_set1_epi32(0x3f000000);
+		__m128i subnormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(bits), _mm_castsi128_ps(magicBits))), magicBits);
+		__m128i nan = _mm_cmpgt_epi32(bits, _mm_set1_epi32(0x7f800000));
+		__m128i special = _mm_or_si128(_mm_set1_epi32(0x7c00), _mm_and_si128(nan, _mm_set1_epi32(0x0200)));
+
+		__m128i small = _mm_cmplt_epi32(bits, _mm_set1_epi32(0x38800000));
+		__m128i large = _mm_cmpgt_epi32(bits, _mm_set1_epi32(0x477fffff));
+		__m128i result = _mm_or_si128(_mm_and_si128(small, subnormal), _mm_andnot_si128(small, normal));
+		result = _mm_or_si128(_mm_and_si128(large, special), _mm_andnot_si128(large, result));
+		result = _mm_or_si128(result, sign);
+		return _mm_srai_epi32(_mm_slli_epi32(result, 16), 16);
+	}
+#endif
+}
+
+void floatToHalfRow(std::uint16_t* out, const float* values, int count) {
+	int x = 0;
+#if defined(SNOWLIB_SIMD_F16C)
+	for (; x + 8 <= count; x += 8) {
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm256_cvtps_ph(_mm256_loadu_ps(values + x), _MM_FROUND_TO_NEAREST_INT));
+	}
+#else
+	// builds that do not assume F16C still use it where the processor has it
+	floatToHalfKernel f16c = chosenHalfConversion().kernels.toHalf;
+	if (f16c != nullptr) {
+		x = f16c(out, values, count);
+	}
+#if defined(SNOWLIB_SIMD_SSE2)
+	for (; x + 8 <= count; x += 8) {
+		__m128i low = floatToHalfBits4(_mm_loadu_ps(values + x));
+		__m128i high = floatToHalfBits4(_mm_loadu_ps(values + x + 4));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm_packs_epi32(low, high));
+	}
+#endif
+#endif
+	for (; x < count; ++x) {
+		out[x] = floatToHalf(values[x]);
+	}
+}
+
+namespace {
+	float halfToFloat(std::uint16_t value) {
+		// mantissa shifted into place and the exponent rebiased, which is the result for normal halves
+		std::uint32_t shifted = std::uint32_t(value & 0x7fffu) << 13;
+		std::uint32_t exponent = shifted & 0x0f800000u;
+		std::uint32_t bits = shifted + 0x38000000u;
+		float result;
+		if (exponent == 0x0f800000u) {
+			// infinity and NaN keep their mantissa under the largest exponent
+			bits += 0x38000000u;
+			std::memcpy(&result, &bits, 4);
+		}
+		else if (exponent == 0) {
+			// subnormal halves: give the mantissa the implicit one of 2^-14 and subtract it again, all in
+			// normal floats, where multiplying a float subnormal would take a slow microcode assist
+			bits += 0x00800000u;
+			std::memcpy(&result, &bits, 4);
+			result -= 0x1p-14f;
+		}
+		else {
+			std::memcpy(&result, &bits, 4);
+		}
+		return (value & 0x8000u) ? -result : result;
+	}
+
+	std::uint16_t floatToBfloat16(float value) {
+		std::uint32_t bits;
+		std::memcpy(&bits, &value, 4);
+		// NaNs stay quiet NaNs instead of rounding into infinity
+		if ((bits & 0x7fffffffu) > 0x7f800000u) {
+			return std::uint16_t((bits >> 16) | 0x40u);
+		}
+		return std::uint16_t((bits + 0x7fffu + ((bits >> 16) & 1u)) >> 16);
+	}
+
+	float bfloat16ToFloat(std::uint16_t value) {
+		std::uint32_t bits = std::uint32_t(value) << 16;
+		float result;
+		std::memcpy(&result, &bits, 4);
+		return result;
+	}
+
+#if defined(SNOWLIB_SIMD_SSE2)
+	// the low 16 bits of every lane, a half, to float, the vector form of halfToFloat
+	inline __m128 halfBitsToFloat4(__m128i halves) {
+		const __m128i exponentMask = _mm_set1_epi32(0x0f800000);
+		__m128i shifted = _mm_slli_epi32(_mm_and_si128(halves, _mm_set1_epi32(0x7fff)), 13);
+		__m128i exponent = _mm_and_si128(shifted, exponentMask);
+		__m128i bits = _mm_add_epi32(shifted, _mm_set1_epi32(0x38000000));
+		__m128i special = _mm_cmpeq_epi32(exponent, exponentMask);
+		bits = _mm_add_epi32(bits, _mm_and_si128(special, _mm_set1_epi32(0x38000000)));
+		__m128i subnormal = _mm_cmpeq_epi32(exponent, _mm_setzero_si128());
+		__m128i adjusted = _mm_castps_si128(_mm_sub_ps(_mm_castsi128_ps(_mm_add_epi32(bits, _mm_set1_epi32(0x00800000))), _mm_set1_ps(0x1p-14f)));
+		bits = _mm_or_si128(_mm_and_si128(subnormal, adjusted), _mm_andnot_si128(subnormal, bits));
+		bits = _mm_or_si128(bits, _mm_slli_epi32(_mm_and_si128(halves, _mm_set1_epi32(0x8000)), 16));
+		return _mm_castsi128_ps(bits);
+	}
+#endif
+
+#if defined(SNOWLIB_SIMD_AVX2)
+	// float to bfloat16 in the low 16 bits of every lane, sign-extended so a signed pack keeps them
+	inline __m256i floatToBfloat16Bits8(__m256 values) {
+		__m256i bits = _mm256_castps_si256(values);
+		__m256i rounded = _mm256_add_epi32(_mm256_add_epi32(bits, _mm256_set1_epi32(0x7fff)), _mm256_and_si256(_mm256_srli_epi32(bits, 16), _mm256_set1_epi32(1)));
+		__m256i nan = _mm256_castps_si256(_mm256_cmp_ps(values, values, _CMP_UNORD_Q));
+		rounded = _mm256_blendv_epi8(rounded, _mm256_or_si256(bits, _mm256_set1_epi32(0x00400000)), nan);
+		return _mm256_srai_epi32(rounded, 16);
+	}
+#endif
+
+	// cells the packed kernels convert at once, a few float buffers of this size stay in L1
+	constexpr int packedChunk = 256;
+}
+
+void halfToFloatRow(float* out, const std::uint16_t* values, int count) {
+	int x = 0;
+#if defined(SNOWLIB_SIMD_F16C)
+	for (; x + 8 <= count; x += 8) {
+		_mm256_storeu_ps(out + x, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(values + x))));
+	}
+#else
+	halfToFloatKernel f16c = chosenHalfConversion().kernels.toFloat;
+	if (f16c != nullptr) {
+		x = f16c(out, values, count);
+	}
+#if defined(SNOWLIB_SIMD_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	for (; x + 8 <= count; x += 8) {
+		__m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + x));
+		_mm_storeu_ps(out + x, halfBitsToFloat4(_mm_unpacklo_epi16(packed, zero)));
+		_mm_storeu_ps(out + x + 4, halfBitsToFloat4(_mm_unpackhi_epi16(packed, zero)));
+	}
+#endif
+#endif
+	for (; x < count; ++x) {
+		out[x] = halfToFloat(values[x]);
+	}
+}
+
+void floatToBfloat16Row(std::uint16_t* out, const float* values, int count) {
+	int x = 0;
+#if defined(SNOWLIB_SIMD_AVX2)
+	for (; x + 8 <= count; x += 8) {
+		__m256i bits = floatToBfloat16Bits8(_mm256_loadu_ps(values + x));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm_packs_epi32(_mm256_castsi256_si128(bits), _mm256_extracti128_si256(bits, 1)));
+	}
+#elif defined(SNOWLIB_SIMD_SSE2)
+	const __m128i roundBias = _mm_set1_epi32(0x7fff);
+	const __m128i one = _mm_set1_epi32(1);
+	const __m128i quiet = _mm_set1_epi32(0x00400000);
+	for (; x + 4 <= count; x += 4) {
+		__m128 value = _mm_loadu_ps(values + x);
+		__m128i bits = _mm_castps_si128(value);
+		__m128i rounded = _mm_add_epi32(_mm_add_epi32(bits, roundBias), _mm_and_si128(_mm_srli_epi32(bits, 16), one));
+		__m128i nan = _mm_castps_si128(_mm_cmpunord_ps(value, value));
+		rounded = _mm_or_si128(_mm_andnot_si128(nan, rounded), _mm_and_si128(nan, _mm_or_si128(bits, quiet)));
+		// sign-extended, so the signed pack keeps all 16 bits
+		rounded = _mm_srai_epi32(rounded, 16);
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(out + x), _mm_packs_epi32(rounded, rounded));
+	}
+#endif
+	for (; x < count; ++x) {
+		out[x] = floatToBfloat16(values[x]);
+	}
+}
+
+void bfloat16ToFloatRow(float* out, const std::uint16_t* values, int count) {
+	int x = 0;
+#if defined(SNOWLIB_SIMD_AVX2)
+	for (; x + 8 <= count; x += 8) {
+		__m256i widened = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(values + x)));
+		_mm256_storeu_ps(out + x, _mm256_castsi256_ps(_mm256_slli_epi32(widened, 16)));
+	}
+#elif defined(SNOWLIB_SIMD_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	for (; x + 8 <= count; x += 8) {
+		__m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + x));
+		// interleaving zeros below every value shifts it into the upper half of a float
+		_mm_storeu_ps(out + x, _mm_castsi128_ps(_mm_unpacklo_epi16(zero, packed)));
+		_mm_storeu_ps(out + x + 4, _mm_castsi128_ps(_mm_unpackhi_epi16(zero, packed)));
+	}
+#endif
+	for (; x < count; ++x) {
+		out[x] = bfloat16ToFloat(values[x]);
+	}
+}
+
+std::uint16_t packValue(float value, fieldPrecision precision) {
+	return precision == bfloat16Precision ? floatToBfloat16(value) : floatToHalf(value);
+}
+
+float unpackValue(std::uint16_t value, fieldPrecision precision) {
+	return precision == bfloat16Precision ? bfloat16ToFloat(value) : halfToFloat(value);
+}
+
+void packRow(std::uint16_t* out, const float* values, int count, fieldPrecision precision) {
+	if (precision == bfloat16Precision) {
+		floatToBfloat16Row(out, values, count);
+	}
+	else {
+		floatToHalfRow(out, values, count);
+	}
+}
+
+void unpackRow(float* out, const std::uint16_t* values, int count, fieldPrecision precision) {
+	if (precision == bfloat16Precision) {
+		bfloat16ToFloatRow(out, values, count);
+	}
+	else {
+		halfToFloatRow(out, values, count);
+	}
+}
+
+void divergencePackedRow(float* div, const std::uint16_t* u, const std::uint16_t* vUp, const std::uint16_t* vDown, int count, float scale, fieldPrecision precision) {
+	alignas(32) float uCells[packedChunk + 2];
+	alignas(32) float upCells[packedChunk];
+	alignas(32) float downCells[packedChunk];
+	for (int start = 0; start < count; start += packedChunk) {
+		int cells = count - start < packedChunk ? count - start : packedChunk;
+		unpackRow(uCells, u + start - 1, cells + 2, precision);
+		unpackRow(upCells, vUp + start, cells, precision);
+		unpackRow(downCells, vDown + start, cells, precision);
+		divergenceRow(div + start, uCells + 1, upCells, downCells, cells, scale);
+	}
+}
+
+void subtractGradientPackedRow(std::uint16_t* u, std::uint16_t* v, const float* p, const float* pUp, const float* pDown, int count, float scale, fieldPrecision precision) {
+	alignas(32) float uCells[packedChunk];
+	alignas(32) float vCells[packedChunk];
+	for (int start = 0; start < count; start += packedChunk) {
+		int cells = count - start < packedChunk ? count - start : packedChunk;
+		unpackRow(uCells, u + start, cells, precision);
+		unpackRow(vCells, v + start, cells, precision);
+		subtractGradientRow(uCells, vCells, p + start, pUp + start, pDown + start, cells, scale);
+		packRow(u + start, uCells, cells, precision);
+		packRow(v + start, vCells, cells, precision);
+	}
+}
+
+void advectPackedRow(std::uint16_t* const* out, const std::uint16_t* const* source, int channelCount, const std::uint16_t* velocityX, const std::uint16_t* velocityY,
+	int y, int width, int height, int stride, float deltaTime, float energyLost, bool periodic, fieldPrecision precision) {
+	int x = 0;
+	int rowStart = y * stride;
+	// the vector loop lives with the kernels built for AVX2 whatever the baseline
+#if defined(SNOWLIB_SIMD_AVX2)
+	x = avx2AdvectPackedKernel()(out, source, channelCount, velocityX, velocityY, y, width, height, stride, deltaTime, energyLost, periodic, precision);
+#else
+	// builds without AVX2 still use it where the processor has it
+	advectPackedKernel avx2 = chosenHalfConversion().advect;
+	if (avx2 != nullptr) {
+		x = avx2(out, source, channelCount, velocityX, velocityY, y, width, height, stride, deltaTime, energyLost, periodic, precision);
+	}
+#endif
+	for (; x < width; ++x) {
+		float xBacktrace = x - unpackValue(velocityX[x], precision) * deltaTime;
+		float yBacktrace = y - unpackValue(velocityY[x], precision) * deltaTime;
+		if (periodic) {
+			xBacktrace -= width * std::floor(xBacktrace * (1.0f / width));
+			yBacktrace -= height * std::floor(yBacktrace * (1.0f / height));
+		}
+
+		if (!(xBacktrace >= -1 && xBacktrace < width && yBacktrace >= -1 && yBacktrace < height)) {
+			for (int c = 0; c < channelCount; ++c) {
+				out[c][rowStart + x] = source[c][rowStart + x];
+			}
+			continue;
+		}
+
+		int xNewPosfloor = int(xBacktrace);
+		int yNewPosfloor = int(yBacktrace);
+		xNewPosfloor -= xNewPosfloor > xBacktrace;
+		yNewPosfloor -= yNewPosfloor > yBacktrace;
+		int corner = yNewPosfloor * stride + xNewPosfloor;
+
+		float relPosx = xBacktrace - xNewPosfloor;
+		float relPosy = yBacktrace - yNewPosfloor;
+
+		for (int c = 0; c < channelCount; ++c) {
+			const std::uint16_t* channel = source[c] + corner;
+			float d = unpackValue(channel[0], precision);
+			float dx = unpackValue(channel[1], precision);
+			float dy = unpackValue(channel[stride], precision);
+			float dxy = unpackValue(channel[stride + 1], precision);
+			float lerp1Val = d + relPosx * (dx - d);
+			float lerp2Val = dy + relPosx * (dxy - dy);
+			out[c][rowStart + x] = packValue((lerp1Val + relPosy * (lerp2Val - lerp1Val)) * energyLost, precision);
+		}
+	}
+}
+
+void speedRow(float* out, const float* u, const float* v, int count) {
+	int x = 0;
+#if defined(SNOWLIB_SIMD_AVX2)
+	for (; x + 8 <= count; x += 8) {
+		__m256 uv = _mm256_loadu_ps(u + x);
+		__m256 vv = _mm256_loadu_ps(v + x);
+		_mm256_storeu_ps(out + x, _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(uv, uv), _mm256_mul_ps(vv, vv))));
+	}
+#elif defined(SNOWLIB_SIMD_SSE2)
+	for (; x + 4 <= count; x += 4) {
+		__m128 uv = _mm_loadu_ps(u + x);
+		__m128 vv = _mm_loadu_ps(v + x);
+		_mm_storeu_ps(out + x, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(uv, uv), _mm_mul_ps(vv, vv))));
+	}
+#endif
+	for (; x < count; ++x) {
+		out[x] = std::sqrt(u[x] * u[x] + v[x] * v[x]);
+	}
+}
+
+float maxAbsRow(const float* values, int count) {
+	int x = 0;
+	float largest = 0;
+#if defined(SNOWLIB_SIMD_AVX2)
+	const __m256 signBits = _mm256_set1_ps(-0.0f);
+	__m256 largestV = _mm256_setzero_ps();
+	// max returns its second operand when either is NaN, so the running maximum goes second
+	for (; x + 8 <= count; x += 8) {
+		largestV = _mm256_max_ps(_mm256_andnot_ps(signBits, _mm256_loadu_ps(values + x)), largestV);
+	}
+	__m128 half = _mm_max_ps(_mm256_castps256_ps128(largestV), _mm256_extractf128_ps(largestV, 1));
+	half = _mm_max_ps(half, _mm_movehl_ps(half, half));
+	half = _mm_max_ss(half, _mm_shuffle_ps(half, half, 1));
+	largest = _mm_cvtss_f32(half);
+#elif defined(SNOWLIB_SIMD_SSE2)
+	const __m128 signBits = _mm_set1_ps(-0.0f);
+	__m128 largestV = _mm_setzero_ps();
+	for (; x + 4 <= count; x += 4) {
+		largestV = _mm_max_ps(_mm_andnot_ps(signBits, _mm_loadu_ps(values + x)), largestV);
+	}
+	largestV = _mm_max_ps(largestV, _mm_movehl_ps(largestV, largestV));
+	largestV = _mm_max_ss(largestV, _mm_shuffle_ps(largestV, largestV, 1));
+	largest = _mm_cvtss_f32(largestV);
+#endif
+	for (; x < count; ++x) {
+		float magnitude = std::fabs(values[x]);
+		largest = magnitude > largest ? magnitude : largest;
+	}
+	return largest;
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+/*
+ * Row kernels shared by the solver stages. Each has an AVX2 and an SSE2 path picked at compile time
+ * (SNOWLIB_ENABLE_AVX2 / the target's baseline) and a scalar loop for the tail and other targets.
+ */
+
+#include <cstdint>
+#include "packedField.h"
+
+/**
+ * Name of the instruction set the kernels were compiled for ("avx2", "sse2" or "scalar").
+ */
+const char* simdInstructionSet();
+
+/**
+ * How halves are converted, "f16c" where the build assumes it or the processor has it, simdInstructionSet()
+ * otherwise. Setting the environment variable SNOWLIB_HALF to generic keeps F16C out of builds that do not assume it.
+ */
+const char* halfConversionInstructionSet();
+
+/**
+ * One lexicographic Gauss-Seidel sweep over a run of cells that all have four neighbours:
+ * cur[x] = (base[x] + k * (up[x] + down[x] + cur[x - 1] + next[x])) * invDiag.
+ * The up, down and right terms are gathered vectorized into partial first, only the left term is serial.
+ * @param cur Row being relaxed in place, cur[-1] must be readable.
+ * @param next Right neighbours not yet relaxed in this sweep, usually cur + 1.
+ * @param base Right hand side of the row.
+ * @param up Already relaxed row above.
+ * @param down Row below, not yet relaxed in this sweep.
+ * @param partial Scratch of at least count floats.
+ * @param count Number of cells to relax.
+ * @param k Weight of the neighbours.
+ * @param invDiag Inverse of the diagonal coefficient.
+ */
+void gaussSeidelRow(float* cur, const float* next, const float* base, const float* up, const float* down, float* partial, int count, float k, float invDiag);
+
+/**
+ * div[x] = scale * (u[x + 1] - u[x - 1] + vDown[x] - vUp[x]), u[-1] and u[count] must be readable.
+ */
+void divergenceRow(float* div, const float* u, const float* vUp, const float* vDown, int count, float scale);
+
+/**
+ * u[x] -= scale * (p[x + 1] - p[x - 1]) and v[x] -= scale * (pDown[x] - pUp[x]), p[-1] and p[count] must be readable.
+ */
+void subtractGradientRow(float* u, float* v, const float* p, const float* pUp, const float* pDown, int count, float scale);
+
+/**
+ * Semi-Lagrangian advection of one row of several channels at once: every cell is traced back along the
+ * velocity by deltaTime and bilinearly sampled from each source channel, the backtrace, corner and weights
+ * are computed once per cell for all channels. The samples may fall between the edge cells and the ghost ring,
+ * cells whose backtrace leaves it keep their old value.
+ * @param out Destination fields of the channels, cell (0, 0) of each, the row is written at y * stride.
+ * @param source Source fields of the channels, cell (0, 0) of each, with a filled ghost ring and never one of out.
+ * @param channelCount Number of channels.
+ * @param velocityX Row of the x velocity used for the backtrace.
+ * @param velocityY Row of the y velocity used for the backtrace.
+ * @param y Index of the row.
+ * @param from First cell of the row to advect.
+ * @param to End of the cells to advect, the cells outside [from, to) are not written.
+ * @param width Cells per row.
+ * @param height Rows of the fields.
+ * @param stride Floats between the starts of two rows, the same for every channel.
+ * @param deltaTime Step length.
+ * @param energyLost Factor the sampled values are multiplied by.
+ * @param periodic Whether backtraces wrap around the grid instead of leaving it.
+ */
+void advectRow(float* const* out, const float* const* source, int channelCount, const float* velocityX, const float* velocityY, int y, int from, int to,
+	int width, int height, int stride, float deltaTime, float energyLost, bool periodic);
+
+/**
+ * Residual of the 5-point system: r[x] = base[x] - (diag * cur[x] - k * (cur[x - 1] + cur[x + 1] + up[x] + down[x])).
+ * cur[-1] and cur[count] must be readable.
+ */
+void residualRow(float* r, const float* cur, const float* base, const float* up, const float* down, int count, float diag, float k);
+
+/**
+ * Weighted Jacobi update of one row into out, reading only the previous iterate:
+ * out[x] = (1 - weight) * cur[x] + weight * (base[x] + k * (cur[x - 1] + cur[x + 1] + up[x] + down[x])) * invDiag.
+ */
+void jacobiRow(float* out, const float* cur, const float* base, const float* up, const float* down, int count, float k, float invDiag, float weight);
+
+/**
+ * Gauss-Seidel update of every other cell of a row, starting at cell parity (0 or 1). Cells of one colour
+ * only read cells of the other colour, so a colour can be updated in any order and rows in parallel.
+ * Whole rows above and below are loaded, set neighboursShared when another thread may be relaxing one of
+ * them at the same time, then only their cells of the other colour are read. The result is the same either way.
+ */
+void redBlackRow(float* cur, const float* base, const float* up, const float* down, int count, int parity, float k, float invDiag, bool neighboursShared);
+
+/**
+ * Applies the 5-point operator to one row: out[x] = diag * cur[x] - k * (cur[x - 1] + cur[x + 1] + up[x] + down[x]).
+ * cur[-1] and cur[count] must be readable.
+ */
+void stencilRow(float* out, const float* cur, const float* up, const float* down, int count, float diag, float k);
+
+/**
+ * Dot product of two rows, summed in float lanes and returned as double so rows can be added up without losing precision.
+ */
+double dotRow(const float* a, const float* b, int count);
+
+/**
+ * Table lookup of a row: out[x] = table[clamp(int(values[x] * scale + bias), 0, last)], NaN picks entry 0.
+ */
+void lookupRow(std::uint32_t* out, const float* values, int count, const std::uint32_t* table, int last, float scale, float bias);
+
+/**
+ * Converts a row to IEEE half floats, rounding to nearest even. Values too large for a half become infinity.
+ */
+void floatToHalfRow(std::uint16_t* out, const float* values, int count);
+
+/**
+ * Converts a row of IEEE half floats to floats, exactly.
+ */
+void halfToFloatRow(float* out, const std::uint16_t* values, int count);
+
+/**
+ * Converts a row to bfloat16, rounding to nearest even, and back, exactly.
+ */
+void floatToBfloat16Row(std::uint16_t* out, const float* values, int count);
+void bfloat16ToFloatRow(float* out, const std::uint16_t* values, int count);
+
+/**
+ * One value or a row to or from a 16 bit precision (float16Precision or bfloat16Precision).
+ */
+std::uint16_t packValue(float value, fieldPrecision precision);
+float unpackValue(std::uint16_t value, fieldPrecision precision);
+void packRow(std::uint16_t* out, const float* values, int count, fieldPrecision precision);
+void unpackRow(float* out, const std::uint16_t* values, int count, fieldPrecision precision);
+
+/*
+ * The kernels below work on rows stored in a 16 bit precision. They convert chunks of a row into float buffers
+ * on the stack that stay in L1, run the float kernel of the same name on them and convert the cells they change
+ * back, so memory sees 16 bit traffic while all arithmetic stays in float.
+ */
+
+/**
+ * divergenceRow with u and v packed, div in float.
+ */
+void divergencePackedRow(float* div, const std::uint16_t* u, const std::uint16_t* vUp, const std::uint16_t* vDown, int count, float scale, fieldPrecision precision);
+
+/**
+ * subtractGradientRow with u and v packed, the pressure in float.
+ */
+void subtractGradientPackedRow(std::uint16_t* u, std::uint16_t* v, const float* p, const float* pUp, const float* pDown, int count, float scale, fieldPrecision precision);
+
+/**
+ * advectRow with the channels and the velocity rows packed. Corners are gathered as 16 bit values and converted in
+ * registers, the interpolation is done in float. Builds without AVX2 use the AVX2 loop where the processor has AVX2
+ * and F16C, see halfConversionInstructionSet().
+ * @param stride Values between the starts of two rows, the same for every channel.
+ */
+void advectPackedRow(std::uint16_t* const* out, const std::uint16_t* const* source, int channelCount, const std::uint16_t* velocityX, const std::uint16_t* velocityY,
+	int y, int width, int height, int stride, float deltaTime, float energyLost, bool periodic, fieldPrecision precision);
+
+/**
+ * Length of the velocity of every cell of a row: out[x] = sqrt(u[x] * u[x] + v[x] * v[x]).
+ */
+void speedRow(float* out, const float* u, const float* v, int count);
+
+/**
+ * Largest magnitude of a row, max |values[x]|. NaNs are skipped.
+ */
+float maxAbsRow(const float* values, int count);
@@ -0,0 +1,102 @@
+#include "spectralSolver.h"
+#include <cassert>
+#include <cmath>
+
+namespace {
+	// sin(2 pi k / n), exactly 0 at k = 0 and k = n / 2 so the waves the central difference cannot see stay untouched
+	float centralDifferenceSine(int k, int n) {
+		if ((2 * k) % n == 0) {
+			return 0.0f;
+		}
+		return float(std::sin(2 * 3.14159265358979323846 * k / n));
+	}
+
+	float halfAngleTerm(int k, int n) {
+		double sine = std::sin(3.14159265358979323846 * k / n);
+		return float(4 * sine * sine);
+	}
+}
+
+spectralSolver::spectralSolver(int width, int height) {
+	this->width = width;
+	this->height = height;
+	this->transform = realFft2d(width, height);
+
+	int spectrumWidth = this->transform.getSpectrumWidth();
+	std::size_t spectrumSize = std::size_t(spectrumWidth) * height;
+	this->spectra[0].assign(spectrumSize, complexFloat());
+	this->spectra[1].assign(spectrumSize, complexFloat());
+
+	this->sineX.resize(std::size_t(spectrumWidth));
+	for (int kx = 0; kx < spectrumWidth; ++kx) {
+		this->sineX[kx] = centralDifferenceSine(kx, width);
+	}
+	this->sineY.resize(std::size_t(height));
+	for (int ky = 0; ky < height; ++ky) {
+		this->sineY[ky] = centralDifferenceSine(ky, height);
+	}
+	this->laplacian.resize(spectrumSize);
+	for (int ky = 0; ky < height; ++ky) {
+		for (int kx = 0; kx < spectrumWidth; ++kx) {
+			this->laplacian[std::size_t(ky) * spectrumWidth + kx] = halfAngleTerm(kx, width) + halfAngleTerm(ky, height);
+		}
+	}
+}
+
+void spectralSolver::diffuse(field& solution, const field& rhs, float k, threadPool& pool) {
+	assert(solution.getWidth() == this->width && solution.getHeight() == this->height);
+	assert(rhs.getWidth() == this->width && rhs.getHeight() == this->height);
+	complexFloat* spectrum = this->spectra[0].data();
+	this->transform.forward(rhs.data(), rhs.getStride(), spectrum, pool);
+
+	// the 1 / (width * height) of the inverse transform is folded into the division
+	int spectrumWidth = this->transform.getSpectrumWidth();
+	float scale = 1.0f / (float(this->width) * float(this->height));
+	const float* eigenvalues = this->laplacian.data();
+	pool.parallelFor(0, this->height, [=](int from, int to) {
+		for (std::size_t index = std::size_t(from) * spectrumWidth; index < std::size_t(to) * spectrumWidth; ++index) {
+			spectrum[index] *= scale / (1.0f + k * eigenvalues[index]);
+		}
+	});
+
+	this->transform.inverse(spectrum, solution.data(), solution.getStride(), pool);
+}
+
+void spectralSolver::project(field& velocityX, field& velocityY, threadPool& pool) {
+	assert(velocityX.getWidth() == this->width && velocityX.getHeight() == this->height);
+	assert(velocityY.getWidth() == this->width && velocityY.getHeight() == this->height);
+	complexFloat* spectrumX = this->spectra[0].data();
+	complexFloat* spectrumY = this->spectra[1].data();
+	this->transform.forward(velocityX.data(), velocityX.getStride(), spectrumX, pool);
+	this->transform.forward(velocityY.data(), velocityY.getStride(), spectrumY, pool);
+
+	// the central difference along an axis is 2i sin(2 pi k / n) on a wave, so the divergence of a wave is
+	// 2i (sx U + sy V) and subtracting (sx, sy) (sx U + sy V) / (sx^2 + sy^2) leaves none
+	int spectrumWidth = this->transform.getSpectrumWidth();
+	float scale = 1.0f / (float(this->width) * float(this->height));
+	const float* sineX = this->sineX.data();
+	const float* sineY = this->sineY.data();
+	pool.parallelFor(0, this->height, [=](int from, int to) {
+		for (int ky = from; ky < to; ++ky) {
+			float sy = sineY[ky];
+			complexFloat* rowX = spectrumX + std::size_t(ky) * spectrumWidth;
+			complexFloat* rowY = spectrumY + std::size_t(ky) * spectrumWidth;
+			for (int kx = 0; kx < spectrumWidth; ++kx) {
+				float sx = sineX[kx];
+				float norm = sx * sx + sy * sy;
+				if (norm == 0.0f) {
+					rowX[kx] *= scale;
+					rowY[kx] *= scale;
+					continue;
+				}
+				complexFloat divergence = sx * rowX[kx] + sy * rowY[kx];
+				complexFloat removed = divergence * (1.0f / norm);
+				rowX[kx] = scale * (rowX[kx] - sx * removed);
+				rowY[kx] = scale * (rowY[kx] - sy * removed);
+			}
+		}
+	});
+
+	this->transform.inverse(spectrumX, velocityX.data(), velocityX.getStride(), pool);
+	this->transform.inverse(spectrumY, velocityY.data(), velocityY.getStride(), pool);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "field.h"
+#include "fft.h"
+
+/**
+ * Exact solves of the grid's implicit diffusion and projection on a periodic domain. On a grid that wraps around,
+ * every wave is an eigenvector of the difference operators the relaxation solvers work with, so the solves reduce
+ * to one multiply per wavenumber of the fields' spectra: a step costs a few 2D transforms, O(N log N) whatever
+ * the viscosity or step length, and leaves no residual for iterations to chase.
+ */
+class spectralSolver {
+
+protected:
+	int width = 0;
+	int height = 0;
+	realFft2d transform;
+	// half spectra of the fields being solved, two for the velocity components of the projection
+	alignedVector<complexFloat> spectra[2];
+	// eigenvalues per wavenumber: 4 sin^2(pi kx / width) + 4 sin^2(pi ky / height) of the 5-point Laplacian
+	// (negated), and sin(2 pi k / n) of the central difference along each axis
+	alignedVector<float> laplacian;
+	alignedVector<float> sineX;
+	alignedVector<float> sineY;
+
+public:
+	spectralSolver() = default;
+
+	/**
+	 * @param width Cells per row of the fields passed to the solves.
+	 * @param height Rows of the fields passed to the solves.
+	 */
+	spectralSolver(int width, int height);
+
+	int getWidth() const { return this->width; }
+	int getHeight() const { return this->height; }
+
+	/**
+	 * Solves the implicit diffusion step (1 + 4k) x - k * (sum of the four neighbours) = rhs exactly, the
+	 * neighbours of the edge cells being those on the opposite side. Only the cells are read and written, not the
+	 * ghost ring. solution and rhs may be the same field.
+	 */
+	void diffuse(field& solution, const field& rhs, float k, threadPool& pool);
+
+	/**
+	 * Removes the divergence from a periodic velocity field: afterwards the central difference divergence
+	 * (u[x + 1] - u[x - 1] + v[y + 1] - v[y - 1]) / 2 is zero in every cell, to rounding. The waves it cannot see,
+	 * the mean flow and the checkerboards of even sizes, are kept.
+	 */
+	void project(field& velocityX, field& velocityY, threadPool& pool);
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "atomic"
+#include "cstdint"
+
+/**
+ * Bounded wait-free queue between one producer and one consumer thread. Neither side ever blocks or loops:
+ * a push into a full queue fails and a pop from an empty one returns nothing.
+ * @tparam capacity Number of slots, a power of two.
+ */
+template<typename T, int capacity>
+class spscQueue {
+	static_assert(capacity > 0 && (capacity & (capacity - 1)) == 0, "capacity must be a power of two");
+
+protected:
+	// next slot to pop, written by the consumer only
+	alignas(64) std::atomic<std::uint32_t> head{ 0 };
+	// next slot to push, written by the producer only
+	alignas(64) std::atomic<std::uint32_t> tail{ 0 };
+	T items[capacity];
+
+public:
+	/**
+	 * Producer side.
+	 * @return False if the queue was full and item was not added.
+	 */
+	bool push(const T& item) {
+		std::uint32_t position = this->tail.load(std::memory_order_relaxed);
+		if (position - this->head.load(std::memory_order_acquire) == std::uint32_t(capacity)) {
+			return false;
+		}
+		this->items[position & (capacity - 1)] = item;
+		this->tail.store(position + 1, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * Consumer side.
+	 * @return False if the queue was empty and item was left unchanged.
+	 */
+	bool pop(T& item) {
+		std::uint32_t position = this->head.load(std::memory_order_relaxed);
+		if (position == this->tail.load(std::memory_order_acquire)) {
+			return false;
+		}
+		item = this->items[position & (capacity - 1)];
+		this->head.store(position + 1, std::memory_order_release);
+		return true;
+	}
+};
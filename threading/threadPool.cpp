@@ -0,0 +1,212 @@
+#include "threadPool.h"
+#include "profiling/profiler.h"
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <emmintrin.h>
+#define SNOWLIB_CPU_RELAX() _mm_pause()
+#else
+#define SNOWLIB_CPU_RELAX() std::this_thread::yield()
+#endif
+
+namespace {
+	// set while a thread runs tiles, nested jobs then run inline instead of waiting on the busy workers
+	thread_local bool insideJob = false;
+
+	// polls a sleeping worker does on the generation before blocking, passes follow each other closely within a frame
+	const int spinPolls = 2000;
+
+	std::uint64_t packRange(int front, int back) {
+		return (std::uint64_t(std::uint32_t(back)) << 32) | std::uint32_t(front);
+	}
+}
+
+threadPool::threadPool(int threadCount) {
+	this->startWorkers(threadCount);
+}
+
+threadPool::~threadPool() {
+	this->stopWorkers();
+}
+
+void threadPool::setThreadCount(int threadCount) {
+	std::lock_guard<std::mutex> jobLock(this->jobMutex);
+	this->stopWorkers();
+	this->startWorkers(threadCount);
+}
+
+int threadPool::getThreadCount() const {
+	return this->threadCount;
+}
+
+void threadPool::setTileSize(int tileSize) {
+	std::lock_guard<std::mutex> jobLock(this->jobMutex);
+	this->tileSize = std::max(tileSize, 0);
+}
+
+int threadPool::getTileSize() const {
+	return this->tileSize;
+}
+
+void threadPool::startWorkers(int threadCount) {
+	if (threadCount <= 0) {
+		threadCount = int(std::thread::hardware_concurrency());
+	}
+	this->threadCount = threadCount > 0 ? threadCount : 1;
+	this->stopping = false;
+	this->queues = std::make_unique<tileQueue[]>(this->threadCount);
+
+	// the thread issuing a job is index 0 and works on it as well
+	for (int index = 1; index < this->threadCount; ++index) {
+		this->workers.emplace_back(&threadPool::workerLoop, this, index, this->generation.load());
+	}
+}
+
+void threadPool::stopWorkers() {
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->stopping = true;
+		this->generation.fetch_add(1, std::memory_order_release);
+	}
+	this->wake.notify_all();
+
+	for (std::thread& worker : this->workers) {
+		worker.join();
+	}
+	this->workers.clear();
+}
+
+void threadPool::run(int begin, int end, tileFunction function, const void* context) {
+	if (end <= begin) {
+		return;
+	}
+	if (this->threadCount == 1 || insideJob || end - begin == 1) {
+		function(context, begin, end);
+		return;
+	}
+
+	std::lock_guard<std::mutex> jobLock(this->jobMutex);
+	int rows = end - begin;
+	int tileRows = this->tileSize > 0 ? this->tileSize : std::clamp(rows / (this->threadCount * 4), 1, 16);
+	int tileCount = (rows + tileRows - 1) / tileRows;
+
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->function = function;
+		this->context = context;
+		this->begin = begin;
+		this->end = end;
+		this->tileRows = tileRows;
+		for (int index = 0; index < this->threadCount; ++index) {
+			int front = int(std::int64_t(tileCount) * index / this->threadCount);
+			int back = int(std::int64_t(tileCount) * (index + 1) / this->threadCount);
+			this->queues[index].range.store(packRange(front, back), std::memory_order_relaxed);
+		}
+		this->pendingWorkers = int(this->workers.size());
+		this->generation.fetch_add(1, std::memory_order_release);
+	}
+	this->wake.notify_all();
+
+	this->runTiles(0);
+
+	std::unique_lock<std::mutex> lock(this->mutex);
+	this->finished.wait(lock, [this] { return this->pendingWorkers == 0; });
+}
+
+void threadPool::workerLoop(int index, std::uint64_t seenGeneration) {
+	// spinning only pays off while every worker has a core of its own
+	bool spin = this->threadCount <= int(std::thread::hardware_concurrency());
+
+	while (true) {
+		for (int poll = 0; spin && poll < spinPolls; ++poll) {
+			if (this->generation.load(std::memory_order_acquire) != seenGeneration) {
+				break;
+			}
+			SNOWLIB_CPU_RELAX();
+		}
+
+		{
+			std::unique_lock<std::mutex> lock(this->mutex);
+			this->wake.wait(lock, [&] { return this->generation.load(std::memory_order_relaxed) != seenGeneration; });
+			if (this->stopping) {
+				return;
+			}
+			seenGeneration = this->generation.load(std::memory_order_relaxed);
+		}
+
+		this->runTiles(index);
+
+		{
+			std::lock_guard<std::mutex> lock(this->mutex);
+			--this->pendingWorkers;
+		}
+		this->finished.notify_one();
+	}
+}
+
+void threadPool::runTiles(int index) {
+	insideJob = true;
+#ifdef SNOWLIB_PROFILE
+	// workers add what they count over their tiles to the open profiled scopes, the issuing thread is
+	// counted by its scope already
+	profiler& stages = profiler::instance();
+	bool counting = index != 0 && stages.countingWorkers();
+	profiler::counterValues startCounters;
+	if (counting) {
+		startCounters = stages.readCounters();
+	}
+#endif
+
+	while (true) {
+		int tile;
+		bool found = this->popFront(this->queues[index], tile);
+		// out of own tiles, take the last one of the next thread that still has some
+		for (int offset = 1; !found && offset < this->threadCount; ++offset) {
+			found = this->popBack(this->queues[(index + offset) % this->threadCount], tile);
+		}
+		if (!found) {
+			break;
+		}
+
+		int from = this->begin + tile * this->tileRows;
+		int to = std::min(from + this->tileRows, this->end);
+		this->function(this->context, from, to);
+	}
+
+#ifdef SNOWLIB_PROFILE
+	if (counting) {
+		stages.addWorkerCounters(startCounters, stages.readCounters());
+	}
+#endif
+	insideJob = false;
+}
+
+bool threadPool::popFront(tileQueue& queue, int& tile) {
+	std::uint64_t range = queue.range.load(std::memory_order_relaxed);
+	while (true) {
+		int front = int(std::uint32_t(range));
+		int back = int(std::uint32_t(range >> 32));
+		if (front >= back) {
+			return false;
+		}
+		if (queue.range.compare_exchange_weak(range, packRange(front + 1, back), std::memory_order_relaxed)) {
+			tile = front;
+			return true;
+		}
+	}
+}
+
+bool threadPool::popBack(tileQueue& queue, int& tile) {
+	std::uint64_t range = queue.range.load(std::memory_order_relaxed);
+	while (true) {
+		int front = int(std::uint32_t(range));
+		int back = int(std::uint32_t(range >> 32));
+		if (front >= back) {
+			return false;
+		}
+		if (queue.range.compare_exchange_weak(range, packRange(front, back - 1), std::memory_order_relaxed)) {
+			tile = back - 1;
+			return true;
+		}
+	}
+}
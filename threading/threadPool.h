@@ -0,0 +1,95 @@
+#pragma once
+
+#include "vector"
+#include "thread"
+#include "mutex"
+#include "condition_variable"
+#include "atomic"
+#include "memory"
+#include "cstdint"
+
+/**
+ * Persistent worker threads for the solver passes. The workers are started once and reused by every pass
+ * of every frame, between jobs they spin briefly and then sleep, so a pass never creates threads.
+ * A job is cut into tiles of rows, every thread starts on its own contiguous share of the tiles and steals
+ * from the others once it runs out, so uneven rows do not leave threads idle.
+ */
+class threadPool {
+
+public:
+	/**
+	 * @param threadCount Threads working on a job, the calling thread included. 0 picks the hardware concurrency.
+	 */
+	threadPool(int threadCount = 0);
+	~threadPool();
+
+	threadPool(const threadPool&) = delete;
+	threadPool& operator=(const threadPool&) = delete;
+
+	/**
+	 * Restarts the workers with a new thread count, 0 picks the hardware concurrency. Must not be called from inside a job.
+	 */
+	void setThreadCount(int threadCount);
+	int getThreadCount() const;
+
+	/**
+	 * @param tileSize Rows per tile, 0 picks up to 16 rows while giving every thread several tiles to balance with.
+	 */
+	void setTileSize(int tileSize);
+	int getTileSize() const;
+
+	/**
+	 * Cuts [begin, end) into tiles, calls body(from, to) once per tile and returns once all of them are done.
+	 * Tiles run on any thread in any order, the result must not depend on either. A parallelFor issued from
+	 * inside a tile runs serially on the calling thread.
+	 */
+	template<typename Body>
+	void parallelFor(int begin, int end, const Body& body) {
+		this->run(begin, end, [](const void* context, int from, int to) { (*static_cast<const Body*>(context))(from, to); }, &body);
+	}
+
+private:
+	using tileFunction = void (*)(const void* context, int from, int to);
+
+	// tiles [front, back) still to be run, packed in one word so the owner popping the front and thieves
+	// popping the back agree through a single compare-exchange
+	struct alignas(64) tileQueue {
+		std::atomic<std::uint64_t> range{ 0 };
+	};
+
+	void run(int begin, int end, tileFunction function, const void* context);
+
+	void startWorkers(int threadCount);
+
+	void stopWorkers();
+
+	void workerLoop(int index, std::uint64_t seenGeneration);
+
+	void runTiles(int index);
+
+	bool popFront(tileQueue& queue, int& tile);
+
+	bool popBack(tileQueue& queue, int& tile);
+
+	std::vector<std::thread> workers;
+	std::unique_ptr<tileQueue[]> queues;
+	int threadCount = 1;
+	int tileSize = 0;
+
+	// held for a whole job, so jobs issued from different threads run one after the other
+	std::mutex jobMutex;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable finished;
+	std::atomic<std::uint64_t> generation{ 0 };
+	int pendingWorkers = 0;
+	bool stopping = false;
+
+	// the job being run
+	tileFunction function = nullptr;
+	const void* context = nullptr;
+	int begin = 0;
+	int end = 0;
+	int tileRows = 1;
+
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "atomic"
+
+/**
+ * Lock-free handoff of whole frames from one writer thread to one reader thread. The writer fills its own
+ * buffer and publishes it, the reader takes the newest published buffer; neither ever waits for the other,
+ * a frame the reader did not get to in time is simply replaced by the next one.
+ */
+template<typename T>
+class tripleBuffer {
+
+protected:
+	static constexpr unsigned freshBit = 4;
+
+	T buffers[3];
+	// buffer between the two threads, with freshBit set while it holds a frame the reader has not taken
+	std::atomic<unsigned> middle{ 1 };
+	// owned by the writer
+	unsigned writeIndex = 0;
+	// owned by the reader
+	unsigned readIndex = 2;
+
+public:
+	/**
+	 * Buffer the writer fills next.
+	 */
+	T& writeBuffer() { return this->buffers[this->writeIndex]; }
+
+	/**
+	 * Hands the write buffer to the reader and gives the writer the one it last replaced.
+	 */
+	void publish() {
+		unsigned previous = this->middle.exchange(this->writeIndex | freshBit, std::memory_order_acq_rel);
+		this->writeIndex = previous & (freshBit - 1);
+	}
+
+	/**
+	 * Takes the newest published buffer if one came in since the last call, the read buffer stays unchanged otherwise.
+	 * @return Whether the read buffer changed.
+	 */
+	bool acquire() {
+		if ((this->middle.load(std::memory_order_relaxed) & freshBit) == 0) {
+			return false;
+		}
+		unsigned previous = this->middle.exchange(this->readIndex, std::memory_order_acq_rel);
+		this->readIndex = previous & (freshBit - 1);
+		return true;
+	}
+
+	/**
+	 * Buffer the reader took last.
+	 */
+	const T& readBuffer() const { return this->buffers[this->readIndex]; }
+
+	/**
+	 * All three buffers, to size them before the threads start.
+	 */
+	T& operator[](int index) { return this->buffers[index]; }
+};
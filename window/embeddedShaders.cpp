@@ -0,0 +1,10 @@
+#include "embeddedShaders.h"
+
+std::string_view embeddedShaderSource(std::string_view name) {
+	for (int index = 0; index < embeddedShaderCount; ++index) {
+		if (name == embeddedShaders[index].name) {
+			return std::string_view(reinterpret_cast<const char*>(embeddedShaders[index].source), embeddedShaders[index].length);
+		}
+	}
+	return {};
+}
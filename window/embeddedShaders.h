@@ -0,0 +1,26 @@
+#pragma once
+
+#include "cstddef"
+#include "string_view"
+
+/**
+ * Shader sources compiled into the executable. The table is generated at build time from the shaders directory
+ * by cmake/embedShaders.cmake, so the window runs from any working directory and a missing shader fails the build.
+ */
+struct embeddedShader {
+	// file name in the shaders directory, e.g. "vertex.glsl"
+	const char* name;
+	// source text, zero terminated
+	const unsigned char* source;
+	// bytes of source without the terminating zero
+	std::size_t length;
+};
+
+extern const embeddedShader embeddedShaders[];
+extern const int embeddedShaderCount;
+
+/**
+ * Source of an embedded shader, empty when no shader of that name was embedded.
+ * @param name File name in the shaders directory, e.g. "vertex.glsl".
+ */
+std::string_view embeddedShaderSource(std::string_view name);
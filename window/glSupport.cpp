@@ -0,0 +1,23 @@
+#include "glSupport.h"
+#include "glad/glad.h"
+#include <cstring>
+
+bool glSupports(int major, int minor, const char* extension) {
+	int contextMajor = 0;
+	int contextMinor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &contextMajor);
+	glGetIntegerv(GL_MINOR_VERSION, &contextMinor);
+	if (contextMajor > major || (contextMajor == major && contextMinor >= minor)) {
+		return true;
+	}
+
+	int extensionCount = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+	for (int index = 0; index < extensionCount; ++index) {
+		const char* name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, index));
+		if (name != nullptr && std::strcmp(name, extension) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+/**
+ * Whether the current context provides a feature, either as core of its GL version or through an extension.
+ * Needs a current GL context.
+ * @param major Major GL version the feature became core in.
+ * @param minor Minor GL version the feature became core in.
+ * @param extension Extension providing the feature on older versions, e.g. "GL_ARB_buffer_storage".
+ */
+bool glSupports(int major, int minor, const char* extension);
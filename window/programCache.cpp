@@ -0,0 +1,269 @@
+#include "programCache.h"
+#include "glSupport.h"
+#include "GLFW/glfw3.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+#include <vector>
+
+// GL 4.1 names, the loader may only cover GL 3.3
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+namespace {
+	// "SLPB", followed by the version of the layout below
+	const std::uint32_t binaryMagic = 0x42504c53;
+	const std::uint32_t binaryVersion = 1;
+
+	struct binaryHeader {
+		std::uint32_t magic;
+		std::uint32_t version;
+		// key the file was written under, checked again on load
+		std::uint64_t key;
+		std::uint32_t format;
+		std::uint32_t length;
+	};
+
+	// 64 bit FNV-1a, continued from hash
+	std::uint64_t hashBytes(std::string_view bytes, std::uint64_t hash = 0xcbf29ce484222325ull) {
+		for (char byte : bytes) {
+			hash ^= std::uint8_t(byte);
+			hash *= 0x100000001b3ull;
+		}
+		return hash;
+	}
+
+	std::string glString(GLenum name) {
+		const char* value = reinterpret_cast<const char*>(glGetString(name));
+		return value != nullptr ? value : "";
+	}
+}
+
+programCache::programCache() : programCache(defaultDirectory()) {
+}
+
+programCache::programCache(std::string directory) {
+	this->directory = std::move(directory);
+}
+
+std::string programCache::defaultDirectory() {
+	if (const char* configured = std::getenv("SNOWLIB_SHADER_CACHE")) {
+		return configured;
+	}
+	std::filesystem::path base;
+#if defined(_WIN32)
+	if (const char* local = std::getenv("LOCALAPPDATA")) {
+		base = local;
+	}
+#else
+	if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg != nullptr && xdg[0] != '\0') {
+		base = xdg;
+	}
+	else if (const char* home = std::getenv("HOME")) {
+		base = std::filesystem::path(home) / ".cache";
+	}
+#endif
+	if (base.empty()) {
+		return "";
+	}
+	return (base / "snowlib" / "shaders").string();
+}
+
+void programCache::initialise() {
+	this->initialised = true;
+	if (this->directory.empty()) {
+		return;
+	}
+
+	int formatCount = 0;
+	if (glSupports(4, 1, "GL_ARB_get_program_binary")) {
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+		this->getProgramBinary = reinterpret_cast<getProgramBinaryFunction>(glfwGetProcAddress("glGetProgramBinary"));
+		this->programBinary = reinterpret_cast<programBinaryFunction>(glfwGetProcAddress("glProgramBinary"));
+		this->programParameteri = reinterpret_cast<programParameteriFunction>(glfwGetProcAddress("glProgramParameteri"));
+	}
+	// a driver may support the functions and still offer no format to store programs in
+	if (formatCount <= 0 || this->getProgramBinary == nullptr || this->programBinary == nullptr || this->programParameteri == nullptr) {
+		return;
+	}
+
+	std::error_code error;
+	std::filesystem::create_directories(this->directory, error);
+	if (error) {
+		std::cout << "shader cache disabled, cannot create " << this->directory << ": " << error.message() << std::endl;
+		return;
+	}
+
+	// separated so "ab" + "c" and "a" + "bc" hash differently
+	this->driverHash = hashBytes(glString(GL_VENDOR) + '\n' + glString(GL_RENDERER) + '\n' + glString(GL_VERSION) + '\n');
+	this->enabled = true;
+}
+
+unsigned int programCache::getProgram(std::string_view vertexSource, std::string_view fragmentSource) {
+	if (!this->initialised) {
+		this->initialise();
+	}
+	if (!this->enabled) {
+		++this->misses;
+		return this->linkProgram(vertexSource, fragmentSource);
+	}
+
+	// the vertex length keeps a line moved from the end of one source to the start of the other from hashing the same
+	std::uint64_t key = hashBytes(vertexSource, this->driverHash);
+	key = hashBytes(fragmentSource, hashBytes(std::to_string(vertexSource.size()) + '\n', key));
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+	std::string path = (std::filesystem::path(this->directory) / name).string();
+
+	unsigned int program = this->loadBinary(path, key);
+	if (program != 0) {
+		++this->hits;
+		return program;
+	}
+
+	++this->misses;
+	program = this->linkProgram(vertexSource, fragmentSource);
+	if (program != 0) {
+		this->storeBinary(program, path, key);
+	}
+	return program;
+}
+
+unsigned int programCache::loadBinary(const std::string& path, std::uint64_t key) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		return 0;
+	}
+	binaryHeader header;
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != binaryMagic || header.version != binaryVersion
+		|| header.key != key || header.length == 0) {
+		return 0;
+	}
+	std::vector<char> binary(header.length);
+	if (!file.read(binary.data(), std::streamsize(binary.size()))) {
+		return 0;
+	}
+
+	unsigned int program = glCreateProgram();
+	this->programBinary(program, header.format, binary.data(), GLsizei(binary.size()));
+	int linked = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (!linked) {
+		// the driver no longer takes this binary, the caller compiles the sources and replaces it
+		glDeleteProgram(program);
+		return 0;
+	}
+	return program;
+}
+
+void programCache::storeBinary(unsigned int program, const std::string& path, std::uint64_t key) {
+	int length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) {
+		return;
+	}
+	std::vector<char> binary(std::size_t(length), 0);
+	GLsizei written = 0;
+	GLenum format = 0;
+	this->getProgramBinary(program, length, &written, &format, binary.data());
+	if (written <= 0) {
+		return;
+	}
+
+	binaryHeader header;
+	header.magic = binaryMagic;
+	header.version = binaryVersion;
+	header.key = key;
+	header.format = format;
+	header.length = std::uint32_t(written);
+
+	// written next to the final name and renamed over it, so instances starting at the same time never read half a file
+	std::string temporary = path + "." + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + ".tmp";
+	{
+		std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(binary.data(), written);
+		if (!file) {
+			file.close();
+			std::error_code ignored;
+			std::filesystem::remove(temporary, ignored);
+			return;
+		}
+	}
+	std::error_code error;
+	std::filesystem::rename(temporary, path, error);
+	if (error) {
+		// another instance got there first where renaming over a file fails
+		std::filesystem::remove(temporary, error);
+	}
+}
+
+unsigned int programCache::compileShader(std::string_view source, unsigned int shaderType) {
+	unsigned int shader = glCreateShader(shaderType);
+	const char* sourceString = source.data();
+	int sourceLength = int(source.size());
+	glShaderSource(shader, 1, &sourceString, &sourceLength);
+	glCompileShader(shader);
+
+	int success = 0;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+	if (!success) {
+		char infoLog[1024];
+		glGetShaderInfoLog(shader, sizeof(infoLog), NULL, infoLog);
+		std::cout << (shaderType == GL_VERTEX_SHADER ? "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" : "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n")
+			<< infoLog << std::endl;
+		glDeleteShader(shader);
+		return 0;
+	}
+	return shader;
+}
+
+unsigned int programCache::linkProgram(std::string_view vertexSource, std::string_view fragmentSource) {
+	if (vertexSource.empty() || fragmentSource.empty()) {
+		std::cout << "ERROR::PROGRAM::MISSING_SOURCE" << std::endl;
+		return 0;
+	}
+	unsigned int vertexShader = compileShader(vertexSource, GL_VERTEX_SHADER);
+	unsigned int fragmentShader = compileShader(fragmentSource, GL_FRAGMENT_SHADER);
+	if (vertexShader == 0 || fragmentShader == 0) {
+		glDeleteShader(vertexShader);
+		glDeleteShader(fragmentShader);
+		return 0;
+	}
+
+	unsigned int program = glCreateProgram();
+	if (this->enabled) {
+		// the hint has to be set before linking for the binary to be retrievable afterwards
+		this->programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+	glAttachShader(program, vertexShader);
+	glAttachShader(program, fragmentShader);
+	glLinkProgram(program);
+	// the program keeps what it needs, the shaders are freed once detached
+	glDetachShader(program, vertexShader);
+	glDetachShader(program, fragmentShader);
+	glDeleteShader(vertexShader);
+	glDeleteShader(fragmentShader);
+
+	int linked = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (!linked) {
+		char infoLog[1024];
+		glGetProgramInfoLog(program, sizeof(infoLog), NULL, infoLog);
+		std::cout << "ERROR::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+		glDeleteProgram(program);
+		return 0;
+	}
+	return program;
+}
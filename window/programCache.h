@@ -0,0 +1,79 @@
+#pragma once
+
+#include "glad/glad.h"
+#include "cstdint"
+#include "string"
+#include "string_view"
+
+/**
+ * Links shader programs and keeps their binaries on disk, so later runs load a program with glProgramBinary instead
+ * of compiling it. A binary is filed under a hash of the driver (vendor, renderer and version strings) and of both
+ * sources, so a changed shader or driver misses the cache and compiles again. Binaries the driver rejects, e.g.
+ * after an update that kept its version string, are compiled again and replaced. Caching is off where neither
+ * GL 4.1 nor ARB_get_program_binary is available or no directory could be found, programs then always compile.
+ */
+class programCache {
+
+protected:
+	std::string directory;
+	// hash of the driver strings, read with the first program since it needs a context
+	std::uint64_t driverHash = 0;
+	bool initialised = false;
+	bool enabled = false;
+	int hits = 0;
+	int misses = 0;
+
+	typedef void (APIENTRY* getProgramBinaryFunction)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+	typedef void (APIENTRY* programBinaryFunction)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+	typedef void (APIENTRY* programParameteriFunction)(GLuint program, GLenum pname, GLint value);
+	getProgramBinaryFunction getProgramBinary = nullptr;
+	programBinaryFunction programBinary = nullptr;
+	programParameteriFunction programParameteri = nullptr;
+
+public:
+	/**
+	 * Caches in SNOWLIB_SHADER_CACHE when set, otherwise in snowlib/shaders of the user cache directory
+	 * (XDG_CACHE_HOME or ~/.cache, LOCALAPPDATA on Windows).
+	 */
+	programCache();
+
+	/**
+	 * @param directory Directory the binaries are kept in, created when missing. Empty turns caching off.
+	 */
+	explicit programCache(std::string directory);
+
+	/**
+	 * Returns a linked program of the two sources, loaded from the cache when possible. Needs a current GL context.
+	 * Compile and link errors are printed and give 0.
+	 * @param vertexSource Source of the vertex shader.
+	 * @param fragmentSource Source of the fragment shader.
+	 */
+	unsigned int getProgram(std::string_view vertexSource, std::string_view fragmentSource);
+
+	/**
+	 * Whether binaries are read and written, known once the first program was requested.
+	 */
+	bool isEnabled() const { return this->enabled; }
+
+	const std::string& getDirectory() const { return this->directory; }
+
+	// programs loaded from the cache and compiled from source so far
+	int getHits() const { return this->hits; }
+	int getMisses() const { return this->misses; }
+
+	/**
+	 * Default directory as described for the default constructor, empty when none can be found.
+	 */
+	static std::string defaultDirectory();
+
+private:
+	void initialise();
+
+	unsigned int loadBinary(const std::string& path, std::uint64_t key);
+
+	void storeBinary(unsigned int program, const std::string& path, std::uint64_t key);
+
+	static unsigned int compileShader(std::string_view source, unsigned int shaderType);
+
+	unsigned int linkProgram(std::string_view vertexSource, std::string_view fragmentSource);
+};
@@ -0,0 +1,88 @@
+#include "simulationThread.h"
+#include "profiling/profiler.h"
+#include <chrono>
+
+simulationThread::simulationThread(fluidGrid& grid) : grid(grid) {
+}
+
+simulationThread::~simulationThread() {
+	this->stop();
+}
+
+void simulationThread::start(std::size_t frameBytes, frameWriter writer, bool fixedStep, const fixedTimestep& clock) {
+	this->stop();
+
+	this->writer = std::move(writer);
+	this->fixedStep = fixedStep;
+	this->clock = clock;
+	this->clock.reset();
+	for (int index = 0; index < 3; ++index) {
+		this->frames[index].texels.resize(frameBytes);
+		// no stamps, so the first write to every frame covers all of it
+		this->frames[index].rowStamps.clear();
+	}
+	// drop a frame left over from the last run
+	this->frames.acquire();
+	this->steps.store(0, std::memory_order_relaxed);
+
+	this->stopping.store(false, std::memory_order_relaxed);
+	this->thread = std::thread(&simulationThread::run, this);
+}
+
+void simulationThread::stop() {
+	if (!this->thread.joinable()) {
+		return;
+	}
+	this->stopping.store(true, std::memory_order_relaxed);
+	this->thread.join();
+}
+
+const simulationFrame* simulationThread::newestFrame() {
+	if (!this->frames.acquire()) {
+		return nullptr;
+	}
+	return &this->frames.readBuffer();
+}
+
+void simulationThread::run() {
+	auto previousTime = std::chrono::steady_clock::now();
+
+	while (!this->stopping.load(std::memory_order_relaxed)) {
+		auto currentTime = std::chrono::steady_clock::now();
+		double elapsed = std::chrono::duration<double>(currentTime - previousTime).count();
+		previousTime = currentTime;
+
+		{
+			SNOWLIB_PROFILE_SCOPE(inputStage);
+			brushInput input;
+			while (this->inputs.pop(input)) {
+				this->grid.addSource(input.centerX, input.centerY, input.velocityX, input.velocityY, input.densityAmount, input.halfSize);
+			}
+		}
+
+		int stepCount = 1;
+		float stepLength = float(elapsed);
+		if (this->fixedStep) {
+			stepCount = this->clock.advance(elapsed);
+			stepLength = float(this->clock.getStepLength());
+		}
+
+		if (stepCount == 0) {
+			// sleep until the next step is due, input that comes in meanwhile waits for that step anyway
+			double wait = (1 - this->clock.getAlpha()) * this->clock.getStepLength();
+			std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+			continue;
+		}
+
+		for (int step = 0; step < stepCount; ++step) {
+			this->grid.step(stepLength);
+		}
+		this->steps.fetch_add(stepCount, std::memory_order_relaxed);
+
+		{
+			SNOWLIB_PROFILE_SCOPE(colourStage);
+			this->writer(this->grid, this->frames.writeBuffer());
+		}
+		this->frames.publish();
+	}
+}
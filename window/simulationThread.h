@@ -0,0 +1,103 @@
+#pragma once
+
+#include "atomic"
+#include "thread"
+#include "vector"
+#include "cstdint"
+#include "functional"
+#include "solver/fluidGrid.h"
+#include "solver/fixedTimestep.h"
+#include "threading/tripleBuffer.h"
+#include "threading/spscQueue.h"
+
+/**
+ * Brush stroke sent from the render thread to the simulation, see fluidGrid::addSource().
+ */
+struct brushInput {
+	int centerX;
+	int centerY;
+	float velocityX;
+	float velocityY;
+	float densityAmount;
+	int halfSize;
+};
+
+/**
+ * One frame published by the simulation: its texels and, per row of tiles, the grid's stamp the row was
+ * written from (see fluidGrid::getTileRowStamps()). Rows whose stamps match hold the same texels.
+ */
+struct simulationFrame {
+	std::vector<unsigned char> texels;
+	std::vector<std::uint64_t> rowStamps;
+};
+
+/**
+ * Steps a grid on a thread of its own, so vsync and slow uploads never hold up the solver and a slow solve
+ * never holds up drawing. After the steps of a frame the grid is written into a frame buffer and published
+ * through a triple buffer, the render thread picks up the newest finished frame without waiting. Input goes
+ * the other way through a wait-free queue and is applied before the next step.
+ * The grid must not be touched by other threads while the simulation runs.
+ */
+class simulationThread {
+
+public:
+	// brings the texels of a frame up to date with the grid, called on the simulation thread. The frame holds what
+	// was written to it a few frames before, only rows of tiles whose stamps moved on need to be rewritten
+	using frameWriter = std::function<void(const fluidGrid& grid, simulationFrame& frame)>;
+
+protected:
+	fluidGrid& grid;
+	std::thread thread;
+	std::atomic<bool> stopping{ false };
+
+	frameWriter writer;
+	bool fixedStep = true;
+	fixedTimestep clock;
+
+	tripleBuffer<simulationFrame> frames;
+	spscQueue<brushInput, 256> inputs;
+	std::atomic<long long> steps{ 0 };
+
+public:
+	simulationThread(fluidGrid& grid);
+	~simulationThread();
+
+	simulationThread(const simulationThread&) = delete;
+	simulationThread& operator=(const simulationThread&) = delete;
+
+	/**
+	 * Starts stepping the grid, restarting the thread if it already runs.
+	 * @param frameBytes Size of one frame.
+	 * @param writer Writes a frame after every batch of steps.
+	 * @param fixedStep Whether to step by clock or by the real time between batches.
+	 * @param clock Step rate and substep cap for fixed steps.
+	 */
+	void start(std::size_t frameBytes, frameWriter writer, bool fixedStep, const fixedTimestep& clock);
+
+	/**
+	 * Stops the thread after its current step and waits for it.
+	 */
+	void stop();
+
+	bool running() const { return this->thread.joinable(); }
+
+	/**
+	 * Queues a brush stroke without waiting, render thread only.
+	 * @return False if the queue was full and the stroke was dropped.
+	 */
+	bool addInput(const brushInput& input) { return this->inputs.push(input); }
+
+	/**
+	 * Newest finished frame if one came in since the last call, null otherwise. Never waits, render thread only.
+	 * The frame stays valid until the next call.
+	 */
+	const simulationFrame* newestFrame();
+
+	/**
+	 * Steps run since the thread was started.
+	 */
+	long long stepCount() const { return this->steps.load(std::memory_order_relaxed); }
+
+private:
+	void run();
+};
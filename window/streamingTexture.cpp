@@ -0,0 +1,123 @@
+#include "streamingTexture.h"
+#include "glSupport.h"
+#include "GLFW/glfw3.h"
+
+// GL 4.4 names, the loader may only cover GL 3.3
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+namespace {
+	typedef void (APIENTRY* bufferStorageFunction)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+}
+
+streamingTexture::streamingTexture(int width, int height, unsigned int internalFormat, unsigned int format, unsigned int type, int bytesPerTexel, int slotCount) {
+	this->width = width;
+	this->height = height;
+	this->format = format;
+	this->type = type;
+	this->frameBytes = GLsizeiptr(width) * height * bytesPerTexel;
+	this->rowBytes = GLsizeiptr(width) * bytesPerTexel;
+	this->slotCount = slotCount < 2 ? 2 : (slotCount > 3 ? 3 : slotCount);
+
+	glGenTextures(1, &this->texture);
+	glBindTexture(GL_TEXTURE_2D, this->texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	bufferStorageFunction bufferStorage = nullptr;
+	if (glSupports(4, 4, "GL_ARB_buffer_storage")) {
+		bufferStorage = reinterpret_cast<bufferStorageFunction>(glfwGetProcAddress("glBufferStorage"));
+	}
+	this->persistent = bufferStorage != nullptr;
+
+	const GLbitfield persistentFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	for (int index = 0; index < this->slotCount; ++index) {
+		slot& frame = this->slots[index];
+		glGenBuffers(1, &frame.buffer);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, frame.buffer);
+		if (this->persistent) {
+			bufferStorage(GL_PIXEL_UNPACK_BUFFER, this->frameBytes, nullptr, persistentFlags);
+			frame.mapped = static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, this->frameBytes, persistentFlags));
+		}
+		else {
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, this->frameBytes, nullptr, GL_STREAM_DRAW);
+		}
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+streamingTexture::~streamingTexture() {
+	for (int index = 0; index < this->slotCount; ++index) {
+		slot& frame = this->slots[index];
+		if (frame.fence != nullptr) {
+			glDeleteSync(frame.fence);
+		}
+		// deleting a buffer unmaps it
+		glDeleteBuffers(1, &frame.buffer);
+	}
+	glDeleteTextures(1, &this->texture);
+}
+
+unsigned char* streamingTexture::beginFrame() {
+	slot& frame = this->slots[this->current];
+	this->waitForFence(frame);
+
+	if (this->persistent) {
+		return frame.mapped;
+	}
+
+	// the fence already covers the last upload from this buffer, so the driver need not synchronize again
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, frame.buffer);
+	void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, this->frameBytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	return static_cast<unsigned char*>(mapped);
+}
+
+void streamingTexture::endFrame() {
+	rowRange all = { 0, this->height };
+	this->uploadRows(&all, 1);
+}
+
+void streamingTexture::endFrame(const std::vector<rowRange>& rows) {
+	this->uploadRows(rows.data(), int(rows.size()));
+}
+
+void streamingTexture::uploadRows(const rowRange* rows, int rangeCount) {
+	slot& frame = this->slots[this->current];
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, frame.buffer);
+	if (!this->persistent) {
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	}
+	// rows are packed without padding whatever the texel size, a range starts at its own offset in the buffer
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glBindTexture(GL_TEXTURE_2D, this->texture);
+	for (int index = 0; index < rangeCount; ++index) {
+		const void* offset = reinterpret_cast<const void*>(std::size_t(rows[index].first) * this->rowBytes);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, rows[index].first, this->width, rows[index].count, this->format, this->type, offset);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	frame.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	this->current = (this->current + 1) % this->slotCount;
+}
+
+void streamingTexture::waitForFence(slot& frame) {
+	if (frame.fence == nullptr) {
+		return;
+	}
+	// flush once so the fence is sure to be reached, then keep waiting in 1 ms steps
+	GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+	while (glClientWaitSync(frame.fence, flags, 1000000) == GL_TIMEOUT_EXPIRED) {
+		flags = 0;
+	}
+	glDeleteSync(frame.fence);
+	frame.fence = nullptr;
+}
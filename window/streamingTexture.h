@@ -0,0 +1,89 @@
+#pragma once
+
+#include "vector"
+#include "glad/glad.h"
+
+/**
+ * Texture refilled every frame through a ring of pixel buffer objects. The caller writes a frame, or only the rows
+ * that changed, straight into the memory of one buffer and the texture is then updated from it by the GPU, while
+ * the CPU moves on to the next frame in the next buffer. A fence per buffer keeps a buffer from being written before the upload that
+ * reads it has finished. Buffers are mapped once and stay mapped where GL 4.4 or ARB_buffer_storage is
+ * available, otherwise (GL 3.3) they are mapped and unmapped around every frame.
+ */
+class streamingTexture {
+
+public:
+	// rows [first, first + count) of the texture, row 0 is the bottom
+	struct rowRange {
+		int first;
+		int count;
+	};
+
+protected:
+	struct slot {
+		unsigned int buffer = 0;
+		// persistent mapping of buffer, null when buffers are mapped per frame
+		unsigned char* mapped = nullptr;
+		// signalled once the upload reading buffer has finished
+		GLsync fence = nullptr;
+	};
+
+	int width = 0;
+	int height = 0;
+	unsigned int format = 0;
+	unsigned int type = 0;
+	GLsizeiptr frameBytes = 0;
+	GLsizeiptr rowBytes = 0;
+	unsigned int texture = 0;
+	slot slots[3];
+	int slotCount = 0;
+	int current = 0;
+	bool persistent = false;
+
+public:
+	/**
+	 * Creates the texture and its buffers, needs a current GL context.
+	 * @param width Texels per row.
+	 * @param height Rows.
+	 * @param internalFormat Format the texture is stored in, e.g. GL_RGBA8.
+	 * @param format Format of the written texels, e.g. GL_RGBA.
+	 * @param type Type of the written components, e.g. GL_UNSIGNED_BYTE.
+	 * @param bytesPerTexel Size of one written texel.
+	 * @param slotCount Number of buffers in the ring, 2 or 3.
+	 */
+	streamingTexture(int width, int height, unsigned int internalFormat, unsigned int format, unsigned int type, int bytesPerTexel, int slotCount = 3);
+	~streamingTexture();
+
+	streamingTexture(const streamingTexture&) = delete;
+	streamingTexture& operator=(const streamingTexture&) = delete;
+
+	/**
+	 * Waits until the next buffer is free and returns its memory, width * height texels with rows bottom to top.
+	 * Only write to it, the memory may be uncached.
+	 */
+	unsigned char* beginFrame();
+
+	/**
+	 * Queues the update of the texture from the buffer returned by beginFrame() and moves on to the next buffer.
+	 */
+	void endFrame();
+
+	/**
+	 * Same, only updating some rows of the texture, the rest keep what they held. Only these rows of the buffer
+	 * need to have been written, every row of it is undefined after beginFrame().
+	 */
+	void endFrame(const std::vector<rowRange>& rows);
+
+	unsigned int getTexture() const { return this->texture; }
+
+	/**
+	 * Whether the buffers stay mapped (GL 4.4 / ARB_buffer_storage) or are mapped per frame.
+	 */
+	bool isPersistent() const { return this->persistent; }
+
+private:
+	void waitForFence(slot& frame);
+
+	// unmaps the current buffer, updates the rows from it and moves on to the next buffer
+	void uploadRows(const rowRange* rows, int rangeCount);
+};
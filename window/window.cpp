@@ -1,8 +1,10 @@
 #include "window.h"
+#include <algorithm>
 #include <filesystem>
 #include <thread>
 #include <unordered_set>
 #include <cmath>
+#include <cstring>
 #include <thread>
 
 using namespace std;
@@ -40,6 +42,7 @@ window::window(
 	this->resizeToMonitor = resizeToMonitor;
 	this->windowDecorated = windowDecorated;
 	this->displayNumber = displayNumber;
+	this->setTargetFrameRate(this->targetFrameRate);
 
 	// creates the window instance
 	glfwInit();
@@ -98,31 +101,36 @@ void window::framebuffer_size_callback(GLFWwindow* window, int width, int height
 }
 
 int window::dotProduct(vec2 vector1, vec2 vector2) {
-	int result = vector1.x * vector2.x + vector1.y * vector2.y;
-	return result;
+	return int(dot(vector1, vector2));
 }
 
 void window::renderScreen() {
 
 	processInputMethod(this->windowInstance);
 
-	auto currentTime = std::chrono::high_resolution_clock::now();
-	auto elapsedTime = currentTime - this->previousTime;
-	this->deltaTime = ((std::chrono::duration_cast<chrono::milliseconds>(elapsedTime)).count());
-	deltaTime = deltaTime / 1000;
-	this->previousTime = std::chrono::high_resolution_clock::now();
+	// seconds as a double, whole milliseconds would round most frames of a fast loop down to 0
+	auto currentTime = std::chrono::steady_clock::now();
+	this->deltaTime = float(std::chrono::duration<double>(currentTime - this->previousTime).count());
+	this->previousTime = currentTime;
 
 
-	glUseProgram(this->shaderProgram);
-	glUniform1i(glGetUniformLocation(this->shaderProgram, "textureSampler"), 0);
+	if (this->mapping == shaderColourMapping) {
+		glUseProgram(this->fieldProgram);
+	}
+	else {
+		glUseProgram(this->shaderProgram);
+		glUniform1i(glGetUniformLocation(this->shaderProgram, "textureSampler"), 0);
+	}
 
 
 	this->mousePointerAddVelocity();
-	this->projectVel();
-	this->addVectionVel();
-	this->diffusion();
-	this->addVection();
-	this->mapDensityToPx();
+	// the grid is stepped on the simulation thread, upload its newest finished frame if there is one and
+	// keep drawing the last one otherwise
+	const simulationFrame* frame = this->simulation->newestFrame();
+	if (frame != nullptr) {
+		SNOWLIB_PROFILE_SCOPE(uploadStage);
+		this->uploadFrame(*frame);
+	}
 
 
 	glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
@@ -130,30 +138,33 @@ void window::renderScreen() {
 
 
 
-	glBindTexture(GL_TEXTURE_2D, this->textureID);
 	glActiveTexture(GL_TEXTURE0);
-	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, this->width, this->height, GL_RGBA, GL_UNSIGNED_BYTE, this->pixels.data());
+	glBindTexture(GL_TEXTURE_2D, this->densityTexture->getTexture());
 	glBindVertexArray(this->vao);
 
 
 	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 
-	glfwSwapBuffers(this->windowInstance);
+	{
+		SNOWLIB_PROFILE_SCOPE(swapStage);
+		glfwSwapBuffers(this->windowInstance);
+	}
 	glfwPollEvents();
 
+	std::this_thread::sleep_until(currentTime + this->frameDuration);
+
 
 }
 
 void window::screenCover() {
 
-	this->shaderProgram = glCreateProgram();
-	auto vs = createShader(readFile("shaders/vertex.glsl"), GL_VERTEX_SHADER, shaderProgram);
-	auto fs = createShader(readFile("shaders/fragment.glsl"), GL_FRAGMENT_SHADER, shaderProgram);
-	glAttachShader(shaderProgram, vs);
-	glAttachShader(shaderProgram, fs);
-	glLinkProgram(shaderProgram);
+	this->fieldProgram = createProgram("vertex.glsl", "fieldFragment.glsl");
+	glUseProgram(this->fieldProgram);
+	glUniform1i(glGetUniformLocation(this->fieldProgram, "fieldSampler"), 0);
+	glUniform3fv(glGetUniformLocation(this->fieldProgram, "rampPeaks"), 1, densityRampPeaks);
+	glUniform3fv(glGetUniformLocation(this->fieldProgram, "rampWidths"), 1, densityRampWidths);
 
-	glValidateProgram(shaderProgram);
+	this->shaderProgram = createProgram("vertex.glsl", "fragment.glsl");
 	glUseProgram(shaderProgram);
 
 
@@ -185,22 +196,12 @@ void window::screenCover() {
 	glEnableVertexAttribArray(1);
 
 	this->totalPixelAmount = this->height * this->width;
-	this->allPixelInfo.resize(totalPixelAmount, pixelInfo{});
-
-	initTestPixels();
-	glGenTextures(1, &textureID);
-	glBindTexture(GL_TEXTURE_2D, textureID);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, this->pixels.data());
-	glGenerateMipmap(GL_TEXTURE_2D);
+	this->grid = std::make_unique<fluidGrid>(this->width, this->height, this->constantOfViscosity, this->energyLost);
+	// density only appears under the brush, so most of the window is skipped once the starting density has decayed
+	this->grid->setActiveTileTracking(true);
 
-	float borderColor[] = { 0,0,1,1 };
-
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-	glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	this->simulation = std::make_unique<simulationThread>(*this->grid);
+	this->setColourMapping(this->mapping, this->mappedQuantity, this->halfFloatField);
 
 
 
@@ -210,480 +211,146 @@ void window::screenCover() {
 
 void window::processInputMethod(GLFWwindow* windowInstance) {
 
-
-}
-
-std::string window::readFile(const std::string& fileAddress) {
-
-	std::ifstream givenFile(fileAddress);
-
-	std::stringstream ss{};
-
-	ss << givenFile.rdbuf();
-
-	givenFile.close();
-
-	return ss.str();
-
-}
-
-unsigned int window::createShader(const std::string& shaderText, unsigned int shaderType, unsigned int shaderProgram) {
-	unsigned int shaderID = glCreateShader(shaderType);
-	const char* sourceString = shaderText.c_str();
-	glShaderSource(shaderID, 1, &sourceString, NULL);
-	glCompileShader(shaderID);
-
-	int success;
-	char infoLog[1024];
-	glGetShaderiv(shaderID, GL_COMPILE_STATUS, &success);
-	if (!success) {
-		glGetShaderInfoLog(shaderID, 512, NULL, infoLog);
-		std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+	// P writes the profile of the stages so far to the working directory, once per press
+	bool profileKey = glfwGetKey(windowInstance, GLFW_KEY_P) == GLFW_PRESS;
+	if (profileKey && !this->profileKeyDown) {
+		profiler& stages = profiler::instance();
+		stages.writeCsv("snowlibProfile.csv");
+		stages.writeJson("snowlibProfile.json");
+		stages.writeChromeTrace("snowlibTrace.json");
 	}
-	return shaderID;
-}
-
-int window::changeTheDimensions(int width, int height) {
-
-	if (width == -1) {
-		width = this->width;
-	}
-	if (height == -1) {
-		height = this->height;
+	this->profileKeyDown = profileKey;
+
+	// C turns the cycle and cache miss counters of the profiled stages on and off
+	bool countersKey = glfwGetKey(windowInstance, GLFW_KEY_C) == GLFW_PRESS;
+	if (countersKey && !this->countersKeyDown) {
+		profiler& stages = profiler::instance();
+		bool enabled = stages.setCountersEnabled(!stages.getCountersEnabled());
+		std::cout << "profiler counters " << (enabled ? "on" : "off") << std::endl;
 	}
-	glfwSetWindowSize(this->windowInstance, width, height);
-	return 0;
+	this->countersKeyDown = countersKey;
 }
 
-void window::initTestPixels() {
-
-	unsigned char blackColor[]{
-	0, 255, 255, 255
-	};
-
-	std::vector<unsigned char> allPixels(totalPixelAmount * 4);
-
-	this->pixels.resize(totalPixelAmount * 4);
-	for (int x = 0; x < totalPixelAmount * 4; ++x) {
-		this->pixels[x] = blackColor[x % 4];
+unsigned int window::createProgram(const std::string& vertexName, const std::string& fragmentName) {
+	std::string_view vertexSource = embeddedShaderSource(vertexName);
+	std::string_view fragmentSource = embeddedShaderSource(fragmentName);
+	if (vertexSource.empty() || fragmentSource.empty()) {
+		std::cout << "ERROR::SHADER::NOT_EMBEDDED " << (vertexSource.empty() ? vertexName : fragmentName) << std::endl;
+		return 0;
 	}
-	return;
-}
-
-float window::approxTheDiff(float x0, float x2, float y0, float y1, float k, float oldTarg) {
-	int numberOfVars = 4;
-	if (x0 == -1) { numberOfVars = numberOfVars - 1; x0 = 0; }
-	if (x2 == -1) { numberOfVars = numberOfVars - 1; x2 = 0; }
-	if (y0 == -1) { numberOfVars = numberOfVars - 1; y0 = 0; }
-	if (y1 == -1) { numberOfVars = numberOfVars - 1; y1 = 0; }
-
-	return (oldTarg + k * (x0 + x2 + y0 + y1)) / (1 + numberOfVars * k);
+	return this->programs.getProgram(vertexSource, fragmentSource);
 }
 
-void window::diffusion() {
-	std::vector<pixelInfo> newAllPixelInfo = this->allPixelInfo;
-	std::vector<pixelInfo> oldPixelInfo = this->allPixelInfo;
-	int x0, x1, x2, y0, y1;
-	for (int z = 0; z < this->totalPixelAmount; ++z) {
-		newAllPixelInfo[z].density = 0;
-	}
-	for (int a = 0; a < 20; ++a) {
-		for (int y = 0; y < this->height; ++y) {
-			for (int x = 0; x < this->width; ++x) {
-
-				int i = y * this->width + x;
-				newAllPixelInfo[i].density = this->approxTheDiff(
-					this->accessPixel(left, i, density, &newAllPixelInfo),
-					this->accessPixel(right, i, density, &newAllPixelInfo),
-					this->accessPixel(up, i, density, &newAllPixelInfo),
-					this->accessPixel(down, i, density, &newAllPixelInfo),
-					this->constantOfViscosity * this->deltaTime,
-					this->accessPixel(none, i, density, &oldPixelInfo));
-				newAllPixelInfo[i].velocity.x = this->approxTheDiff(
-					this->accessPixel(left, i, velocityX, &newAllPixelInfo),
-					this->accessPixel(right, i, velocityX, &newAllPixelInfo),
-					this->accessPixel(up, i, velocityX, &newAllPixelInfo),
-					this->accessPixel(down, i, velocityX, &newAllPixelInfo),
-					this->constantOfViscosity * this->deltaTime,
-					this->accessPixel(none, i, velocityX, &oldPixelInfo));
-				newAllPixelInfo[i].velocity.y = this->approxTheDiff(
-					this->accessPixel(left, i, velocityY, &newAllPixelInfo),
-					this->accessPixel(right, i, velocityY, &newAllPixelInfo),
-					this->accessPixel(up, i, velocityY, &newAllPixelInfo),
-					this->accessPixel(down, i, velocityY, &newAllPixelInfo),
-					this->constantOfViscosity * this->deltaTime,
-					this->accessPixel(none, i, velocityY, &oldPixelInfo));
-			}
-		}
+void window::setColourMapping(colourMapping mapping, fieldQuantity quantity, bool halfFloat) {
+	this->mapping = mapping;
+	this->mappedQuantity = quantity;
+	this->halfFloatField = halfFloat;
+
+	// the first frame replaces the whole texture, so it has no initial contents and no mipmaps. Its format
+	// is fixed once created, so a new mapping gets a new texture
+	this->densityTexture.reset();
+	this->uploadedRowStamps.clear();
+	int texelBytes = mapping == shaderColourMapping ? (halfFloat ? 2 : 4) : 4;
+	this->frameBytes = std::size_t(this->width) * this->height * texelBytes;
+	if (mapping == shaderColourMapping) {
+		this->densityTexture = std::make_unique<streamingTexture>(this->width, this->height, halfFloat ? GL_R16F : GL_R32F, GL_RED,
+			halfFloat ? GL_HALF_FLOAT : GL_FLOAT, texelBytes);
 	}
-	this->allPixelInfo = std::move(newAllPixelInfo);
-	return;
-}
-
-void window::mousePointerAddVelocity() {
-	std::vector<pixelInfo> newAllPixelInfo = this->allPixelInfo;
-	double xPos, yPos;
-	glfwGetCursorPos(this->windowInstance, &xPos, &yPos);
-	int centerX = static_cast<int>(xPos);
-	int centerY = static_cast<int>(yPos);
-
-	vec2 mouseVelocity = {
-		static_cast<float>(xPos - mousePos.x),
-		static_cast<float>(yPos - mousePos.y)
-	};
-	if (xPos < 30 || xPos > this->width + 30 || yPos < 30 || yPos > this->height - 30) { return; }
-
-	for (int y = -this->halfSize; y <= this->halfSize; ++y) {
-		for (int x = -this->halfSize; x <= this->halfSize; ++x) {
-			int px = centerX + x;
-			int py = centerY + y;
-
-			if ((px < 0) || (px >= this->width) || (py < 0) || (py >= this->height))
-				continue;
-
-			int index = py * this->width + px;
-			newAllPixelInfo[index].velocity.x += mouseVelocity.x * 2;
-			newAllPixelInfo[index].velocity.y += mouseVelocity.y * 2;
-
-
-			newAllPixelInfo[index].density = 20 + newAllPixelInfo[index].density;
-		}
+	else {
+		this->densityTexture = std::make_unique<streamingTexture>(this->width, this->height, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, texelBytes);
 	}
-	this->mousePos.x = static_cast<float>(xPos);
-	this->mousePos.y = static_cast<float>(yPos);
-
-	this->allPixelInfo = std::move(newAllPixelInfo);
+	this->restartSimulation();
 }
 
-// this is a forever approaching 1
-float type1Eq(float x, float mag, float newY1) {
-	return 1 / (1 + std::exp((-x + newY1) / mag));
-}
-// this spikes at newY1
-float type2Eq(float x, float mag, float newY1) {
-	return std::exp(-std::abs((1 / mag) * (x - newY1)));
+void window::setTargetFrameRate(int framesPerSecond) {
+	this->targetFrameRate = framesPerSecond > 0 ? framesPerSecond : 1;
+	this->frameDuration = std::chrono::duration<double, std::milli>(1000.0 / this->targetFrameRate);
 }
 
-// this is forever approaching 0
-float type3Eq(float x, float mag, float newY1) {
-	return 1 / (1 + std::exp((x - newY1) / mag));
+void window::setSimulationRate(bool fixedStep, double stepRate, int maxSubsteps) {
+	this->fixedStep = fixedStep;
+	this->simulationClock.setStepRate(stepRate);
+	this->simulationClock.setMaxSubsteps(maxSubsteps);
+	this->restartSimulation();
 }
 
-void window::mapDensityToPx() {
-	for (int x = 0; x < totalPixelAmount; ++x) {
-
-		float pixelDen = this->allPixelInfo[x].density;
-		unsigned char pixelRGB[4]{};
-		this->pixels[4 * x] = type2Eq(pixelDen, 5, 3) * 255;
-		this->pixels[4 * x + 1] = type2Eq(pixelDen, 20, 20) * 255;
-		this->pixels[4 * x + 2] = type2Eq(pixelDen, 20, 50) * 255;
-		this->pixels[4 * x + 3] = 255;	
+void window::restartSimulation() {
+	// the writer runs on the simulation thread, so it gets its own copy of the settings instead of reading the window
+	simulationThread::frameWriter writer;
+	if (this->mapping == shaderColourMapping) {
+		writer = [quantity = this->mappedQuantity, halfFloat = this->halfFloatField](const fluidGrid& grid, simulationFrame& frame) {
+			writeFieldTexels(grid, quantity, halfFloat, frame.texels.data(), frame.rowStamps);
+		};
 	}
-	this->flipImageVertically(this->width, this->height);
-	return;
-}
-
-
-
-void window::flipImageVertically(int width, int height) {
-	const int rowSize = width * 4;
-	unsigned char* rowBuffer = new unsigned char[rowSize];
-
-	for (int y = 0; y < height / 2; ++y) {
-		unsigned char* topRow = &this->pixels[y * rowSize];
-		unsigned char* bottomRow = &this->pixels[(height - 1 - y) * rowSize];
-		memcpy(rowBuffer, topRow, rowSize);
-		memcpy(topRow, bottomRow, rowSize);
-		memcpy(bottomRow, rowBuffer, rowSize);
+	else {
+		writer = [colours = this->densityColours](const fluidGrid& grid, simulationFrame& frame) {
+			mapDensityToPx(grid, colours, frame.texels.data(), frame.rowStamps);
+		};
 	}
-
-	delete[] rowBuffer;
+	this->simulation->start(this->frameBytes, std::move(writer), this->fixedStep, this->simulationClock);
 }
 
-float window::accessPixel(accessPixelEnum pixelDirection, int referencePixel, pixelInfoEnum accessValue, std::vector<pixelInfo>* pixelArray, float invReturnValue) {
-
-	switch (pixelDirection) {
-	case window::up:
-		if (referencePixel - this->width < 0) {
-			return invReturnValue;
-		}
-
-		referencePixel = referencePixel - this->width;
-
-		break;
-
-	case window::left:
-		if (referencePixel % this->width == 0) {
-			return invReturnValue;
-		}
-
-		referencePixel = referencePixel - 1;
-
-		break;
-
-	case window::right:
-		if (referencePixel % this->width == this->width - 1) {
-			return invReturnValue;
-		}
-
-		referencePixel = referencePixel + 1;
-		break;
-
-	case window::down:
-		referencePixel = referencePixel + this->width;
-		if (referencePixel + this->width >= this->totalPixelAmount - 1) {
-			return invReturnValue;
-		}
-		break;
-	case window::none:
-		break;
-
-	default:
-		return invReturnValue;
-		break;
-	}
-
-
-	switch (accessValue) {
-	case window::density:
-		return (*pixelArray)[referencePixel].density;
-		break;
-	case window::velocityX:
-		return (*pixelArray)[referencePixel].velocity.x;
-		break;
-	case window::velocityY:
-		return (*pixelArray)[referencePixel].velocity.y;
-		break;
-	default:
-		break;
-		return invReturnValue;
+void window::uploadFrame(const simulationFrame& frame) {
+	// neighbouring rows of tiles that changed go up as one range, the texture rows run bottom to top so the
+	// grid rows [first, end) are the texture rows [height - end, height - first)
+	if (this->uploadedRowStamps.size() != frame.rowStamps.size()) {
+		this->uploadedRowStamps.assign(frame.rowStamps.size(), ~std::uint64_t(0));
 	}
-}
-
-float window::accessPixel(accessPixelEnum pixelDirection, int referencePixel, std::vector<float>* pixelArray, float invReturnValue = -1) {
-
-	switch (pixelDirection) {
-	case window::up:
-		if (referencePixel - this->width < 0) {
-			return invReturnValue;
+	this->changedRows.clear();
+	int tileRows = int(frame.rowStamps.size());
+	for (int tileRow = 0; tileRow < tileRows;) {
+		if (frame.rowStamps[tileRow] == this->uploadedRowStamps[tileRow]) {
+			++tileRow;
+			continue;
 		}
-
-		referencePixel = referencePixel - this->width;
-
-		break;
-
-	case window::left:
-		if (referencePixel % this->width == 0) {
-			return invReturnValue;
+		int first = tileRow * fluidGrid::activeTileSize;
+		while (tileRow < tileRows && frame.rowStamps[tileRow] != this->uploadedRowStamps[tileRow]) {
+			++tileRow;
 		}
-
-		referencePixel = referencePixel - 1;
-
-		break;
-
-	case window::right:
-		if (referencePixel % this->width == this->width - 1) {
-			return invReturnValue;
-		}
-
-		referencePixel = referencePixel + 1;
-		break;
-
-	case window::down:
-		referencePixel = referencePixel + this->width;
-		if (referencePixel + this->width >= this->totalPixelAmount - 1) {
-			return invReturnValue;
-		}
-		break;
-	case window::none:
-		break;
-
-	default:
-		return invReturnValue;
-		break;
+		int end = std::min(tileRow * fluidGrid::activeTileSize, this->height);
+		this->changedRows.push_back({ this->height - end, end - first });
 	}
-
-	return (*pixelArray)[referencePixel];
-}
-
-void window::addVection() {
-	std::vector<pixelInfo> newAllPixelInfo = this->allPixelInfo;
-	float d, dx, dy, dxy;
-
-	for (int y = 0; y < this->height; ++y) {
-		for (int x = 0; x < this->width; ++x) {
-			int index = x + y * this->width;
-
-			float xFloat = this->allPixelInfo[index].velocity.x * this->deltaTime;
-			float yFloat = this->allPixelInfo[index].velocity.y * this->deltaTime;
-
-			float xBacktrace = x - xFloat;
-			float yBacktrace = y - yFloat;
-
-			int xNewPosfloor = std::floor(xBacktrace);
-			int yNewPosfloor = std::floor(yBacktrace);
-
-			int xNewPosceil = xNewPosfloor + 1;
-			int yNewPosceil = yNewPosfloor + 1;
-
-			if (xNewPosfloor > 1 && xNewPosceil < this->width - 1 && yNewPosfloor > 1 && yNewPosceil < this->height - 1) {
-
-				int newIndexfloor = yNewPosfloor * this->width + xNewPosfloor;
-				int newIndexfloorX = yNewPosfloor * this->width + xNewPosceil;
-				int newIndexfloorY = yNewPosceil * this->width + xNewPosfloor;
-				int newIndexfloorXY = yNewPosceil * this->width + xNewPosceil;
-
-				float relPosx = xBacktrace - xNewPosfloor;
-				float relPosy = yBacktrace - yNewPosfloor;
-
-				d = this->allPixelInfo[newIndexfloor].density;
-				dx = this->allPixelInfo[newIndexfloorX].density;
-				dy = this->allPixelInfo[newIndexfloorY].density;
-				dxy = this->allPixelInfo[newIndexfloorXY].density;
-
-
-				float lerp1Val = std::lerp(this->allPixelInfo[newIndexfloor].density, this->allPixelInfo[newIndexfloorX].density, relPosx);
-				float lerp2Val = std::lerp(this->allPixelInfo[newIndexfloorY].density, this->allPixelInfo[newIndexfloorXY].density, relPosx);
-				float lerp3Val = std::lerp(lerp1Val, lerp2Val, relPosy);
-
-				newAllPixelInfo[index].density = lerp3Val * this->energyLost;
-
-			}
-		}
+	if (this->changedRows.empty()) {
+		return;
 	}
 
-	this->allPixelInfo = std::move(newAllPixelInfo);
-}
-
-
-
-void window::addVectionVel() {
-	
-	std::vector<pixelInfo> newAllPixelInfo = this->allPixelInfo;
-	
-	float i, ix, iy, ixy, j, jx, jy, jxy;
-
-	for (int x = 0; x < this->width; ++x) {
-		for (int y = 0; y < this->height; ++y) {
-
-			int index = x + y * this->width;
-
-			float xFloat = this->allPixelInfo[index].velocity.x * this->deltaTime;
-			float yFloat = this->allPixelInfo[index].velocity.y * this->deltaTime;
-
-			float xBacktrace = x - xFloat;
-			float yBacktrace = y - yFloat;
-
-			int xNewPosfloor = std::floor(xBacktrace);
-			int yNewPosfloor = std::floor(yBacktrace);
-
-			int xNewPosceil = xNewPosfloor + 1;
-			int yNewPosceil = yNewPosfloor + 1;
-
-			if (xNewPosfloor > 1 && xNewPosceil < this->width - 1 && yNewPosfloor > 1 && yNewPosceil < this->height - 1) {
-
-				float relPosx = xBacktrace - xNewPosfloor;
-				float relPosy = yBacktrace - yNewPosfloor;
-
-				int newIndexfloor = yNewPosfloor * this->width + xNewPosfloor;
-				int newIndexfloorX = yNewPosfloor * this->width + xNewPosceil;
-				int newIndexfloorY = yNewPosceil * this->width + xNewPosfloor;
-				int newIndexfloorXY = yNewPosceil * this->width + xNewPosceil;
-
-				i = this->allPixelInfo[newIndexfloor].velocity.x;
-				ix = this->allPixelInfo[newIndexfloorX].velocity.x;
-				iy = this->allPixelInfo[newIndexfloorY].velocity.x;
-				ixy = this->allPixelInfo[newIndexfloorXY].velocity.x;
-				j = this->allPixelInfo[newIndexfloor].velocity.y;
-				jx = this->allPixelInfo[newIndexfloorX].velocity.y;
-				jy = this->allPixelInfo[newIndexfloorY].velocity.y;
-				jxy = this->allPixelInfo[newIndexfloorXY].velocity.y;
-
-
-
-				vec2 lerp1Val = {
-					std::lerp(i, ix, relPosx),
-					std::lerp(j, jx, relPosx)
-				};
-
-				vec2 lerp2Val = {
-					std::lerp(iy, ixy, relPosx),
-					std::lerp(jy, jxy, relPosx)
-				};
-
-				vec2 lerp3Val = {
-					std::lerp(lerp1Val.x, lerp2Val.x, relPosy),
-					std::lerp(lerp1Val.y, lerp2Val.y, relPosy)
-				};
-
-				newAllPixelInfo[index].velocity.x = lerp3Val.x * this->energyLost;
-				newAllPixelInfo[index].velocity.y = lerp3Val.y * this->energyLost;
-			}
-		}
+	unsigned char* texels = this->densityTexture->beginFrame();
+	std::size_t rowBytes = this->frameBytes / this->height;
+	for (const streamingTexture::rowRange& rows : this->changedRows) {
+		std::size_t offset = std::size_t(rows.first) * rowBytes;
+		std::memcpy(texels + offset, frame.texels.data() + offset, std::size_t(rows.count) * rowBytes);
 	}
-
-	this->allPixelInfo = std::move(newAllPixelInfo);
+	this->densityTexture->endFrame(this->changedRows);
+	this->uploadedRowStamps = frame.rowStamps;
 }
-void window::projectVel() {
-	std::vector<float> divergence(this->totalPixelAmount, 0.0f);
-	std::vector<float> pressure(this->totalPixelAmount, 0.0f);
-	std::vector<pixelInfo> result = this->allPixelInfo;
-
-	float N = float(this->width);
-	float h = 1.0f / N;
-	int index;
-	float x0, x1, y0, y1, center;
-
-	for (int y = 1; y < this->height - 1; ++y) {
-		for (int x = 1; x < this->width - 1; ++x) {
-			index = x + y * this->width;
-
-			x1 = accessPixel(right, index, velocityX, &this->allPixelInfo, 0.0f);
-			x0 = accessPixel(left, index, velocityX, &this->allPixelInfo, 0.0f);
-			y1 = accessPixel(down, index, velocityY, &this->allPixelInfo, 0.0f);
-			y0 = accessPixel(up, index, velocityY, &this->allPixelInfo, 0.0f);
 
-			divergence[index] = -0.5f * h * (x1 - x0 + y1 - y0);
-			pressure[index] = 0.0f;
-		
+int window::changeTheDimensions(int width, int height) {
 
-		}
+	if (width == -1) {
+		width = this->width;
 	}
-
-	for (int iter = 0; iter < 20; ++iter) {
-		for (int y = 1; y < this->height - 1; ++y) {
-			for (int x = 1; x < this->width - 1; ++x) {
-				index = x + y * this->width;
-
-				x1 = accessPixel(right, index, &pressure, 0.0f);
-				x0 = accessPixel(left, index, &pressure, 0.0f);
-				y1 = accessPixel(down, index, &pressure, 0.0f);
-				y0 = accessPixel(up, index, &pressure, 0.0f);
-				center = divergence[index];
-
-				float newPressure = (x0 + x1 + y0 + y1 + center) / 4.0f;
-				pressure[index] = newPressure;
-
-			}
-		}
+	if (height == -1) {
+		height = this->height;
 	}
-	for (int y = 1; y < this->height - 1; ++y) {
-		for (int x = 1; x < this->width - 1; ++x) {
-			index = x + y * this->width;
+	glfwSetWindowSize(this->windowInstance, width, height);
+	return 0;
+}
 
-			x1 = accessPixel(right, index, &pressure, 0.0f);
-			x0 = accessPixel(left, index, &pressure, 0.0f);
-			y1 = accessPixel(down, index, &pressure, 0.0f);
-			y0 = accessPixel(up, index, &pressure, 0.0f);
+void window::mousePointerAddVelocity() {
+	double xPos, yPos;
+	glfwGetCursorPos(this->windowInstance, &xPos, &yPos);
+	int centerX = static_cast<int>(xPos);
+	int centerY = static_cast<int>(yPos);
 
-			float vx = this->allPixelInfo[index].velocity.x - 0.5f * N * (x1 - x0);
-			float vy = this->allPixelInfo[index].velocity.y - 0.5f * N * (y1 - y0);
+	vec2 mouseVelocity = {
+		static_cast<float>(xPos - mousePos.x()),
+		static_cast<float>(yPos - mousePos.y())
+	};
+	if (xPos < 30 || xPos > this->width + 30 || yPos < 30 || yPos > this->height - 30) { return; }
 
-			result[index].velocity.x = vx;
-			result[index].velocity.y = vy;
-		}
-	}
+	// applied by the simulation thread before its next step, dropped if it has fallen that far behind
+	this->simulation->addInput({ centerX, centerY, mouseVelocity.x() * 2, mouseVelocity.y() * 2, 20, this->halfSize });
 
-	this->allPixelInfo = std::move(result);
+	this->mousePos.x() = static_cast<float>(xPos);
+	this->mousePos.y() = static_cast<float>(yPos);
 }
-
@@ -7,9 +7,26 @@
 #include "sstream"
 #include "vector"
 #include "array"
+#include "memory"
+#include "solver/fluidGrid.h"
+#include "solver/colourMap.h"
+#include "streamingTexture.h"
+#include "solver/fixedTimestep.h"
+#include "simulationThread.h"
+#include "programCache.h"
+#include "embeddedShaders.h"
+#include "profiling/profiler.h"
 
 class window {
 
+public:
+	enum colourMapping {
+		// densities are coloured by a lookup table on the CPU and uploaded as RGBA8
+		cpuColourMapping = 0,
+		// the raw field is uploaded as a single float channel and coloured by the fragment shader
+		shaderColourMapping = 1
+	};
+
 protected:
 	int width;
 	int height;
@@ -23,37 +40,20 @@ protected:
 	GLFWwindow* windowInstance;
 	int displayNumber = 0;
 	unsigned int shaderProgram;
+	unsigned int fieldProgram;
 	unsigned int vao;
-	unsigned int textureID;
+	// linked programs kept on disk between runs, see programCache
+	programCache programs;
 	float constantOfViscosity = 0.5;
+	// frames drawn per second at most, frameDuration is derived from it
 	int targetFrameRate = 1000;
+	// advances the grid in fixed steps, unless fixedStep is off and the simulation steps by its own frame time
+	fixedTimestep simulationClock{ 60, 4 };
+	bool fixedStep = true;
 	int halfSize = 10;
 	float energyLost = 0.99;
 
 
-	struct vec2 {
-		float x;
-		float y;
-	};
-
-	struct vec4 {
-		float r;
-		float g;
-		float b;
-		float a;
-	};
-
-	struct vec3 {
-		float r;
-		float b;
-		float g;
-	};
-
-	struct pixelInfo {
-		float density = 1;
-		vec2 velocity = {0.0f, 0.0f};
-	};
-
 	enum lerp {
 		xV = 1,
 		yV = 2,
@@ -61,31 +61,28 @@ protected:
 		aV = 4
 	};
 
-	enum accessPixelEnum {
-		up = 0,
-		left = 1,
-		right = 2,
-		down = 3,
-		none = 4
-	};
-	
-	enum pixelInfoEnum {
-		density = 1,
-		velocityX = 2,
-		velocityY = 3
-	};
-	
-	
-	std::vector<pixelInfo> allPixelInfo{ pixelInfo{1, {0.0, 0.0}} };
+	std::unique_ptr<fluidGrid> grid;
+	// steps the grid on its own thread, declared after grid so it is stopped before the grid goes away
+	std::unique_ptr<simulationThread> simulation;
+	colourMap densityColours;
+	std::unique_ptr<streamingTexture> densityTexture;
+	colourMapping mapping = cpuColourMapping;
+	fieldQuantity mappedQuantity = densityQuantity;
+	bool halfFloatField = true;
+	std::size_t frameBytes = 0;
+	// stamps of the rows of tiles the texture was last updated from, see fluidGrid::getTileRowStamps()
+	std::vector<std::uint64_t> uploadedRowStamps;
+	std::vector<streamingTexture::rowRange> changedRows;
 	vec2 mousePos{0,0};
+	bool profileKeyDown = false;
+	bool countersKeyDown = false;
 	int totalPixelAmount;
 
 public:
 
 	std::chrono::duration<double, std::milli> frameDuration = std::chrono::duration<double, std::milli>(1000.0 / 60);
-	std::chrono::steady_clock::time_point previousTime = std::chrono::high_resolution_clock::now();
+	std::chrono::steady_clock::time_point previousTime = std::chrono::steady_clock::now();
 	float deltaTime;
-	std::vector<unsigned char> pixels{0};
 	/**
 	 * @param width Width of the window.
 	 * @param height Height of the window.
@@ -117,41 +114,49 @@ public:
 
 	void renderScreen();
 
+	/**
+	 * Picks where the grid is turned into colours, recreating the texture it is uploaded to.
+	 * @param mapping CPU lookup table (RGBA8 upload) or fragment shader (R16F / R32F upload).
+	 * @param quantity Quantity the shader colours, the lookup table always colours density.
+	 * @param halfFloat Whether the shader path uploads R16F, half the bytes of R32F.
+	 */
+	void setColourMapping(colourMapping mapping, fieldQuantity quantity = densityQuantity, bool halfFloat = true);
+
+	/**
+	 * Caps the frames drawn per second, each frame sleeps off what is left of its frameDuration.
+	 */
+	void setTargetFrameRate(int framesPerSecond);
+
+	/**
+	 * Restarts the simulation thread with new stepping.
+	 * @param fixedStep Whether the grid advances in fixed steps or by one step of the time its last steps took.
+	 * @param stepRate Fixed steps per simulated second.
+	 * @param maxSubsteps Most fixed steps run in one frame, the rest are dropped when the solver falls behind.
+	 */
+	void setSimulationRate(bool fixedStep, double stepRate = 60, int maxSubsteps = 4);
+
 private:
 	static void framebuffer_size_callback(GLFWwindow* windowInstance, int width, int height);
 
 	void processInputMethod(GLFWwindow* windowInstance);
 
-	std::string readFile(const std::string& fileAddress);
-
-	unsigned int createShader(const std::string& shaderText, unsigned int shaderType, unsigned int shaderProgram);
-
-	void initTestPixels();
+	/**
+	 * Links the embedded shaders of the given file names, through the program cache.
+	 */
+	unsigned int createProgram(const std::string& vertexName, const std::string& fragmentName);
 
 	void screenCover();
 
-
-	void diffusion();
-
-	void addVection();
-
 	int dotProduct(vec2 vector1, vec2 vector2);
 
-	void mapDensityToPx();
-
 	void mousePointerAddVelocity();
 
-	void flipImageVertically(int width, int height);
-
-	float accessPixel(accessPixelEnum pixelDirection, int referencePixel, pixelInfoEnum accessValue, std::vector<pixelInfo>* pixelArray, float invReturnValue = -1);
-	float accessPixel(accessPixelEnum pixelDirection, int referencePixel, std::vector<float>* pixelArray, float invReturnValue);
+	void restartSimulation();
 
-	float approxTheDiff(float x0, float x2, float y0, float y1, float k, float oldTarg);
-	float approxTheDiff(float x0, float x2, float y0, float y1, float oldTarg);
-
-	void addVectionVel();
-
-	void projectVel();
+	/**
+	 * Updates the rows of the texture whose rows of tiles changed since it was last updated, nothing if none did.
+	 */
+	void uploadFrame(const simulationFrame& frame);
 
 	void reAssign(int height, int width);
 